@@ -0,0 +1,66 @@
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include "aligned_allocator.hpp"
+#include "benchmark.hpp"
+#include "data_handler.hpp"
+#include "linalg.hpp"
+
+// Benchmarks of loading, preprocessing and the shared linalg kernels, on generated data
+int main(int argc, char **argv) {
+    const std::string output = argc > 1 ? argv[1] : "bin/bench.json";
+    const std::string images = "bin/bench-images.idx", labels = "bin/bench-labels.idx", csv = "bin/bench.csv";
+    const size_t num_images = 6000, num_lines = 10000, dim = 784;
+    if (!synthetic::write_idx(images, labels, num_images, 28, 28, 10) || !synthetic::write_csv(csv, num_lines, 16, 3)) {
+        return 1;
+    }
+
+    Benchmark bench("common");
+
+    // Loading into a new handler per sample; the previous one is freed outside the timing
+    std::unique_ptr<DataHandler> loader;
+    bench.run_with_setup("read_idx", [&]() { loader.reset(new DataHandler()); }, [&]() {
+        loader->read_input_data(images);
+        loader->read_label_data(labels);
+    }, num_images);
+    bench.run_with_setup("read_csv", [&]() { loader.reset(new DataHandler()); }, [&]() {
+        loader->read_csv(csv, ",");
+    }, num_lines);
+    loader.reset();
+
+    // Preprocessing on one loaded data set
+    DataHandler dh;
+    dh.read_input_data(images);
+    dh.read_label_data(labels);
+    dh.count_classes();
+    bench.run("normalize", [&]() { dh.normalize(); }, num_images);
+    // split_data() appends to the sets, so every sample starts from empty ones
+    bench.run_with_setup("split_data", [&]() {
+        dh.get_training_set()->clear();
+        dh.get_test_set()->clear();
+        dh.get_validation_set()->clear();
+    }, [&]() { dh.split_data(); }, num_images);
+
+    // Kernels at MNIST sizes: one image against another, a 64-neuron layer, a 64-sample batch
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    AlignedVector<real_t> a(64 * dim), b(64 * dim), c(64 * 64), x(dim), y(64);
+    for (AlignedVector<real_t> *v : {&a, &b, &x}) {
+        for (real_t &value : *v) {
+            value = uniform(gen);
+        }
+    }
+    bench.run("squared_distance_784", [&]() { do_not_optimize(linalg::squared_distance(a.data(), b.data(), dim)); }, dim);
+    bench.run("dot_784", [&]() { do_not_optimize(linalg::dot(a.data(), b.data(), dim)); }, dim);
+    bench.run("gemv_64x784", [&]() {
+        linalg::gemv(64, dim, 1.0, a.data(), dim, x.data(), 0.0, y.data());
+        do_not_optimize(y[0]);
+    }, 64 * dim);
+    bench.run("gemm_nt_64x64x784", [&]() {
+        linalg::gemm_nt(64, 64, dim, a.data(), dim, b.data(), dim, c.data(), 64);
+        do_not_optimize(c[0]);
+    }, 64 * 64 * dim);
+
+    return bench.save(output) ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Timing statistics of one benchmarked operation.
+ */
+struct BenchmarkResult {
+    std::string name;         ///< Operation name.
+    size_t samples;           ///< Number of timed samples.
+    size_t ops_per_sample;    ///< Calls averaged into each sample.
+    size_t items_per_op;      ///< Work items (points, bytes, ...) processed by one call.
+    double mean_ns;           ///< Mean time per call.
+    double p50_ns;            ///< Median of the per-sample times per call.
+    double p90_ns;            ///< 90th percentile of the per-sample times per call.
+    double p99_ns;            ///< 99th percentile of the per-sample times per call.
+    double min_ns;            ///< Fastest sample, per call.
+    double max_ns;            ///< Slowest sample, per call.
+    double ops_per_second;    ///< 1e9 / mean_ns.
+    double items_per_second;  ///< ops_per_second * items_per_op.
+};
+
+/**
+ * @brief Micro- and macro-benchmark harness behind the `make bench` targets.
+ *
+ * run() calibrates the number of calls per sample so that a sample takes about a
+ * millisecond (one call for anything slower), then takes enough samples to fill the time
+ * budget, within [min_samples, max_samples]. Percentiles are taken over the per-sample mean
+ * times, so for slow operations they are per-call latencies. Anything the operation prints
+ * to std::cout is discarded while it is timed.
+ *
+ * Results are printed as they complete and written as one JSON document by save().
+ */
+class Benchmark {
+private:
+    /**
+     * @brief Name of the suite (the module).
+     */
+    std::string suite;
+
+    /**
+     * @brief Time budget per operation in seconds.
+     */
+    double budget_seconds;
+
+    /**
+     * @brief Completed results, in run order.
+     */
+    std::vector<BenchmarkResult> results;
+
+    /**
+     * @brief Monotonic clock in nanoseconds.
+     */
+    static double now_ns();
+
+    /**
+     * @brief Silences std::cout (true) or restores it (false).
+     */
+    static void quiet(bool enabled);
+
+    /**
+     * @brief Computes the statistics of the samples, stores and prints them.
+     */
+    const BenchmarkResult &record(const std::string &name, std::vector<double> &sample_ns, size_t ops_per_sample,
+                                  size_t items_per_op);
+
+public:
+    /**
+     * @brief Smallest and largest number of samples per operation.
+     */
+    static constexpr size_t min_samples = 3;
+    static constexpr size_t max_samples = 200;
+
+    /**
+     * @brief Creates an empty suite.
+     * @param suite Suite name written to the JSON document.
+     * @param budget_seconds Approximate time spent per operation.
+     */
+    explicit Benchmark(const std::string &suite, double budget_seconds = 0.5);
+
+    /**
+     * @brief Times repeated calls of an operation.
+     * @param name Operation name.
+     * @param operation Callable taking no arguments.
+     * @param items_per_op Work items per call, for items_per_second.
+     * @return Recorded result.
+     */
+    template <typename Operation>
+    const BenchmarkResult &run(const std::string &name, Operation operation, size_t items_per_op = 1) {
+        quiet(true);
+        double start = now_ns();
+        operation();  // warm-up and calibration
+        double single = std::max(now_ns() - start, 1.0);
+        size_t ops = single >= 1e6 ? 1 : static_cast<size_t>(1e6 / single);
+        size_t samples = static_cast<size_t>(budget_seconds * 1e9 / (single * static_cast<double>(ops)));
+        samples = std::min(std::max(samples, min_samples), max_samples);
+
+        std::vector<double> sample_ns;
+        for (size_t s = 0; s < samples; ++s) {
+            start = now_ns();
+            for (size_t i = 0; i < ops; ++i) {
+                operation();
+            }
+            sample_ns.push_back((now_ns() - start) / static_cast<double>(ops));
+        }
+        quiet(false);
+        return record(name, sample_ns, ops, items_per_op);
+    }
+
+    /**
+     * @brief Times single calls of an operation that needs fresh state, prepared untimed by setup.
+     * @param name Operation name.
+     * @param setup Callable run before every call, not timed.
+     * @param operation Callable taking no arguments.
+     * @param items_per_op Work items per call, for items_per_second.
+     * @param samples Number of timed calls.
+     * @return Recorded result.
+     */
+    template <typename Setup, typename Operation>
+    const BenchmarkResult &run_with_setup(const std::string &name, Setup setup, Operation operation,
+                                          size_t items_per_op = 1, size_t samples = min_samples) {
+        quiet(true);
+        std::vector<double> sample_ns;
+        for (size_t s = 0; s < samples; ++s) {
+            setup();
+            double start = now_ns();
+            operation();
+            sample_ns.push_back(now_ns() - start);
+        }
+        quiet(false);
+        return record(name, sample_ns, 1, items_per_op);
+    }
+
+    /**
+     * @brief Writes the suite, build settings and every result as JSON.
+     * @param out Destination stream.
+     */
+    void write_json(std::ostream &out) const;
+
+    /**
+     * @brief Writes the JSON document to a file.
+     * @param path Destination file.
+     * @return True on success.
+     */
+    bool save(const std::string &path) const;
+};
+
+/**
+ * @brief Keeps the compiler from optimizing away a value computed only for timing.
+ * @param value Value to keep.
+ */
+template <typename T>
+inline void do_not_optimize(const T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * @brief Generated datasets, so benchmarks run without downloading MNIST.
+ *
+ * Every class has a random prototype; samples are their class prototype plus noise, so the
+ * classes are separable like in the real data sets. The same seed gives the same files.
+ */
+namespace synthetic {
+
+/**
+ * @brief Writes an MNIST-style IDX image file and label file.
+ * @param images_path Destination of the images (magic 2051).
+ * @param labels_path Destination of the labels (magic 2049).
+ * @param count Number of images.
+ * @param rows Rows per image.
+ * @param cols Columns per image.
+ * @param classes Number of classes.
+ * @param seed Random seed.
+ * @return False if a file cannot be written.
+ */
+bool write_idx(const std::string &images_path, const std::string &labels_path, size_t count, size_t rows,
+               size_t cols, int classes, uint32_t seed = 1);
+
+/**
+ * @brief Writes an Iris-style CSV file: numeric features, then a class name per line.
+ * @param path Destination file.
+ * @param count Number of lines.
+ * @param features Number of features per line.
+ * @param classes Number of classes.
+ * @param seed Random seed.
+ * @return False if the file cannot be written.
+ */
+bool write_csv(const std::string &path, size_t count, size_t features, int classes, uint32_t seed = 1);
+
+} // namespace synthetic
@@ -28,6 +28,10 @@ private:
     std::map<uint8_t, int> class_map;
     std::map<std::string, int> str_class_map;
 
+    // Per-feature range seen by normalize()
+    std::vector<double> feature_mins;
+    std::vector<double> feature_maxs;
+
 public:
     /**
      * @brief Constructs a new DataHandler object.
@@ -86,6 +90,18 @@ public:
      */
     void normalize();
 
+    /**
+     * @brief Returns the per-feature minimums used by normalize().
+     * @return Minimum raw value of each feature (empty before normalize()).
+     */
+    const std::vector<double> &get_feature_mins() const;
+
+    /**
+     * @brief Returns the per-feature maximums used by normalize().
+     * @return Maximum raw value of each feature (empty before normalize()).
+     */
+    const std::vector<double> &get_feature_maxs() const;
+
     /**
      * @brief Returns the total number of unique classes in the dataset.
      * @return Number of classes.
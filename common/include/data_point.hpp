@@ -3,6 +3,7 @@
 #include <vector>
 #include <cstdint>
 #include <memory>
+#include "precision.hpp"
 
 /**
  * @brief Represents a single data point (e.g., an image and its label).
@@ -13,7 +14,7 @@ private:
     std::vector<uint8_t> *feature_vector = nullptr;
 
     // Normalized feature values in range [0, 1]
-    std::vector<double> *normalized_feature_vector = nullptr;
+    std::vector<real_t> *normalized_feature_vector = nullptr;
 
     // Original label from dataset
     uint8_t label = 0;
@@ -54,13 +55,13 @@ public:
      * @brief Sets the normalized feature vector.
      * @param vector Pointer to a vector of normalized features.
      */
-    void set_normalized_feature_vector(std::vector<double> *vector);
+    void set_normalized_feature_vector(std::vector<real_t> *vector);
 
     /**
      * @brief Appends a normalized feature value.
      * @param value Normalized feature to add.
      */
-    void append_to_normalized_feature_vector(double value);
+    void append_to_normalized_feature_vector(real_t value);
 
     /**
      * @brief Initializes the one-hot class vector with the number of classes.
@@ -120,7 +121,7 @@ public:
      * @brief Returns a pointer to the normalized feature vector.
      * @return Normalized feature vector.
      */
-    std::vector<double>* get_normalized_feature_vector();
+    std::vector<real_t>* get_normalized_feature_vector();
 
     /**
      * @brief Returns a copy of the one-hot class vector.
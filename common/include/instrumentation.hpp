@@ -0,0 +1,220 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+ * @brief Hot-path instrumentation: scoped phase timers, event counters and latency histograms.
+ *
+ * Code is instrumented only through the RTML_TIMER and RTML_COUNT macros below. They expand to
+ * nothing unless the build defines RTML_INSTRUMENT (make INSTRUMENT=1), so an uninstrumented
+ * build carries no clock reads, atomics or registry lookups. When enabled, every macro call site
+ * looks up its metric once (a function-local static) and afterwards only reads the clock and
+ * does relaxed atomic adds, so instrumented code stays safe on the thread pool.
+ *
+ * Metrics are named "<module>.<phase>" and live for the whole process; write_json() dumps them.
+ */
+namespace instrumentation {
+
+#if defined(RTML_INSTRUMENT)
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+/**
+ * @brief Monotonically increasing event or byte count.
+ */
+class Counter {
+private:
+    std::atomic<uint64_t> value;
+
+public:
+    Counter() : value(0) {}
+
+    /**
+     * @brief Adds to the count.
+     * @param amount Amount to add.
+     */
+    void add(uint64_t amount) {
+        value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Returns the count.
+     * @return Current value.
+     */
+    uint64_t get() const {
+        return value.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Sets the count back to zero.
+     */
+    void reset() {
+        value.store(0, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @brief HDR-style histogram of durations in nanoseconds.
+ *
+ * Values below 2^SUB_BUCKET_BITS are counted exactly; above that every power of two is split
+ * into 2^SUB_BUCKET_BITS linear buckets, so a reported percentile is within 1/64 (about 1.6 %)
+ * of the recorded value, up to 2^(MAX_EXPONENT + 1) ns (about nine hours). Recording is a few
+ * relaxed atomic operations and never allocates. Percentiles read while other threads record
+ * are approximate.
+ */
+class Histogram {
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 6;
+    static constexpr unsigned MAX_EXPONENT = 44;
+    static constexpr size_t SUB_BUCKETS = size_t{1} << SUB_BUCKET_BITS;
+    static constexpr size_t NUM_BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+private:
+    std::atomic<uint64_t> buckets[NUM_BUCKETS];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> minimum;
+    std::atomic<uint64_t> maximum;
+
+    /**
+     * @brief Returns the bucket of a value.
+     */
+    static size_t bucket_of(uint64_t value);
+
+    /**
+     * @brief Returns the middle of a bucket's range.
+     */
+    static uint64_t bucket_value(size_t bucket);
+
+public:
+    Histogram();
+
+    /**
+     * @brief Counts one duration; values beyond the range land in the last bucket.
+     * @param nanoseconds Duration.
+     */
+    void record(uint64_t nanoseconds);
+
+    /**
+     * @brief Returns the number of recorded values.
+     * @return Count.
+     */
+    uint64_t get_count() const;
+
+    /**
+     * @brief Returns the sum of the recorded values.
+     * @return Total nanoseconds.
+     */
+    uint64_t get_total() const;
+
+    /**
+     * @brief Returns the smallest recorded value (0 if empty).
+     * @return Nanoseconds.
+     */
+    uint64_t get_min() const;
+
+    /**
+     * @brief Returns the largest recorded value.
+     * @return Nanoseconds.
+     */
+    uint64_t get_max() const;
+
+    /**
+     * @brief Returns a percentile (nearest rank), clamped to the recorded min and max.
+     * @param fraction Percentile in [0, 1], e.g. 0.999.
+     * @return Nanoseconds, 0 if empty.
+     */
+    uint64_t percentile(double fraction) const;
+
+    /**
+     * @brief Forgets every recorded value.
+     */
+    void reset();
+};
+
+/**
+ * @brief Records the lifetime of a scope into a histogram.
+ */
+class ScopedTimer {
+private:
+    Histogram &histogram;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit ScopedTimer(Histogram &histogram) : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        histogram.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+};
+
+/**
+ * @brief Returns the counter of a name, creating it on first use. The reference stays valid.
+ * @param name Metric name.
+ * @return Counter.
+ */
+Counter &counter(const std::string &name);
+
+/**
+ * @brief Returns the histogram of a name, creating it on first use. The reference stays valid.
+ * @param name Metric name.
+ * @return Histogram.
+ */
+Histogram &histogram(const std::string &name);
+
+/**
+ * @brief Sets every counter and histogram back to zero.
+ */
+void reset();
+
+/**
+ * @brief Writes every counter and, per histogram, count, mean, min, p50, p90, p99, p999 and
+ * max in nanoseconds as one JSON document. Metrics are sorted by name.
+ * @param out Destination stream.
+ */
+void write_json(std::ostream &out);
+
+/**
+ * @brief Writes the JSON document to a file.
+ * @param path Destination file.
+ * @return True on success.
+ */
+bool save(const std::string &path);
+
+} // namespace instrumentation
+
+#define RTML_CONCAT_INNER(a, b) a##b
+#define RTML_CONCAT(a, b) RTML_CONCAT_INNER(a, b)
+
+#if defined(RTML_INSTRUMENT)
+/**
+ * @brief Times the rest of the enclosing scope into histogram `name`.
+ */
+#define RTML_TIMER(name)                                                                              \
+    static ::instrumentation::Histogram &RTML_CONCAT(rtml_histogram_, __LINE__) =                     \
+        ::instrumentation::histogram(name);                                                           \
+    ::instrumentation::ScopedTimer RTML_CONCAT(rtml_timer_, __LINE__)(RTML_CONCAT(rtml_histogram_, __LINE__))
+
+/**
+ * @brief Adds `amount` to counter `name`; `amount` is not evaluated when instrumentation is off.
+ */
+#define RTML_COUNT(name, amount)                                                                      \
+    do {                                                                                              \
+        static ::instrumentation::Counter &rtml_counter = ::instrumentation::counter(name);           \
+        rtml_counter.add(static_cast<uint64_t>(amount));                                              \
+    } while (0)
+#else
+#define RTML_TIMER(name) ((void)0)
+#define RTML_COUNT(name, amount) ((void)0)
+#endif
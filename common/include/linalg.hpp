@@ -0,0 +1,229 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "precision.hpp"
+
+/**
+ * @brief Dense linear-algebra kernels shared by the models.
+ *
+ * All kernels work on raw contiguous arrays so they can be used on top of any
+ * storage (std::vector data, centroid matrices, weight matrices) and are written
+ * with explicit SIMD vectors that compile to SSE/AVX/NEON on every target. Floating-point
+ * kernels take real_t arrays; reductions (distances, dot products, GEMV rows and gemm_nt
+ * entries) are summed in accum_t.
+ */
+namespace linalg {
+
+/**
+ * @brief Computes the squared Euclidean distance between two vectors.
+ * @param a Pointer to the first vector.
+ * @param b Pointer to the second vector.
+ * @param n Number of elements in each vector.
+ * @return Sum of (a[i] - b[i])^2.
+ */
+accum_t squared_distance(const real_t *a, const real_t *b, size_t n);
+
+/**
+ * @brief Computes the dot product of two vectors.
+ * @param a Pointer to the first vector.
+ * @param b Pointer to the second vector.
+ * @param n Number of elements in each vector.
+ * @return Sum of a[i] * b[i].
+ */
+accum_t dot(const real_t *a, const real_t *b, size_t n);
+
+/**
+ * @brief Computes y += alpha * x.
+ * @param n Number of elements.
+ * @param alpha Scale factor.
+ * @param x Pointer to the input vector.
+ * @param y Pointer to the vector to update.
+ */
+void axpy(size_t n, real_t alpha, const real_t *x, real_t *y);
+
+/**
+ * @brief Matrix-vector product y = alpha * A * x + beta * y (A row-major m x n).
+ * @param m Number of rows of A (length of y).
+ * @param n Number of columns of A (length of x).
+ * @param alpha Scale of the product.
+ * @param a Row-major matrix with leading dimension lda.
+ * @param lda Leading dimension of A.
+ * @param x Input vector of length n.
+ * @param beta Scale of the previous y (0 ignores its contents).
+ * @param y Output vector of length m.
+ */
+void gemv(size_t m, size_t n, real_t alpha, const real_t *a, size_t lda, const real_t *x, real_t beta, real_t *y);
+
+/**
+ * @brief Transposed matrix-vector product y = alpha * A^T * x + beta * y (A row-major m x n).
+ * @param m Number of rows of A (length of x).
+ * @param n Number of columns of A (length of y).
+ * @param alpha Scale of the product.
+ * @param a Row-major matrix with leading dimension lda.
+ * @param lda Leading dimension of A.
+ * @param x Input vector of length m.
+ * @param beta Scale of the previous y (0 ignores its contents).
+ * @param y Output vector of length n.
+ */
+void gemv_t(size_t m, size_t n, real_t alpha, const real_t *a, size_t lda, const real_t *x, real_t beta, real_t *y);
+
+/**
+ * @brief Rank-one update A += alpha * x * y^T (A row-major m x n).
+ * @param m Number of rows of A (length of x).
+ * @param n Number of columns of A (length of y).
+ * @param alpha Scale of the update.
+ * @param x Column vector of length m.
+ * @param y Row vector of length n.
+ * @param a Row-major matrix with leading dimension lda.
+ * @param lda Leading dimension of A.
+ */
+void ger(size_t m, size_t n, real_t alpha, const real_t *x, const real_t *y, real_t *a, size_t lda);
+
+/**
+ * @brief Transposed matrix-vector product y = alpha * A^T * x + beta * y for a sparse x.
+ *
+ * Only the rows of A selected by the non-zero entries of x are read, so the cost is
+ * proportional to nnz * n rather than to the size of A.
+ *
+ * @param n Number of columns of A (length of y).
+ * @param alpha Scale of the product.
+ * @param a Row-major matrix with leading dimension lda.
+ * @param lda Leading dimension of A.
+ * @param nnz Number of non-zero entries of x.
+ * @param indices Row of A (position in x) of every non-zero entry.
+ * @param values Value of every non-zero entry.
+ * @param beta Scale of the previous y (0 ignores its contents).
+ * @param y Output vector of length n.
+ */
+void sparse_gemv_t(size_t n, real_t alpha, const real_t *a, size_t lda,
+                   size_t nnz, const uint32_t *indices, const real_t *values, real_t beta, real_t *y);
+
+/**
+ * @brief Rank-one update A += alpha * x * y^T for a sparse x; rows of A where x is zero are not touched.
+ * @param n Number of columns of A (length of y).
+ * @param alpha Scale of the update.
+ * @param nnz Number of non-zero entries of x.
+ * @param indices Row of A (position in x) of every non-zero entry.
+ * @param values Value of every non-zero entry.
+ * @param y Row vector of length n.
+ * @param a Row-major matrix with leading dimension lda.
+ * @param lda Leading dimension of A.
+ */
+void sparse_ger(size_t n, real_t alpha, size_t nnz, const uint32_t *indices, const real_t *values,
+                const real_t *y, real_t *a, size_t lda);
+
+/**
+ * @brief Rows of one block of a block-sparse (BSR) matrix.
+ */
+constexpr size_t BSR_BLOCK_ROWS = 4;
+
+/**
+ * @brief Columns of one block of a block-sparse (BSR) matrix.
+ */
+constexpr size_t BSR_BLOCK_COLS = 8;
+
+/**
+ * @brief Block-sparse matrix-vector product y = A * x.
+ *
+ * A is stored in BSR form: block row r covers rows [r * BSR_BLOCK_ROWS, (r + 1) * BSR_BLOCK_ROWS)
+ * and owns blocks [row_offsets[r], row_offsets[r + 1]). Block b is a row-major
+ * BSR_BLOCK_ROWS x BSR_BLOCK_COLS tile whose first column is block_cols[b]; blocks that are
+ * entirely zero are not stored, so the cost is proportional to the number of stored blocks.
+ * Each loaded slice of x is shared by the four rows of its block.
+ *
+ * @param block_rows Number of block rows (y has block_rows * BSR_BLOCK_ROWS entries).
+ * @param row_offsets block_rows + 1 offsets into block_cols and blocks.
+ * @param block_cols First column of every stored block.
+ * @param blocks BSR_BLOCK_ROWS * BSR_BLOCK_COLS values per stored block.
+ * @param x Input vector, readable up to the last column of every stored block.
+ * @param y Output vector (overwritten).
+ */
+void bsr_gemv(size_t block_rows, const uint32_t *row_offsets, const uint32_t *block_cols, const real_t *blocks,
+              const real_t *x, real_t *y);
+
+/**
+ * @brief Cache-blocked matrix product C = A * B^T (both operands row-major).
+ *
+ * Every C entry is the dot product of a row of A with a row of B, which is the layout of
+ * query-by-centroid score matrices.
+ *
+ * @param m Number of rows of A and C.
+ * @param n Number of rows of B and columns of C.
+ * @param k Shared inner dimension.
+ * @param a Row-major m x k matrix with leading dimension lda.
+ * @param lda Leading dimension of A.
+ * @param b Row-major n x k matrix with leading dimension ldb.
+ * @param ldb Leading dimension of B.
+ * @param c Row-major m x n output with leading dimension ldc (overwritten).
+ * @param ldc Leading dimension of C.
+ */
+void gemm_nt(size_t m, size_t n, size_t k,
+             const real_t *a, size_t lda,
+             const real_t *b, size_t ldb,
+             real_t *c, size_t ldc);
+
+/**
+ * @brief Whether a gemm operand is used as stored or transposed.
+ */
+enum class Transpose { NO, YES };
+
+/**
+ * @brief General matrix product C = alpha * op(A) * op(B) + beta * C (all row-major).
+ *
+ * Blocked for L1/L2/L3: op(A) and op(B) are packed into contiguous panels that the 4 x 8
+ * register-tiled SIMD micro-kernel streams through, so the transposes cost nothing in the
+ * inner loop. Packing buffers are per thread, so concurrent calls are safe.
+ *
+ * @param trans_a Whether A is transposed (op(A) is m x k either way).
+ * @param trans_b Whether B is transposed (op(B) is k x n either way).
+ * @param m Number of rows of op(A) and C.
+ * @param n Number of columns of op(B) and C.
+ * @param k Shared inner dimension.
+ * @param alpha Scale of the product.
+ * @param a Row-major A with leading dimension lda.
+ * @param lda Leading dimension of A.
+ * @param b Row-major B with leading dimension ldb.
+ * @param ldb Leading dimension of B.
+ * @param beta Scale of the previous C (0 ignores its contents).
+ * @param c Row-major m x n output with leading dimension ldc.
+ * @param ldc Leading dimension of C.
+ */
+void gemm(Transpose trans_a, Transpose trans_b,
+          size_t m, size_t n, size_t k,
+          real_t alpha, const real_t *a, size_t lda,
+          const real_t *b, size_t ldb,
+          real_t beta, real_t *c, size_t ldc);
+
+/**
+ * @brief Integer matrix-vector product y = W * x with signed 8-bit weights and unsigned 8-bit inputs.
+ *
+ * Dispatches once at runtime to AVX-VNNI (vpdpbusd), AVX2 (vpmaddubsw) or a portable scalar
+ * loop. The AVX2 kernel adds adjacent u8 x s8 products in saturating 16-bit lanes, so weights
+ * must lie in [-64, 64] for all kernels to agree.
+ *
+ * @param m Number of rows of W (length of y).
+ * @param n Number of columns of W (length of x).
+ * @param w Row-major m x n weights with leading dimension ldw.
+ * @param ldw Leading dimension of W.
+ * @param x Input vector of length n.
+ * @param y Output vector of length m (overwritten).
+ */
+void gemv_u8s8(size_t m, size_t n, const int8_t *w, size_t ldw, const uint8_t *x, int32_t *y);
+
+/**
+ * @brief Returns the name of the kernel gemv_u8s8 dispatches to on this machine.
+ * @return "avx-vnni", "avx2" or "scalar".
+ */
+const char *int8_kernel_name();
+
+/**
+ * @brief Finds the smallest element of a vector.
+ * @param values Pointer to the values.
+ * @param n Number of values (must be positive).
+ * @param min_value Receives the smallest value.
+ * @return Index of the smallest value (the lowest index on ties).
+ */
+size_t argmin(const real_t *values, size_t n, real_t &min_value);
+
+} // namespace linalg
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Kind of model stored in a model file.
+ */
+enum class ModelType : uint32_t {
+    NEURAL_NETWORK = 1,     ///< CompiledModel: layer shapes and one parameter block.
+    NEAREST_CENTROID = 2,   ///< NearestCentroidClassifier: centroids, norms and labels.
+    KNN_INDEX = 3           ///< KNNIndex: training features and labels.
+};
+
+/**
+ * @brief Builds a four-character section tag, e.g. section_tag("PARM").
+ * @param name Four ASCII characters.
+ * @return Tag value.
+ */
+constexpr uint32_t section_tag(const char (&name)[5]) {
+    return static_cast<uint32_t>(static_cast<uint8_t>(name[0]))
+         | static_cast<uint32_t>(static_cast<uint8_t>(name[1])) << 8
+         | static_cast<uint32_t>(static_cast<uint8_t>(name[2])) << 16
+         | static_cast<uint32_t>(static_cast<uint8_t>(name[3])) << 24;
+}
+
+/**
+ * @brief Version of the file layout written by ModelWriter.
+ */
+const uint32_t MODEL_FILE_VERSION = 1;
+
+/**
+ * @brief Alignment of every section in the file (and therefore in memory once mapped).
+ */
+const size_t MODEL_SECTION_ALIGNMENT = 64;
+
+/**
+ * @brief Computes the CRC-32 (IEEE 802.3) of a byte range.
+ * @param data Bytes to hash.
+ * @param size Number of bytes.
+ * @param crc CRC of the preceding bytes, to hash a stream in pieces (0 to start).
+ * @return CRC of everything hashed so far.
+ */
+uint32_t crc32(const void *data, size_t size, uint32_t crc = 0);
+
+/**
+ * @brief Writes a model file: a fixed header, a section table, then each section's bytes
+ * starting on a 64-byte boundary.
+ *
+ * The header records the layout version, the model type, sizeof(real_t) and a CRC-32 of
+ * everything after the header. Sections only reference the caller's memory, which must stay
+ * valid until save() returns.
+ */
+class ModelWriter {
+private:
+    /**
+     * @brief One section queued for writing.
+     */
+    struct Section {
+        uint32_t tag;       ///< Four-character tag.
+        const void *data;   ///< Caller-owned bytes.
+        size_t size;        ///< Number of bytes.
+    };
+
+    /**
+     * @brief Kind of model being written.
+     */
+    ModelType type;
+
+    /**
+     * @brief Sections in file order.
+     */
+    std::vector<Section> sections;
+
+public:
+    /**
+     * @brief Starts an empty file of the given model type.
+     * @param type Kind of model.
+     */
+    explicit ModelWriter(ModelType type);
+
+    /**
+     * @brief Queues a section.
+     * @param tag Four-character tag (see section_tag); must be unique in the file.
+     * @param data Section bytes, kept by reference until save().
+     * @param size Number of bytes.
+     */
+    void add_section(uint32_t tag, const void *data, size_t size);
+
+    /**
+     * @brief Writes the file to a temporary path, then renames it over path, so readers never
+     * see a half-written model.
+     * @param path Destination file.
+     * @return True on success; failures are reported on std::cerr.
+     */
+    bool save(const std::string &path) const;
+};
+
+/**
+ * @brief Read-only memory mapping of a model file.
+ *
+ * open() validates the magic, byte order, version, model type, real_t size, section bounds
+ * and checksum. Section pointers stay valid, 64-byte aligned and shared between threads for
+ * as long as the mapping is alive, so models can point straight into it instead of copying.
+ */
+class MappedModelFile {
+private:
+    /**
+     * @brief Start of the mapping.
+     */
+    const uint8_t *base;
+
+    /**
+     * @brief Size of the mapping in bytes.
+     */
+    size_t size;
+
+    MappedModelFile(const uint8_t *base, size_t size);
+
+public:
+    /**
+     * @brief Unmaps the file.
+     */
+    ~MappedModelFile();
+
+    MappedModelFile(const MappedModelFile &) = delete;
+    MappedModelFile &operator=(const MappedModelFile &) = delete;
+
+    /**
+     * @brief Maps and validates a model file.
+     * @param path File to open.
+     * @param type Expected model type.
+     * @return Shared mapping, or nullptr (with a message on std::cerr) if the file is missing,
+     * corrupt, of another type or was written with a different real_t.
+     */
+    static std::shared_ptr<const MappedModelFile> open(const std::string &path, ModelType type);
+
+    /**
+     * @brief Looks up a section.
+     * @param tag Four-character tag.
+     * @param bytes Receives the section size (0 if absent).
+     * @return Pointer to the section bytes, or nullptr if absent.
+     */
+    const void *section(uint32_t tag, size_t &bytes) const;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+/**
+ * @brief Floating-point compute type of the project.
+ *
+ * Normalized features, weights, centroids and distances are stored and computed as
+ * real_t. It is float by default, which doubles the SIMD width and halves the memory
+ * traffic of double; build with -DRTML_DOUBLE (make PRECISION=double) to go back to double.
+ */
+#if defined(RTML_DOUBLE)
+typedef double real_t;
+#else
+typedef float real_t;
+#endif
+
+/**
+ * @brief Accumulator type of the linalg reductions (dot products, distances, GEMV rows).
+ *
+ * Equal to real_t unless built with -DRTML_DOUBLE_ACCUMULATE (make PRECISION=mixed), which
+ * keeps float storage but sums those reductions in double. Long-running sums over many
+ * samples (cluster sums, epoch errors, accuracies) are always double.
+ */
+#if defined(RTML_DOUBLE) || defined(RTML_DOUBLE_ACCUMULATE)
+typedef double accum_t;
+#else
+typedef float accum_t;
+#endif
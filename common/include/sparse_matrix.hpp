@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "data_point.hpp"
+#include "precision.hpp"
+
+/**
+ * @brief Read-only matrix in compressed sparse row (CSR) form.
+ *
+ * Row r keeps the column index and value of each of its non-zero entries, in increasing
+ * column order, in indices/values[row_offsets[r], row_offsets[r + 1]). Built once from a
+ * sample set, it lets a kernel skip the zero features of every row, which on MNIST is most
+ * of them.
+ */
+class SparseMatrix {
+private:
+    /**
+     * @brief Number of columns (features per row).
+     */
+    size_t num_cols;
+
+    /**
+     * @brief num_rows + 1 offsets into indices and values.
+     */
+    std::vector<size_t> row_offsets;
+
+    /**
+     * @brief Column of every non-zero entry.
+     */
+    std::vector<uint32_t> indices;
+
+    /**
+     * @brief Value of every non-zero entry.
+     */
+    std::vector<real_t> values;
+
+public:
+    /**
+     * @brief Creates an empty matrix with no rows.
+     */
+    SparseMatrix();
+
+    /**
+     * @brief Converts the normalized feature vectors of a sample set, one row per sample.
+     * @param samples Data points that all have the same number of normalized features.
+     */
+    explicit SparseMatrix(const std::vector<DataPoint *> &samples);
+
+    /**
+     * @brief Returns the number of rows.
+     * @return Number of rows.
+     */
+    size_t rows() const;
+
+    /**
+     * @brief Returns the number of columns.
+     * @return Number of columns.
+     */
+    size_t cols() const;
+
+    /**
+     * @brief Returns the number of stored (non-zero) entries.
+     * @return Number of non-zero entries.
+     */
+    size_t nonzeros() const;
+
+    /**
+     * @brief Returns the fraction of entries that are non-zero.
+     * @return nonzeros() / (rows() * cols()), 0 for an empty matrix.
+     */
+    double density() const;
+
+    /**
+     * @brief Returns the number of non-zero entries of a row.
+     * @param row Row index.
+     * @return Number of entries in row_indices(row) and row_values(row).
+     */
+    size_t row_nonzeros(size_t row) const;
+
+    /**
+     * @brief Returns the column indices of a row's non-zero entries.
+     * @param row Row index.
+     * @return Pointer to row_nonzeros(row) increasing column indices.
+     */
+    const uint32_t *row_indices(size_t row) const;
+
+    /**
+     * @brief Returns the values of a row's non-zero entries.
+     * @param row Row index.
+     * @return Pointer to row_nonzeros(row) values.
+     */
+    const real_t *row_values(size_t row) const;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ *
+ * A power-of-two ring indexed by two free-running counters: the producer only writes `tail`,
+ * the consumer only writes `head`, and each side keeps a private copy of the other's counter
+ * that it refreshes only when the ring looks full (or empty). The counters live on separate
+ * cache lines, so a push and a pop touch shared memory only when they have to.
+ */
+template <typename T>
+class SpscQueue {
+private:
+    /**
+     * @brief Ring storage, a power of two long.
+     */
+    std::vector<T> ring;
+
+    /**
+     * @brief ring.size() - 1.
+     */
+    size_t mask;
+
+    /**
+     * @brief Next index to pop (written by the consumer) and the consumer's copy of tail.
+     */
+    alignas(64) std::atomic<size_t> head;
+    size_t cached_tail;
+
+    /**
+     * @brief Next index to push (written by the producer) and the producer's copy of head.
+     */
+    alignas(64) std::atomic<size_t> tail;
+    size_t cached_head;
+
+public:
+    /**
+     * @brief Creates an empty queue.
+     * @param capacity Minimum number of queued elements (rounded up to a power of two).
+     */
+    explicit SpscQueue(size_t capacity) : head(0), cached_tail(0), tail(0), cached_head(0) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        ring.resize(size);
+        mask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    /**
+     * @brief Appends an element; producer thread only.
+     * @param value Element to append.
+     * @return False if the queue is full.
+     */
+    bool try_push(const T &value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        if (position - cached_head == ring.size()) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (position - cached_head == ring.size()) {
+                return false;
+            }
+        }
+        ring[position & mask] = value;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest element; consumer thread only.
+     * @param value Receives the element.
+     * @return False if the queue is empty.
+     */
+    bool try_pop(T &value) {
+        size_t position = head.load(std::memory_order_relaxed);
+        if (position == cached_tail) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (position == cached_tail) {
+                return false;
+            }
+        }
+        value = ring[position & mask];
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Returns the number of elements the queue can hold.
+     * @return Ring size.
+     */
+    size_t capacity() const {
+        return ring.size();
+    }
+};
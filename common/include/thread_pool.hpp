@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Work-stealing scheduler shared by every parallel loop in the project.
+ *
+ * A pool of N threads is the calling thread plus N - 1 workers. parallel_for() hands the
+ * whole index range to the calling thread's deque as one task; whoever runs a task larger
+ * than the grain splits off its upper half onto its own deque and keeps the lower half, so
+ * ranges are divided only as far as idle threads ask for work. An idle thread takes the
+ * oldest (largest) task of the next non-empty deque after its own. The caller of parallel_for() keeps
+ * executing tasks until its range is done, which also makes nested parallel_for() calls from
+ * inside a task safe.
+ *
+ * Threads outside the pool share slot 0, so only one of them at a time drives the workers. A
+ * parallel_for() from another outside thread meanwhile runs serially on that thread instead of
+ * waiting, so concurrent callers (e.g. serving threads) never queue behind each other.
+ * Idle workers sleep on a condition variable and cost nothing between loops.
+ *
+ * Most code uses shared(), whose size is the project's single thread-count knob: the
+ * RTML_THREADS environment variable, else set_shared_threads(), else the hardware concurrency.
+ */
+class ThreadPool {
+private:
+    /**
+     * @brief Index range of one parallel_for() call still to be executed.
+     */
+    struct Job {
+        const std::function<void(size_t, size_t)> *body;  ///< Loop body over [begin, end).
+        size_t grain;                                     ///< Largest range run without splitting.
+        std::atomic<size_t> remaining;                    ///< Indices not yet executed.
+    };
+
+    /**
+     * @brief Part of a job's range.
+     */
+    struct Task {
+        Job *job;
+        size_t begin;
+        size_t end;
+    };
+
+    /**
+     * @brief Tasks of one thread; the owner works at the back, thieves take from the front.
+     */
+    struct alignas(64) TaskQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    /**
+     * @brief One queue per thread, slot 0 for threads outside the pool.
+     */
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+
+    /**
+     * @brief Worker threads (slots 1 to N - 1).
+     */
+    std::vector<std::thread> workers;
+
+    /**
+     * @brief Number of tasks in all queues.
+     */
+    std::atomic<size_t> queued;
+
+    /**
+     * @brief Number of workers asleep or about to sleep.
+     */
+    std::atomic<unsigned> idle;
+
+    /**
+     * @brief Cleared by the destructor.
+     */
+    std::atomic<bool> running;
+
+    /**
+     * @brief Sleep and wake-up of idle workers.
+     */
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+
+    /**
+     * @brief Held by the thread outside the pool whose parallel_for() is using slot 0.
+     */
+    std::mutex external;
+
+    /**
+     * @brief Appends a task to a thread's queue and wakes a sleeping worker.
+     */
+    void push(unsigned slot, const Task &task);
+
+    /**
+     * @brief Takes the newest task of a thread's own queue, else steals the oldest task of another.
+     */
+    bool take(unsigned slot, Task &task);
+
+    /**
+     * @brief Runs a task, splitting off halves onto the thread's queue until it fits the grain.
+     */
+    void execute(unsigned slot, Task task);
+
+    /**
+     * @brief Body of worker thread `slot`.
+     */
+    void work(unsigned slot, bool pin);
+
+    /**
+     * @brief Non-template part of parallel_for().
+     */
+    void run(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> &body);
+
+public:
+    /**
+     * @brief Starts num_threads - 1 worker threads.
+     * @param num_threads Threads including the caller (0 = hardware concurrency).
+     * @param pin Pin worker i to CPU i modulo the number of CPUs (Linux only).
+     */
+    explicit ThreadPool(unsigned num_threads = 0, bool pin = false);
+
+    /**
+     * @brief Stops and joins the workers; no parallel_for() may be running.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * @brief Calls body(first, last) on disjoint subranges covering [begin, end), in parallel,
+     * and returns when all are done.
+     * @param begin First index.
+     * @param end One past the last index.
+     * @param grain Largest subrange passed to body (0 = about 8 subranges per thread).
+     * @param body Callable taking (size_t first, size_t last).
+     */
+    template <typename Body>
+    void parallel_for(size_t begin, size_t end, size_t grain, Body &&body) {
+        if (end <= begin) {
+            return;
+        }
+        if (grain == 0) {
+            grain = std::max<size_t>(1, (end - begin) / (8 * size()));
+        }
+        if (end - begin <= grain || size() == 1) {
+            body(begin, end);
+            return;
+        }
+        std::function<void(size_t, size_t)> function = std::ref(body);
+        run(begin, end, grain, function);
+    }
+
+    /**
+     * @brief Returns the number of threads, including the caller's slot.
+     * @return Thread count.
+     */
+    unsigned size() const;
+
+    /**
+     * @brief Returns the slot of the calling thread in this pool.
+     * @return 1 to size() - 1 on a worker, 0 on any other thread.
+     */
+    unsigned current_slot() const;
+
+    /**
+     * @brief Returns the pool shared by the whole process, creating it on first use.
+     * @return Shared pool.
+     */
+    static ThreadPool &shared();
+
+    /**
+     * @brief Replaces the shared pool; only call when no parallel work is running.
+     * Ignored when RTML_THREADS is set.
+     * @param num_threads Threads including the caller (0 = hardware concurrency).
+     * @param pin Pin the workers to CPUs.
+     */
+    static void set_shared_threads(unsigned num_threads, bool pin = false);
+};
+
+/**
+ * @brief One T per thread of a pool, each on its own cache lines, for scratch buffers and
+ * partial results that tasks reuse without locking.
+ *
+ * Create one per loop: threads outside the pool all map to slot 0, which is only safe
+ * because a loop is driven by a single outside thread and only one of them uses the pool.
+ */
+template <typename T>
+class PerThread {
+private:
+    struct alignas(64) Entry {
+        T value;
+    };
+
+    const ThreadPool &pool;
+    std::vector<Entry> entries;
+
+public:
+    /**
+     * @brief Creates size() copies of a value.
+     * @param pool Pool whose threads index the values.
+     * @param value Initial value of every copy.
+     */
+    explicit PerThread(const ThreadPool &pool, const T &value = T()) : pool(pool), entries(pool.size(), Entry{value}) {}
+
+    /**
+     * @brief Returns the calling thread's value.
+     * @return Value of the current slot.
+     */
+    T &local() {
+        return entries[pool.current_slot()].value;
+    }
+
+    /**
+     * @brief Returns the value of a slot (for combining results after the loop).
+     * @param slot Slot index.
+     * @return Value.
+     */
+    T &operator[](size_t slot) {
+        return entries[slot].value;
+    }
+
+    /**
+     * @brief Returns the number of slots.
+     * @return Pool size.
+     */
+    size_t size() const {
+        return entries.size();
+    }
+};
@@ -0,0 +1,213 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include "benchmark.hpp"
+#include "precision.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+/**
+ * std::cout's buffer while it is silenced.
+ */
+std::streambuf *saved_output = nullptr;
+
+/**
+ * Nearest-rank percentile of sorted values.
+ */
+double percentile(const std::vector<double> &sorted, double p) {
+    size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+/**
+ * Name of the build's PRECISION setting.
+ */
+const char *precision_name() {
+#if defined(RTML_DOUBLE)
+    return "double";
+#elif defined(RTML_DOUBLE_ACCUMULATE)
+    return "mixed";
+#else
+    return "float";
+#endif
+}
+
+/**
+ * Writes a string as a JSON string literal.
+ */
+void write_string(std::ostream &out, const std::string &value) {
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out << '\\';
+        }
+        out << c;
+    }
+    out << '"';
+}
+
+/**
+ * Writes a 32-bit big-endian integer (the IDX byte order).
+ */
+void write_big_endian(std::ofstream &out, uint32_t value) {
+    unsigned char bytes[4] = {static_cast<unsigned char>(value >> 24), static_cast<unsigned char>(value >> 16),
+                              static_cast<unsigned char>(value >> 8), static_cast<unsigned char>(value)};
+    out.write(reinterpret_cast<const char *>(bytes), 4);
+}
+
+} // namespace
+
+Benchmark::Benchmark(const std::string &suite, double budget_seconds)
+    : suite(suite), budget_seconds(budget_seconds) {}
+
+double Benchmark::now_ns() {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Benchmark::quiet(bool enabled) {
+    if (enabled) {
+        saved_output = std::cout.rdbuf(nullptr);
+    } else {
+        std::cout.rdbuf(saved_output);
+    }
+}
+
+const BenchmarkResult &Benchmark::record(const std::string &name, std::vector<double> &sample_ns,
+                                         size_t ops_per_sample, size_t items_per_op) {
+    std::sort(sample_ns.begin(), sample_ns.end());
+    double total = 0.0;
+    for (double ns : sample_ns) {
+        total += ns;
+    }
+
+    BenchmarkResult result;
+    result.name = name;
+    result.samples = sample_ns.size();
+    result.ops_per_sample = ops_per_sample;
+    result.items_per_op = items_per_op;
+    result.mean_ns = total / static_cast<double>(sample_ns.size());
+    result.p50_ns = percentile(sample_ns, 0.50);
+    result.p90_ns = percentile(sample_ns, 0.90);
+    result.p99_ns = percentile(sample_ns, 0.99);
+    result.min_ns = sample_ns.front();
+    result.max_ns = sample_ns.back();
+    result.ops_per_second = 1e9 / result.mean_ns;
+    result.items_per_second = result.ops_per_second * static_cast<double>(items_per_op);
+    results.push_back(result);
+
+    std::ios::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << std::fixed << std::setprecision(1) << suite << "/" << name << ": " << result.mean_ns
+              << " ns/op (p50 " << result.p50_ns << ", p99 " << result.p99_ns << "), " << result.items_per_second
+              << " items/s" << std::endl;
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+    return results.back();
+}
+
+void Benchmark::write_json(std::ostream &out) const {
+    out << "{\n  \"suite\": ";
+    write_string(out, suite);
+    out << ",\n  \"precision\": \"" << precision_name() << "\",\n  \"threads\": " << ThreadPool::shared().size()
+        << ",\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult &r = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": ";
+        write_string(out, r.name);
+        out << ", \"samples\": " << r.samples << ", \"ops_per_sample\": " << r.ops_per_sample
+            << ", \"items_per_op\": " << r.items_per_op << ", \"ns_per_op\": " << r.mean_ns
+            << ", \"p50_ns\": " << r.p50_ns << ", \"p90_ns\": " << r.p90_ns << ", \"p99_ns\": " << r.p99_ns
+            << ", \"min_ns\": " << r.min_ns << ", \"max_ns\": " << r.max_ns
+            << ", \"ops_per_second\": " << r.ops_per_second << ", \"items_per_second\": " << r.items_per_second << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+bool Benchmark::save(const std::string &path) const {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Error: cannot write benchmark results to '" << path << "'." << std::endl;
+        return false;
+    }
+    write_json(out);
+    return static_cast<bool>(out);
+}
+
+namespace synthetic {
+
+/**
+ * About a quarter of each prototype's pixels are ink (128-255); samples jitter the ink and
+ * flip a few pixels, which keeps the sparsity and value range of MNIST.
+ */
+bool write_idx(const std::string &images_path, const std::string &labels_path, size_t count, size_t rows,
+               size_t cols, int classes, uint32_t seed) {
+    std::ofstream images(images_path, std::ios::binary), labels(labels_path, std::ios::binary);
+    if (!images || !labels) {
+        std::cerr << "Error: cannot write synthetic IDX files '" << images_path << "', '" << labels_path << "'."
+                  << std::endl;
+        return false;
+    }
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> noise(0.0, 32.0);
+    size_t pixels = rows * cols;
+
+    std::vector<std::vector<double>> prototypes(classes, std::vector<double>(pixels, 0.0));
+    for (std::vector<double> &prototype : prototypes) {
+        for (double &value : prototype) {
+            value = uniform(gen) < 0.25 ? 128.0 + 127.0 * uniform(gen) : 0.0;
+        }
+    }
+
+    write_big_endian(images, 2051);
+    write_big_endian(images, static_cast<uint32_t>(count));
+    write_big_endian(images, static_cast<uint32_t>(rows));
+    write_big_endian(images, static_cast<uint32_t>(cols));
+    write_big_endian(labels, 2049);
+    write_big_endian(labels, static_cast<uint32_t>(count));
+
+    std::vector<char> image(pixels);
+    for (size_t i = 0; i < count; ++i) {
+        int label = static_cast<int>(i % static_cast<size_t>(classes));
+        for (size_t p = 0; p < pixels; ++p) {
+            double value = prototypes[label][p];
+            if (uniform(gen) < 0.03) {
+                value = value > 0.0 ? 0.0 : 255.0 * uniform(gen);
+            } else if (value > 0.0) {
+                value += noise(gen);
+            }
+            image[p] = static_cast<char>(static_cast<unsigned char>(std::min(255.0, std::max(0.0, value))));
+        }
+        images.write(image.data(), static_cast<std::streamsize>(pixels));
+        char byte = static_cast<char>(label);
+        labels.write(&byte, 1);
+    }
+    return static_cast<bool>(images) && static_cast<bool>(labels);
+}
+
+bool write_csv(const std::string &path, size_t count, size_t features, int classes, uint32_t seed) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Error: cannot write synthetic CSV file '" << path << "'." << std::endl;
+        return false;
+    }
+    std::mt19937 gen(seed);
+    std::normal_distribution<double> noise(0.0, 0.5);
+    char value[32];
+    for (size_t i = 0; i < count; ++i) {
+        int label = static_cast<int>(i % static_cast<size_t>(classes));
+        for (size_t f = 0; f < features; ++f) {
+            std::snprintf(value, sizeof(value), "%.3f,", 2.0 * label + static_cast<double>(f) + noise(gen));
+            out << value;
+        }
+        out << "class-" << label << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+} // namespace synthetic
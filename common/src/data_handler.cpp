@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <iostream>
 #include <cstdlib>
 #include <unordered_set>
 #include "data_handler.hpp"
+#include "instrumentation.hpp"
+#include "thread_pool.hpp"
 
 // Constructor
 DataHandler::DataHandler() noexcept {
@@ -13,6 +16,10 @@ DataHandler::DataHandler() noexcept {
 
 // Destructor
 DataHandler::~DataHandler() {
+    // The sets only borrow the points of data_array
+    for (DataPoint *dp : *data_array) {
+        delete dp;
+    }
     delete data_array;
     delete training_data;
     delete test_data;
@@ -20,21 +27,23 @@ DataHandler::~DataHandler() {
 }
 
 void DataHandler::read_csv(const std::string &path, const std::string &delim) {
+    RTML_TIMER("data_handler.read_csv");
     this->num_classes = 0;
     std::ifstream data_file(path.c_str());
     std::string line;
 
     while (std::getline(data_file, line)) {
+        RTML_COUNT("data_handler.bytes_read", line.size() + 1);
         if (line.empty()) continue;
 
         auto *d = new DataPoint();
-        d->set_normalized_feature_vector(new std::vector<double>());
+        d->set_normalized_feature_vector(new std::vector<real_t>());
 
         size_t pos = 0;
         std::string token;
         while ((pos = line.find(delim)) != std::string::npos) {
             token = line.substr(0, pos);
-            d->append_to_normalized_feature_vector(std::stod(token));
+            d->append_to_normalized_feature_vector(static_cast<real_t>(std::stod(token)));
             line.erase(0, pos + delim.length());
         }
 
@@ -55,6 +64,7 @@ void DataHandler::read_csv(const std::string &path) {
 }
 
 void DataHandler::read_input_data(const std::string &path) {
+    RTML_TIMER("data_handler.read_input");
     uint32_t header[4];
     unsigned char bytes[4];
     FILE *fp = fopen(path.c_str(), "r");
@@ -86,12 +96,14 @@ void DataHandler::read_input_data(const std::string &path) {
         }
         data_array->push_back(dp);
     }
+    RTML_COUNT("data_handler.bytes_read", sizeof(header) + static_cast<uint64_t>(header[1]) * image_size);
 
     std::cout << "Successfully read and stored " << data_array->size() << " feature vectors." << std::endl;
     fclose(fp);
 }
 
 void DataHandler::read_label_data(const std::string &path) {
+    RTML_TIMER("data_handler.read_labels");
     uint32_t header[2];
     unsigned char bytes[4];
     FILE *fp = fopen(path.c_str(), "r");
@@ -117,6 +129,7 @@ void DataHandler::read_label_data(const std::string &path) {
         }
         data_array->at(i)->set_label(element[0]);
     }
+    RTML_COUNT("data_handler.bytes_read", sizeof(header) + header[1]);
 
     std::cout << "Successfully read and stored labels." << std::endl;
     fclose(fp);
@@ -135,6 +148,7 @@ static void select_random_data(std::vector<DataPoint *> *target, std::unordered_
 }
 
 void DataHandler::split_data() {
+    RTML_TIMER("data_handler.split");
     std::unordered_set<int> used;
 
     int total = static_cast<int>(data_array->size());
@@ -169,39 +183,78 @@ uint32_t DataHandler::convert_to_little_endian(const unsigned char *bytes) {
     return (uint32_t)((bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3]);
 }
 
-void DataHandler::normalize() {
-    std::vector<double> mins, maxs;
-    auto *first = data_array->at(0);
-
-    for (auto val : *first->get_feature_vector()) {
-        mins.push_back(val);
-        maxs.push_back(val);
+/**
+ * Calls fn(j, value) on every raw feature of a point, read in place. IDX images keep their raw
+ * bytes in the feature vector, while read_csv parses values straight into the normalized
+ * vector, which is then normalized in place.
+ */
+template <typename Fn>
+static void for_each_raw_feature(DataPoint *dp, Fn fn) {
+    if (!dp->get_feature_vector()->empty() || !dp->get_normalized_feature_vector()) {
+        const std::vector<uint8_t> &values = *dp->get_feature_vector();
+        for (size_t j = 0; j < values.size(); ++j) {
+            fn(j, static_cast<double>(values[j]));
+        }
+    } else {
+        const std::vector<real_t> &values = *dp->get_normalized_feature_vector();
+        for (size_t j = 0; j < values.size(); ++j) {
+            fn(j, static_cast<double>(values[j]));
+        }
     }
+}
 
-    for (size_t i = 1; i < data_array->size(); ++i) {
-        auto *dp = data_array->at(i);
-        for (size_t j = 0; j < dp->get_feature_vector()->size(); ++j) {
-            double val = dp->get_feature_vector()->at(j);
-            mins[j] = std::min(mins[j], val);
-            maxs[j] = std::max(maxs[j], val);
+/**
+ * Both passes run on the shared thread pool: per-thread ranges merged after the first pass,
+ * then every point normalized independently into a vector sized once, which replaces its
+ * source only when complete.
+ */
+void DataHandler::normalize() {
+    RTML_TIMER("data_handler.normalize");
+    std::vector<double> &mins = feature_mins;
+    std::vector<double> &maxs = feature_maxs;
+    mins.clear();
+    for_each_raw_feature(data_array->at(0), [&](size_t, double value) { mins.push_back(value); });
+    maxs = mins;
+
+    ThreadPool &pool = ThreadPool::shared();
+    PerThread<std::vector<double>> local_mins(pool, mins), local_maxs(pool, maxs);
+    pool.parallel_for(1, data_array->size(), 0, [&](size_t first, size_t last) {
+        std::vector<double> &lo = local_mins.local();
+        std::vector<double> &hi = local_maxs.local();
+        for (size_t i = first; i < last; ++i) {
+            for_each_raw_feature(data_array->at(i), [&](size_t j, double value) {
+                lo[j] = std::min(lo[j], value);
+                hi[j] = std::max(hi[j], value);
+            });
+        }
+    });
+    for (size_t t = 0; t < local_mins.size(); ++t) {
+        for (size_t j = 0; j < mins.size(); ++j) {
+            mins[j] = std::min(mins[j], local_mins[t][j]);
+            maxs[j] = std::max(maxs[j], local_maxs[t][j]);
         }
     }
 
-    for (auto *dp : *data_array) {
-        dp->set_normalized_feature_vector(new std::vector<double>());
-        dp->set_class_vector(num_classes);
-
-        for (size_t j = 0; j < dp->get_feature_vector()->size(); ++j) {
-            double norm;
-            if (maxs[j] - mins[j] == 0) {
-                norm = 0.0;
-            } else {
-                double raw = dp->get_feature_vector()->at(j);
-                norm = (raw - mins[j]) / (maxs[j] - mins[j]);
-            }
-            dp->append_to_normalized_feature_vector(norm);
+    pool.parallel_for(0, data_array->size(), 0, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            DataPoint *dp = data_array->at(i);
+            std::vector<real_t> *normalized = new std::vector<real_t>(mins.size());
+            for_each_raw_feature(dp, [&](size_t j, double value) {
+                double range = maxs[j] - mins[j];
+                (*normalized)[j] = static_cast<real_t>(range == 0 ? 0.0 : (value - mins[j]) / range);
+            });
+            dp->set_normalized_feature_vector(normalized);
+            dp->set_class_vector(num_classes);
         }
-    }
+    });
+}
+
+const std::vector<double> &DataHandler::get_feature_mins() const {
+    return feature_mins;
+}
+
+const std::vector<double> &DataHandler::get_feature_maxs() const {
+    return feature_maxs;
 }
 
 int DataHandler::get_class_count() const {
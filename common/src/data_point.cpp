@@ -26,14 +26,14 @@ void DataPoint::append_to_feature_vector(uint8_t value) {
     feature_vector->push_back(value);
 }
 
-void DataPoint::set_normalized_feature_vector(std::vector<double> *vector) {
+void DataPoint::set_normalized_feature_vector(std::vector<real_t> *vector) {
     delete normalized_feature_vector;
     normalized_feature_vector = vector;
 }
 
-void DataPoint::append_to_normalized_feature_vector(double value) {
+void DataPoint::append_to_normalized_feature_vector(real_t value) {
     if (!normalized_feature_vector) {
-        normalized_feature_vector = new std::vector<double>();
+        normalized_feature_vector = new std::vector<real_t>();
     }
     normalized_feature_vector->push_back(value);
 }
@@ -78,7 +78,7 @@ std::vector<uint8_t>* DataPoint::get_feature_vector() {
     return feature_vector;
 }
 
-std::vector<double>* DataPoint::get_normalized_feature_vector() {
+std::vector<real_t>* DataPoint::get_normalized_feature_vector() {
     return normalized_feature_vector;
 }
 
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "instrumentation.hpp"
+
+namespace instrumentation {
+
+namespace {
+
+/**
+ * Every metric of the process, by name. Entries are never removed, so references stay valid.
+ */
+struct Registry {
+    std::mutex mutex;
+    std::map<std::string, std::unique_ptr<Counter>> counters;
+    std::map<std::string, std::unique_ptr<Histogram>> histograms;
+};
+
+Registry &registry() {
+    static Registry instance;
+    return instance;
+}
+
+/**
+ * Writes a string as a JSON string literal.
+ */
+void write_string(std::ostream &out, const std::string &value) {
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out << '\\';
+        }
+        out << c;
+    }
+    out << '"';
+}
+
+} // namespace
+
+Histogram::Histogram() : count(0), total(0), minimum(std::numeric_limits<uint64_t>::max()), maximum(0) {
+    for (std::atomic<uint64_t> &bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Values with highest set bit e >= SUB_BUCKET_BITS keep their top SUB_BUCKET_BITS + 1 bits:
+ * group e - SUB_BUCKET_BITS + 1, sub-bucket given by the bits below the leading one.
+ */
+size_t Histogram::bucket_of(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return static_cast<size_t>(value);
+    }
+    unsigned exponent = 63 - static_cast<unsigned>(__builtin_clzll(value));
+    if (exponent > MAX_EXPONENT) {
+        return NUM_BUCKETS - 1;
+    }
+    size_t sub_bucket = static_cast<size_t>(value >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t Histogram::bucket_value(size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    unsigned shift = static_cast<unsigned>(bucket / SUB_BUCKETS) - 1;
+    uint64_t lower = static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return lower + ((uint64_t{1} << shift) >> 1);
+}
+
+void Histogram::record(uint64_t nanoseconds) {
+    buckets[bucket_of(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(nanoseconds, std::memory_order_relaxed);
+    uint64_t seen = minimum.load(std::memory_order_relaxed);
+    while (nanoseconds < seen && !minimum.compare_exchange_weak(seen, nanoseconds, std::memory_order_relaxed)) {
+    }
+    seen = maximum.load(std::memory_order_relaxed);
+    while (nanoseconds > seen && !maximum.compare_exchange_weak(seen, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t Histogram::get_count() const {
+    return count.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::get_total() const {
+    return total.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::get_min() const {
+    return get_count() == 0 ? 0 : minimum.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::get_max() const {
+    return maximum.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::percentile(double fraction) const {
+    uint64_t recorded = get_count();
+    if (recorded == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(recorded)));
+    rank = std::min(std::max<uint64_t>(rank, 1), recorded);
+
+    uint64_t seen = 0;
+    size_t bucket = 0;
+    for (; bucket < NUM_BUCKETS - 1; ++bucket) {
+        seen += buckets[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            break;
+        }
+    }
+    return std::min(std::max(bucket_value(bucket), get_min()), get_max());
+}
+
+void Histogram::reset() {
+    for (std::atomic<uint64_t> &bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+    minimum.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+}
+
+Counter &counter(const std::string &name) {
+    Registry &metrics = registry();
+    std::lock_guard<std::mutex> lock(metrics.mutex);
+    std::unique_ptr<Counter> &entry = metrics.counters[name];
+    if (!entry) {
+        entry.reset(new Counter());
+    }
+    return *entry;
+}
+
+Histogram &histogram(const std::string &name) {
+    Registry &metrics = registry();
+    std::lock_guard<std::mutex> lock(metrics.mutex);
+    std::unique_ptr<Histogram> &entry = metrics.histograms[name];
+    if (!entry) {
+        entry.reset(new Histogram());
+    }
+    return *entry;
+}
+
+void reset() {
+    Registry &metrics = registry();
+    std::lock_guard<std::mutex> lock(metrics.mutex);
+    for (auto &entry : metrics.counters) {
+        entry.second->reset();
+    }
+    for (auto &entry : metrics.histograms) {
+        entry.second->reset();
+    }
+}
+
+void write_json(std::ostream &out) {
+    Registry &metrics = registry();
+    std::lock_guard<std::mutex> lock(metrics.mutex);
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(1);
+    out << "{\n  \"enabled\": " << (enabled ? "true" : "false") << ",\n  \"counters\": {";
+    bool first = true;
+    for (const auto &entry : metrics.counters) {
+        out << (first ? "\n    " : ",\n    ");
+        write_string(out, entry.first);
+        out << ": " << entry.second->get();
+        first = false;
+    }
+    out << (first ? "},\n" : "\n  },\n") << "  \"histograms\": {";
+    first = true;
+    for (const auto &entry : metrics.histograms) {
+        const Histogram &h = *entry.second;
+        uint64_t recorded = h.get_count();
+        double mean = recorded ? static_cast<double>(h.get_total()) / static_cast<double>(recorded) : 0.0;
+        out << (first ? "\n    " : ",\n    ");
+        write_string(out, entry.first);
+        out << ": {\"count\": " << recorded << ", \"total_ns\": " << h.get_total() << ", \"mean_ns\": " << mean
+            << ", \"min_ns\": " << h.get_min() << ", \"p50_ns\": " << h.percentile(0.50)
+            << ", \"p90_ns\": " << h.percentile(0.90) << ", \"p99_ns\": " << h.percentile(0.99)
+            << ", \"p999_ns\": " << h.percentile(0.999) << ", \"max_ns\": " << h.get_max() << "}";
+        first = false;
+    }
+    out << (first ? "}\n" : "\n  }\n") << "}\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+bool save(const std::string &path) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Error: cannot write instrumentation to '" << path << "'." << std::endl;
+        return false;
+    }
+    write_json(out);
+    return static_cast<bool>(out);
+}
+
+} // namespace instrumentation
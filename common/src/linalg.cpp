@@ -0,0 +1,678 @@
+#include <cstring>
+#include <type_traits>
+#include "aligned_allocator.hpp"
+#include "linalg.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LINALG_X86 1
+#endif
+
+namespace {
+
+// One 32-byte SIMD vector of real_t (8 floats or 4 doubles); lowered to whatever vector
+// unit the target has
+typedef real_t vec __attribute__((vector_size(32)));
+constexpr size_t VEC_LANES = sizeof(vec) / sizeof(real_t);
+
+// Reductions accumulate in accum_t: one 32-byte accumulator vector, filled by converting
+// ACC_LANES real_t values (a no-op unless accum_t is wider than real_t)
+typedef accum_t acc_vec __attribute__((vector_size(32)));
+constexpr size_t ACC_LANES = sizeof(acc_vec) / sizeof(accum_t);
+typedef real_t acc_src __attribute__((vector_size(ACC_LANES * sizeof(real_t))));
+
+// Integer lanes as wide as real_t, for comparison masks
+typedef std::conditional<sizeof(real_t) == 4, int32_t, int64_t>::type real_bits;
+typedef real_bits vec_bits __attribute__((vector_size(32)));
+
+// Cache blocking for gemm_nt: a block of B rows over a slice of k stays in L2
+const size_t GEMM_BLOCK_N = 64;
+const size_t GEMM_BLOCK_K = 256;
+
+// Native-width vector for the gemm micro-kernel. Its accumulators are loop-carried, and
+// wider-than-native generic vectors there get lowered through the stack.
+#if defined(__AVX__)
+typedef real_t vreg __attribute__((vector_size(32)));
+#else
+typedef real_t vreg __attribute__((vector_size(16)));
+#endif
+constexpr size_t VREG_LANES = sizeof(vreg) / sizeof(real_t);
+
+// Register tile of the packed gemm micro-kernel: 4 rows x 2 vectors = 8 accumulators
+constexpr size_t GEMM_MR = 4;
+constexpr size_t GEMM_NR = 2 * VREG_LANES;
+
+// Cache blocking for gemm: a KC x NC panel of op(B) stays in L3, an MC x KC block of op(A)
+// in L2, and one KC x NR sliver of op(B) in L1 across the micro-kernel calls
+const size_t GEMM_MC = 64;
+const size_t GEMM_KC = 256;
+const size_t GEMM_NC = 2048;
+
+} // namespace
+
+// Unaligned vector load that works for any element offset
+#define LOAD_VEC(dst, src) std::memcpy(&(dst), (src), sizeof(vec))
+
+// Unaligned load of ACC_LANES real_t values, widened to accum_t
+#define LOAD_ACC(dst, src)                                  \
+    do {                                                    \
+        acc_src raw_;                                       \
+        std::memcpy(&raw_, (src), sizeof(acc_src));         \
+        (dst) = __builtin_convertvector(raw_, acc_vec);     \
+    } while (0)
+
+// Sum of the accumulator lanes
+#define HSUM_ACC(result, acc)                               \
+    do {                                                    \
+        accum_t sum_ = 0;                                   \
+        for (size_t lane_ = 0; lane_ < ACC_LANES; ++lane_) { \
+            sum_ += (acc)[lane_];                           \
+        }                                                   \
+        (result) = sum_;                                    \
+    } while (0)
+
+namespace linalg {
+
+accum_t squared_distance(const real_t *a, const real_t *b, size_t n) {
+    acc_vec acc0 = {}, acc1 = {};
+    acc_vec x0, y0, x1, y1;
+    size_t i = 0;
+
+    // Two independent accumulators hide the FP add latency
+    for (; i + 2 * ACC_LANES <= n; i += 2 * ACC_LANES) {
+        LOAD_ACC(x0, a + i);
+        LOAD_ACC(y0, b + i);
+        LOAD_ACC(x1, a + i + ACC_LANES);
+        LOAD_ACC(y1, b + i + ACC_LANES);
+        acc_vec d0 = x0 - y0;
+        acc_vec d1 = x1 - y1;
+        acc0 += d0 * d0;
+        acc1 += d1 * d1;
+    }
+
+    acc0 += acc1;
+    accum_t sum;
+    HSUM_ACC(sum, acc0);
+    for (; i < n; ++i) {
+        accum_t diff = static_cast<accum_t>(a[i]) - static_cast<accum_t>(b[i]);
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+accum_t dot(const real_t *a, const real_t *b, size_t n) {
+    acc_vec acc0 = {}, acc1 = {};
+    acc_vec x0, y0, x1, y1;
+    size_t i = 0;
+
+    for (; i + 2 * ACC_LANES <= n; i += 2 * ACC_LANES) {
+        LOAD_ACC(x0, a + i);
+        LOAD_ACC(y0, b + i);
+        LOAD_ACC(x1, a + i + ACC_LANES);
+        LOAD_ACC(y1, b + i + ACC_LANES);
+        acc0 += x0 * y0;
+        acc1 += x1 * y1;
+    }
+
+    acc0 += acc1;
+    accum_t sum;
+    HSUM_ACC(sum, acc0);
+    for (; i < n; ++i) {
+        sum += static_cast<accum_t>(a[i]) * static_cast<accum_t>(b[i]);
+    }
+    return sum;
+}
+
+void axpy(size_t n, real_t alpha, const real_t *x, real_t *y) {
+    vec vx, vy;
+    size_t i = 0;
+    for (; i + VEC_LANES <= n; i += VEC_LANES) {
+        LOAD_VEC(vx, x + i);
+        LOAD_VEC(vy, y + i);
+        vy += alpha * vx;
+        std::memcpy(y + i, &vy, sizeof(vec));
+    }
+    for (; i < n; ++i) {
+        y[i] += alpha * x[i];
+    }
+}
+
+/**
+ * Scale y by beta, treating beta == 0 as "overwrite" so uninitialized outputs are fine.
+ */
+static void scale_output(size_t n, real_t beta, real_t *y) {
+    if (beta == 0) {
+        std::memset(y, 0, n * sizeof(real_t));
+    } else if (beta != 1) {
+        for (size_t i = 0; i < n; ++i) {
+            y[i] *= beta;
+        }
+    }
+}
+
+void gemv(size_t m, size_t n, real_t alpha, const real_t *a, size_t lda, const real_t *x, real_t beta, real_t *y) {
+    scale_output(m, beta, y);
+
+    // Four rows at a time share every load of x
+    size_t i = 0;
+    for (; i + 4 <= m; i += 4) {
+        const real_t *r0 = a + i * lda, *r1 = r0 + lda, *r2 = r1 + lda, *r3 = r2 + lda;
+        acc_vec acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {};
+        acc_vec vx, v0, v1, v2, v3;
+        size_t p = 0;
+        for (; p + ACC_LANES <= n; p += ACC_LANES) {
+            LOAD_ACC(vx, x + p);
+            LOAD_ACC(v0, r0 + p);
+            LOAD_ACC(v1, r1 + p);
+            LOAD_ACC(v2, r2 + p);
+            LOAD_ACC(v3, r3 + p);
+            acc0 += v0 * vx;
+            acc1 += v1 * vx;
+            acc2 += v2 * vx;
+            acc3 += v3 * vx;
+        }
+        accum_t s0, s1, s2, s3;
+        HSUM_ACC(s0, acc0);
+        HSUM_ACC(s1, acc1);
+        HSUM_ACC(s2, acc2);
+        HSUM_ACC(s3, acc3);
+        for (; p < n; ++p) {
+            accum_t xp = x[p];
+            s0 += r0[p] * xp;
+            s1 += r1[p] * xp;
+            s2 += r2[p] * xp;
+            s3 += r3[p] * xp;
+        }
+        y[i] += static_cast<real_t>(alpha * s0);
+        y[i + 1] += static_cast<real_t>(alpha * s1);
+        y[i + 2] += static_cast<real_t>(alpha * s2);
+        y[i + 3] += static_cast<real_t>(alpha * s3);
+    }
+    for (; i < m; ++i) {
+        y[i] += static_cast<real_t>(alpha * dot(a + i * lda, x, n));
+    }
+}
+
+void gemv_t(size_t m, size_t n, real_t alpha, const real_t *a, size_t lda, const real_t *x, real_t beta, real_t *y) {
+    scale_output(n, beta, y);
+
+    // Row-by-row accumulation keeps every access contiguous
+    for (size_t i = 0; i < m; ++i) {
+        axpy(n, alpha * x[i], a + i * lda, y);
+    }
+}
+
+void ger(size_t m, size_t n, real_t alpha, const real_t *x, const real_t *y, real_t *a, size_t lda) {
+    for (size_t i = 0; i < m; ++i) {
+        axpy(n, alpha * x[i], y, a + i * lda);
+    }
+}
+
+void sparse_gemv_t(size_t n, real_t alpha, const real_t *a, size_t lda,
+                   size_t nnz, const uint32_t *indices, const real_t *values, real_t beta, real_t *y) {
+    scale_output(n, beta, y);
+
+    // Column blocks outermost: each block of y stays in registers while the selected rows
+    // stream through it
+    size_t j = 0;
+    for (; j + 2 * VREG_LANES <= n; j += 2 * VREG_LANES) {
+        vreg acc0, acc1, v0, v1;
+        std::memcpy(&acc0, y + j, sizeof(vreg));
+        std::memcpy(&acc1, y + j + VREG_LANES, sizeof(vreg));
+        for (size_t k = 0; k < nnz; ++k) {
+            const real_t *row = a + indices[k] * lda + j;
+            real_t x = alpha * values[k];
+            std::memcpy(&v0, row, sizeof(vreg));
+            std::memcpy(&v1, row + VREG_LANES, sizeof(vreg));
+            acc0 += x * v0;
+            acc1 += x * v1;
+        }
+        std::memcpy(y + j, &acc0, sizeof(vreg));
+        std::memcpy(y + j + VREG_LANES, &acc1, sizeof(vreg));
+    }
+    for (; j + VREG_LANES <= n; j += VREG_LANES) {
+        vreg acc, v;
+        std::memcpy(&acc, y + j, sizeof(vreg));
+        for (size_t k = 0; k < nnz; ++k) {
+            std::memcpy(&v, a + indices[k] * lda + j, sizeof(vreg));
+            acc += (alpha * values[k]) * v;
+        }
+        std::memcpy(y + j, &acc, sizeof(vreg));
+    }
+    for (; j < n; ++j) {
+        real_t sum = 0;
+        for (size_t k = 0; k < nnz; ++k) {
+            sum += values[k] * a[indices[k] * lda + j];
+        }
+        y[j] += alpha * sum;
+    }
+}
+
+void sparse_ger(size_t n, real_t alpha, size_t nnz, const uint32_t *indices, const real_t *values,
+                const real_t *y, real_t *a, size_t lda) {
+    for (size_t k = 0; k < nnz; ++k) {
+        real_t *row = a + indices[k] * lda;
+        real_t x = alpha * values[k];
+        vreg vy, v;
+        size_t j = 0;
+        for (; j + VREG_LANES <= n; j += VREG_LANES) {
+            std::memcpy(&vy, y + j, sizeof(vreg));
+            std::memcpy(&v, row + j, sizeof(vreg));
+            v += x * vy;
+            std::memcpy(row + j, &v, sizeof(vreg));
+        }
+        for (; j < n; ++j) {
+            row[j] += x * y[j];
+        }
+    }
+}
+
+void bsr_gemv(size_t block_rows, const uint32_t *row_offsets, const uint32_t *block_cols, const real_t *blocks,
+              const real_t *x, real_t *y) {
+    static_assert(BSR_BLOCK_ROWS == 4, "bsr_gemv keeps one accumulator per block row");
+    static_assert(BSR_BLOCK_COLS % ACC_LANES == 0, "blocks must be whole accumulator vectors wide");
+    const size_t block_size = BSR_BLOCK_ROWS * BSR_BLOCK_COLS;
+    for (size_t r = 0; r < block_rows; ++r) {
+        acc_vec acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {};
+        acc_vec vx, v0, v1, v2, v3;
+        for (uint32_t b = row_offsets[r]; b < row_offsets[r + 1]; ++b) {
+            const real_t *block = blocks + b * block_size;
+            const real_t *xb = x + block_cols[b];
+            // Accumulator lanes are summed at the end, so the column slices of a block can share them
+            for (size_t c = 0; c < BSR_BLOCK_COLS; c += ACC_LANES) {
+                LOAD_ACC(vx, xb + c);
+                LOAD_ACC(v0, block + c);
+                LOAD_ACC(v1, block + BSR_BLOCK_COLS + c);
+                LOAD_ACC(v2, block + 2 * BSR_BLOCK_COLS + c);
+                LOAD_ACC(v3, block + 3 * BSR_BLOCK_COLS + c);
+                acc0 += v0 * vx;
+                acc1 += v1 * vx;
+                acc2 += v2 * vx;
+                acc3 += v3 * vx;
+            }
+        }
+        accum_t s0, s1, s2, s3;
+        HSUM_ACC(s0, acc0);
+        HSUM_ACC(s1, acc1);
+        HSUM_ACC(s2, acc2);
+        HSUM_ACC(s3, acc3);
+        real_t *yr = y + r * BSR_BLOCK_ROWS;
+        yr[0] = static_cast<real_t>(s0);
+        yr[1] = static_cast<real_t>(s1);
+        yr[2] = static_cast<real_t>(s2);
+        yr[3] = static_cast<real_t>(s3);
+    }
+}
+
+/**
+ * Full register tile of 2 A rows x 4 B rows over one k block: each loaded vector is reused
+ * across the tile, so the tile needs 6 loads per 8 multiply-adds and all 8 accumulators
+ * stay in registers.
+ */
+static void gemm_nt_tile_2x4(size_t k,
+                             const real_t *a, size_t lda,
+                             const real_t *b, size_t ldb,
+                             real_t *c, size_t ldc) {
+    acc_vec c00 = {}, c01 = {}, c02 = {}, c03 = {};
+    acc_vec c10 = {}, c11 = {}, c12 = {}, c13 = {};
+    acc_vec x0, x1, y0, y1, y2, y3;
+    const real_t *a0 = a, *a1 = a + lda;
+    const real_t *b0 = b, *b1 = b + ldb, *b2 = b + 2 * ldb, *b3 = b + 3 * ldb;
+
+    size_t p = 0;
+    for (; p + ACC_LANES <= k; p += ACC_LANES) {
+        LOAD_ACC(x0, a0 + p);
+        LOAD_ACC(x1, a1 + p);
+        LOAD_ACC(y0, b0 + p);
+        LOAD_ACC(y1, b1 + p);
+        LOAD_ACC(y2, b2 + p);
+        LOAD_ACC(y3, b3 + p);
+        c00 += x0 * y0; c01 += x0 * y1; c02 += x0 * y2; c03 += x0 * y3;
+        c10 += x1 * y0; c11 += x1 * y1; c12 += x1 * y2; c13 += x1 * y3;
+    }
+
+    accum_t sums[2][4];
+    HSUM_ACC(sums[0][0], c00); HSUM_ACC(sums[0][1], c01); HSUM_ACC(sums[0][2], c02); HSUM_ACC(sums[0][3], c03);
+    HSUM_ACC(sums[1][0], c10); HSUM_ACC(sums[1][1], c11); HSUM_ACC(sums[1][2], c12); HSUM_ACC(sums[1][3], c13);
+    for (size_t r = 0; r < 2; ++r) {
+        for (size_t q = 0; q < 4; ++q) {
+            for (size_t t = p; t < k; ++t) {
+                sums[r][q] += static_cast<accum_t>(a[r * lda + t]) * b[q * ldb + t];
+            }
+            c[r * ldc + q] += static_cast<real_t>(sums[r][q]);
+        }
+    }
+}
+
+/**
+ * Partial tile at the matrix edges: one SIMD dot product per entry.
+ */
+static void gemm_nt_edge(size_t rows, size_t cols, size_t k,
+                         const real_t *a, size_t lda,
+                         const real_t *b, size_t ldb,
+                         real_t *c, size_t ldc) {
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t q = 0; q < cols; ++q) {
+            c[r * ldc + q] += static_cast<real_t>(dot(a + r * lda, b + q * ldb, k));
+        }
+    }
+}
+
+void gemm_nt(size_t m, size_t n, size_t k,
+             const real_t *a, size_t lda,
+             const real_t *b, size_t ldb,
+             real_t *c, size_t ldc) {
+    for (size_t i = 0; i < m; ++i) {
+        std::memset(c + i * ldc, 0, n * sizeof(real_t));
+    }
+
+    for (size_t jb = 0; jb < n; jb += GEMM_BLOCK_N) {
+        size_t jend = jb + GEMM_BLOCK_N < n ? jb + GEMM_BLOCK_N : n;
+        for (size_t pb = 0; pb < k; pb += GEMM_BLOCK_K) {
+            size_t depth = pb + GEMM_BLOCK_K < k ? GEMM_BLOCK_K : k - pb;
+            for (size_t i = 0; i < m; i += 2) {
+                size_t rows = i + 2 <= m ? 2 : m - i;
+                for (size_t j = jb; j < jend; j += 4) {
+                    size_t cols = j + 4 <= jend ? 4 : jend - j;
+                    const real_t *a_tile = a + i * lda + pb;
+                    const real_t *b_tile = b + j * ldb + pb;
+                    if (rows == 2 && cols == 4) {
+                        gemm_nt_tile_2x4(depth, a_tile, lda, b_tile, ldb, c + i * ldc + j, ldc);
+                    } else {
+                        gemm_nt_edge(rows, cols, depth, a_tile, lda, b_tile, ldb, c + i * ldc + j, ldc);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Pack an mc x kc block of op(A) into MR-row panels, column by column, zero-padding the last
+ * panel so the micro-kernel never needs a row bound.
+ */
+static void pack_a(Transpose trans, size_t mc, size_t kc, const real_t *a, size_t lda, real_t *packed) {
+    for (size_t i = 0; i < mc; i += GEMM_MR) {
+        size_t rows = i + GEMM_MR <= mc ? GEMM_MR : mc - i;
+        for (size_t p = 0; p < kc; ++p) {
+            for (size_t r = 0; r < GEMM_MR; ++r) {
+                real_t value = 0;
+                if (r < rows) {
+                    value = trans == Transpose::NO ? a[(i + r) * lda + p] : a[p * lda + i + r];
+                }
+                *packed++ = value;
+            }
+        }
+    }
+}
+
+/**
+ * Pack a kc x nc block of op(B) into NR-column panels, row by row, zero-padding the last panel.
+ */
+static void pack_b(Transpose trans, size_t kc, size_t nc, const real_t *b, size_t ldb, real_t *packed) {
+    for (size_t j = 0; j < nc; j += GEMM_NR) {
+        size_t cols = j + GEMM_NR <= nc ? GEMM_NR : nc - j;
+        for (size_t p = 0; p < kc; ++p) {
+            if (trans == Transpose::NO && cols == GEMM_NR) {
+                std::memcpy(packed, b + p * ldb + j, GEMM_NR * sizeof(real_t));
+                packed += GEMM_NR;
+                continue;
+            }
+            for (size_t q = 0; q < GEMM_NR; ++q) {
+                real_t value = 0;
+                if (q < cols) {
+                    value = trans == Transpose::NO ? b[p * ldb + j + q] : b[(j + q) * ldb + p];
+                }
+                *packed++ = value;
+            }
+        }
+    }
+}
+
+/**
+ * Add alpha times one accumulator row (two vectors) to C, clipped to cols at the matrix edge.
+ */
+#define STORE_GEMM_ROW(c_row, low, high, alpha, cols)                       \
+    do {                                                                   \
+        real_t row_values[GEMM_NR];                                        \
+        vreg scaled_low = (alpha) * (low);                                 \
+        vreg scaled_high = (alpha) * (high);                               \
+        std::memcpy(row_values, &scaled_low, sizeof(vreg));                \
+        std::memcpy(row_values + VREG_LANES, &scaled_high, sizeof(vreg));  \
+        for (size_t q = 0; q < (cols); ++q) {                              \
+            (c_row)[q] += row_values[q];                                   \
+        }                                                                  \
+    } while (0)
+
+/**
+ * 4 x NR micro-kernel over packed panels: per step, two op(B) vectors are loaded and each of
+ * the four op(A) values is broadcast against them, so 8 vector multiply-adds cost 2 loads.
+ * Adds alpha times the tile to C, clipped to rows x cols at the matrix edges. Accumulates in
+ * real_t: a partial sum never spans more than GEMM_KC products.
+ */
+static void gemm_micro(size_t kc, const real_t *pa, const real_t *pb, real_t alpha,
+                       real_t *c, size_t ldc, size_t rows, size_t cols) {
+    vreg c00 = {}, c01 = {}, c10 = {}, c11 = {};
+    vreg c20 = {}, c21 = {}, c30 = {}, c31 = {};
+    vreg b0, b1;
+
+    for (size_t p = 0; p < kc; ++p, pa += GEMM_MR, pb += GEMM_NR) {
+        std::memcpy(&b0, pb, sizeof(vreg));
+        std::memcpy(&b1, pb + VREG_LANES, sizeof(vreg));
+        c00 += pa[0] * b0; c01 += pa[0] * b1;
+        c10 += pa[1] * b0; c11 += pa[1] * b1;
+        c20 += pa[2] * b0; c21 += pa[2] * b1;
+        c30 += pa[3] * b0; c31 += pa[3] * b1;
+    }
+
+    STORE_GEMM_ROW(c, c00, c01, alpha, cols);
+    if (rows > 1) {
+        STORE_GEMM_ROW(c + ldc, c10, c11, alpha, cols);
+    }
+    if (rows > 2) {
+        STORE_GEMM_ROW(c + 2 * ldc, c20, c21, alpha, cols);
+    }
+    if (rows > 3) {
+        STORE_GEMM_ROW(c + 3 * ldc, c30, c31, alpha, cols);
+    }
+}
+
+void gemm(Transpose trans_a, Transpose trans_b,
+          size_t m, size_t n, size_t k,
+          real_t alpha, const real_t *a, size_t lda,
+          const real_t *b, size_t ldb,
+          real_t beta, real_t *c, size_t ldc) {
+    for (size_t i = 0; i < m; ++i) {
+        scale_output(n, beta, c + i * ldc);
+    }
+    if (k == 0 || alpha == 0) {
+        return;
+    }
+
+    // Packing buffers are reused across calls on the same thread
+    thread_local AlignedVector<real_t> packed_a;
+    thread_local AlignedVector<real_t> packed_b;
+    packed_a.resize(GEMM_MC * GEMM_KC);
+    packed_b.resize(GEMM_KC * (GEMM_NC + GEMM_NR));
+
+    for (size_t jc = 0; jc < n; jc += GEMM_NC) {
+        size_t nc = jc + GEMM_NC <= n ? GEMM_NC : n - jc;
+        for (size_t pc = 0; pc < k; pc += GEMM_KC) {
+            size_t kc = pc + GEMM_KC <= k ? GEMM_KC : k - pc;
+            const real_t *b_block = trans_b == Transpose::NO ? b + pc * ldb + jc : b + jc * ldb + pc;
+            pack_b(trans_b, kc, nc, b_block, ldb, packed_b.data());
+
+            for (size_t ic = 0; ic < m; ic += GEMM_MC) {
+                size_t mc = ic + GEMM_MC <= m ? GEMM_MC : m - ic;
+                const real_t *a_block = trans_a == Transpose::NO ? a + ic * lda + pc : a + pc * lda + ic;
+                pack_a(trans_a, mc, kc, a_block, lda, packed_a.data());
+
+                for (size_t j = 0; j < nc; j += GEMM_NR) {
+                    size_t cols = j + GEMM_NR <= nc ? GEMM_NR : nc - j;
+                    const real_t *pb = packed_b.data() + j * kc;
+                    for (size_t i = 0; i < mc; i += GEMM_MR) {
+                        size_t rows = i + GEMM_MR <= mc ? GEMM_MR : mc - i;
+                        gemm_micro(kc, packed_a.data() + i * kc, pb, alpha,
+                                       c + (ic + i) * ldc + jc + j, ldc, rows, cols);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void gemv_u8s8_scalar(size_t m, size_t n, const int8_t *w, size_t ldw, const uint8_t *x, int32_t *y) {
+    for (size_t i = 0; i < m; ++i) {
+        const int8_t *row = w + i * ldw;
+        int32_t sum = 0;
+        for (size_t p = 0; p < n; ++p) {
+            sum += static_cast<int32_t>(x[p]) * static_cast<int32_t>(row[p]);
+        }
+        y[i] = sum;
+    }
+}
+
+#if defined(LINALG_X86)
+
+/**
+ * Sum of the eight 32-bit lanes.
+ */
+#define HSUM_EPI32(result, acc)                                                             \
+    do {                                                                                    \
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)); \
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4e));                          \
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xb1));                          \
+        (result) = _mm_cvtsi128_si32(half);                                                 \
+    } while (0)
+
+/**
+ * vpmaddubsw multiplies 32 u8 x s8 pairs and adds neighbours into 16-bit lanes; vpmaddwd
+ * with ones widens those to 32-bit before accumulating.
+ */
+__attribute__((target("avx2")))
+static void gemv_u8s8_avx2(size_t m, size_t n, const int8_t *w, size_t ldw, const uint8_t *x, int32_t *y) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (size_t i = 0; i < m; ++i) {
+        const int8_t *row = w + i * ldw;
+        __m256i acc = _mm256_setzero_si256();
+        size_t p = 0;
+        for (; p + 32 <= n; p += 32) {
+            __m256i vx = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x + p));
+            __m256i vw = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + p));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(vx, vw), ones));
+        }
+        int32_t sum;
+        HSUM_EPI32(sum, acc);
+        for (; p < n; ++p) {
+            sum += static_cast<int32_t>(x[p]) * static_cast<int32_t>(row[p]);
+        }
+        y[i] = sum;
+    }
+}
+
+/**
+ * vpdpbusd does the u8 x s8 multiply, the 4-way add and the 32-bit accumulate in one step.
+ */
+__attribute__((target("avx2,avxvnni")))
+static void gemv_u8s8_avxvnni(size_t m, size_t n, const int8_t *w, size_t ldw, const uint8_t *x, int32_t *y) {
+    for (size_t i = 0; i < m; ++i) {
+        const int8_t *row = w + i * ldw;
+        __m256i acc = _mm256_setzero_si256();
+        size_t p = 0;
+        for (; p + 32 <= n; p += 32) {
+            __m256i vx = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x + p));
+            __m256i vw = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + p));
+            acc = _mm256_dpbusd_avx_epi32(acc, vx, vw);
+        }
+        int32_t sum;
+        HSUM_EPI32(sum, acc);
+        for (; p < n; ++p) {
+            sum += static_cast<int32_t>(x[p]) * static_cast<int32_t>(row[p]);
+        }
+        y[i] = sum;
+    }
+}
+
+#endif
+
+namespace {
+
+typedef void (*GemvU8S8)(size_t, size_t, const int8_t *, size_t, const uint8_t *, int32_t *);
+
+/**
+ * The int8 kernel picked for this CPU.
+ */
+struct Int8Kernel {
+    const char *name;
+    GemvU8S8 gemv;
+};
+
+const Int8Kernel &int8_kernel() {
+    static const Int8Kernel kernel = []() -> Int8Kernel {
+#if defined(LINALG_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avxvnni")) {
+            return {"avx-vnni", gemv_u8s8_avxvnni};
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            return {"avx2", gemv_u8s8_avx2};
+        }
+#endif
+        return {"scalar", gemv_u8s8_scalar};
+    }();
+    return kernel;
+}
+
+} // namespace
+
+void gemv_u8s8(size_t m, size_t n, const int8_t *w, size_t ldw, const uint8_t *x, int32_t *y) {
+    int8_kernel().gemv(m, n, w, ldw, x, y);
+}
+
+const char *int8_kernel_name() {
+    return int8_kernel().name;
+}
+
+size_t argmin(const real_t *values, size_t n, real_t &min_value) {
+    size_t i = 0;
+    size_t best = 0;
+    min_value = values[0];
+
+    if (n >= VEC_LANES) {
+        // Per-lane running minimum and index; strict < keeps the lowest index in each lane
+        vec best_values, current;
+        LOAD_VEC(best_values, values);
+        vec_bits best_index;
+        for (size_t lane = 0; lane < VEC_LANES; ++lane) {
+            best_index[lane] = static_cast<real_bits>(lane);
+        }
+        vec_bits index = best_index;
+        for (i = VEC_LANES; i + VEC_LANES <= n; i += VEC_LANES) {
+            index += static_cast<real_bits>(VEC_LANES);
+            LOAD_VEC(current, values + i);
+            vec_bits mask = (vec_bits)(current < best_values);
+            best_values = (vec)(((vec_bits)best_values & ~mask) | ((vec_bits)current & mask));
+            best_index = (best_index & ~mask) | (index & mask);
+        }
+
+        min_value = best_values[0];
+        best = static_cast<size_t>(best_index[0]);
+        for (size_t lane = 1; lane < VEC_LANES; ++lane) {
+            size_t lane_index = static_cast<size_t>(best_index[lane]);
+            if (best_values[lane] < min_value || (best_values[lane] == min_value && lane_index < best)) {
+                min_value = best_values[lane];
+                best = lane_index;
+            }
+        }
+    }
+
+    for (; i < n; ++i) {
+        if (values[i] < min_value) {
+            min_value = values[i];
+            best = i;
+        }
+    }
+    return best;
+}
+
+} // namespace linalg
@@ -0,0 +1,236 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "model_file.hpp"
+#include "precision.hpp"
+
+namespace {
+
+const char MAGIC[8] = {'R', 'T', 'M', 'L', 'M', 'O', 'D', 'L'};
+
+// Written in native order; a reader on a machine with the other byte order sees 0x04030201
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+/**
+ * On-disk header, exactly one cache line.
+ */
+struct FileHeader {
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t model_type;
+    uint32_t real_size;     // sizeof(real_t) of the writer
+    uint32_t num_sections;
+    uint32_t checksum;      // CRC-32 of every byte after the header
+    uint64_t file_size;
+    uint8_t reserved[24];
+};
+static_assert(sizeof(FileHeader) == MODEL_SECTION_ALIGNMENT, "header must fill one cache line");
+
+/**
+ * On-disk section table entry.
+ */
+struct SectionEntry {
+    uint32_t tag;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+size_t align_up(size_t offset) {
+    return (offset + MODEL_SECTION_ALIGNMENT - 1) / MODEL_SECTION_ALIGNMENT * MODEL_SECTION_ALIGNMENT;
+}
+
+/**
+ * Slicing-by-8 lookup tables for the reflected IEEE polynomial 0xEDB88320.
+ */
+struct Crc32Tables {
+    uint32_t table[8][256];
+
+    Crc32Tables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int slice = 1; slice < 8; ++slice) {
+                table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xff];
+            }
+        }
+    }
+};
+
+} // namespace
+
+/**
+ * @brief Eight bytes per step through eight tables, then bytewise for the tail.
+ */
+uint32_t crc32(const void *data, size_t size, uint32_t crc) {
+    static const Crc32Tables tables;
+    const uint32_t (*t)[256] = tables.table;
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+
+    for (; size >= 8; size -= 8, bytes += 8) {
+        uint32_t low, high;
+        std::memcpy(&low, bytes, 4);
+        std::memcpy(&high, bytes + 4, 4);
+        low ^= crc;
+        crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24]
+            ^ t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+    }
+    for (; size > 0; --size, ++bytes) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *bytes) & 0xff];
+    }
+    return ~crc;
+}
+
+ModelWriter::ModelWriter(ModelType type)
+    : type(type) {}
+
+void ModelWriter::add_section(uint32_t tag, const void *data, size_t size) {
+    sections.push_back({tag, data, size});
+}
+
+/**
+ * @brief The header goes in last: the body is streamed once, hashing as it is written, then
+ * the finished header overwrites the placeholder at offset 0.
+ */
+bool ModelWriter::save(const std::string &path) const {
+    FileHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.byte_order = BYTE_ORDER_MARK;
+    header.version = MODEL_FILE_VERSION;
+    header.model_type = static_cast<uint32_t>(type);
+    header.real_size = sizeof(real_t);
+    header.num_sections = static_cast<uint32_t>(sections.size());
+
+    std::vector<SectionEntry> table(sections.size());
+    size_t offset = align_up(sizeof(FileHeader) + table.size() * sizeof(SectionEntry));
+    for (size_t s = 0; s < sections.size(); ++s) {
+        table[s] = {sections[s].tag, 0, offset, sections[s].size};
+        offset = align_up(offset + sections[s].size);
+    }
+
+    std::string temp_path = path + ".tmp";
+    FILE *fp = fopen(temp_path.c_str(), "wb");
+    if (!fp) {
+        std::cerr << "Error opening model file '" << temp_path << "' for writing." << std::endl;
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    size_t position = sizeof(FileHeader);
+    uint32_t crc = 0;
+    auto emit = [&](const void *data, size_t size) {
+        if (size > 0) {
+            ok = ok && fwrite(data, 1, size, fp) == size;
+            crc = crc32(data, size, crc);
+            position += size;
+        }
+    };
+    auto pad_to = [&](size_t target) {
+        static const uint8_t zeros[MODEL_SECTION_ALIGNMENT] = {};
+        emit(zeros, target - position);
+    };
+
+    emit(table.data(), table.size() * sizeof(SectionEntry));
+    for (size_t s = 0; s < sections.size(); ++s) {
+        pad_to(table[s].offset);
+        emit(sections[s].data, sections[s].size);
+    }
+
+    header.checksum = crc;
+    header.file_size = position;
+    ok = ok && fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "Error writing model file '" << path << "'." << std::endl;
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+MappedModelFile::MappedModelFile(const uint8_t *base, size_t size)
+    : base(base), size(size) {}
+
+MappedModelFile::~MappedModelFile() {
+    munmap(const_cast<uint8_t *>(base), size);
+}
+
+std::shared_ptr<const MappedModelFile> MappedModelFile::open(const std::string &path, ModelType type) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Model file '" << path << "' not found." << std::endl;
+        return nullptr;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(FileHeader)) {
+        std::cerr << "Model file '" << path << "' is truncated." << std::endl;
+        close(fd);
+        return nullptr;
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Error mapping model file '" << path << "'." << std::endl;
+        return nullptr;
+    }
+    std::shared_ptr<const MappedModelFile> file(new MappedModelFile(static_cast<const uint8_t *>(mapping), size));
+
+    FileHeader header;
+    std::memcpy(&header, file->base, sizeof(header));
+    const char *problem = nullptr;
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        problem = "is not a model file";
+    } else if (header.byte_order != BYTE_ORDER_MARK) {
+        problem = "was written with the other byte order";
+    } else if (header.version != MODEL_FILE_VERSION) {
+        problem = "has an unsupported version";
+    } else if (header.model_type != static_cast<uint32_t>(type)) {
+        problem = "holds a different kind of model";
+    } else if (header.real_size != sizeof(real_t)) {
+        problem = "was written with a different PRECISION";
+    } else if (header.file_size != size
+               || header.num_sections > (size - sizeof(FileHeader)) / sizeof(SectionEntry)) {
+        problem = "is truncated";
+    } else if (crc32(file->base + sizeof(FileHeader), size - sizeof(FileHeader)) != header.checksum) {
+        problem = "failed its checksum";
+    } else {
+        const SectionEntry *table = reinterpret_cast<const SectionEntry *>(file->base + sizeof(FileHeader));
+        for (uint32_t s = 0; s < header.num_sections && !problem; ++s) {
+            if (table[s].offset % MODEL_SECTION_ALIGNMENT != 0 || table[s].offset > size
+                || table[s].size > size - table[s].offset) {
+                problem = "has a corrupt section table";
+            }
+        }
+    }
+    if (problem) {
+        std::cerr << "Model file '" << path << "' " << problem << "." << std::endl;
+        return nullptr;
+    }
+    return file;
+}
+
+const void *MappedModelFile::section(uint32_t tag, size_t &bytes) const {
+    FileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    const SectionEntry *table = reinterpret_cast<const SectionEntry *>(base + sizeof(FileHeader));
+    for (uint32_t s = 0; s < header.num_sections; ++s) {
+        if (table[s].tag == tag) {
+            bytes = table[s].size;
+            return base + table[s].offset;
+        }
+    }
+    bytes = 0;
+    return nullptr;
+}
@@ -0,0 +1,66 @@
+#include "sparse_matrix.hpp"
+
+SparseMatrix::SparseMatrix()
+    : num_cols(0), row_offsets(1, 0) {}
+
+/**
+ * @brief Two passes over the samples: count the non-zeros to size the arrays exactly, then fill them.
+ * @param samples Data points to convert.
+ */
+SparseMatrix::SparseMatrix(const std::vector<DataPoint *> &samples)
+    : num_cols(0), row_offsets(1, 0)
+{
+    size_t total = 0;
+    for (DataPoint *data_point : samples) {
+        const std::vector<real_t> *features = data_point->get_normalized_feature_vector();
+        num_cols = features->size();
+        for (real_t value : *features) {
+            total += value != 0 ? 1 : 0;
+        }
+    }
+
+    row_offsets.reserve(samples.size() + 1);
+    indices.reserve(total);
+    values.reserve(total);
+    for (DataPoint *data_point : samples) {
+        const std::vector<real_t> *features = data_point->get_normalized_feature_vector();
+        for (size_t i = 0; i < features->size(); ++i) {
+            if ((*features)[i] != 0) {
+                indices.push_back(static_cast<uint32_t>(i));
+                values.push_back((*features)[i]);
+            }
+        }
+        row_offsets.push_back(indices.size());
+    }
+}
+
+size_t SparseMatrix::rows() const {
+    return row_offsets.size() - 1;
+}
+
+size_t SparseMatrix::cols() const {
+    return num_cols;
+}
+
+size_t SparseMatrix::nonzeros() const {
+    return indices.size();
+}
+
+double SparseMatrix::density() const {
+    if (rows() == 0 || num_cols == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(nonzeros()) / (static_cast<double>(rows()) * static_cast<double>(num_cols));
+}
+
+size_t SparseMatrix::row_nonzeros(size_t row) const {
+    return row_offsets[row + 1] - row_offsets[row];
+}
+
+const uint32_t *SparseMatrix::row_indices(size_t row) const {
+    return indices.data() + row_offsets[row];
+}
+
+const real_t *SparseMatrix::row_values(size_t row) const {
+    return values.data() + row_offsets[row];
+}
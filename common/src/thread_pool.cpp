@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <cstdlib>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "thread_pool.hpp"
+
+namespace {
+
+/**
+ * Pool and slot of the calling thread, set once by every worker.
+ */
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local unsigned current_index = 0;
+
+/**
+ * Number of parallel_for() calls active on the calling thread (nested calls skip the external lock).
+ */
+thread_local unsigned active_loops = 0;
+
+/**
+ * Take attempts an idle worker makes before it goes to sleep.
+ */
+const int SPIN_ROUNDS = 32;
+
+/**
+ * The shared pool, owned by shared_pool and published through shared_instance, so lookups
+ * after the first one take no lock.
+ */
+std::mutex shared_mutex;
+std::unique_ptr<ThreadPool> shared_pool;
+std::atomic<ThreadPool *> shared_instance(nullptr);
+
+/**
+ * Thread count from the RTML_THREADS environment variable, or 0 if it is not set.
+ */
+unsigned environment_threads() {
+    const char *value = std::getenv("RTML_THREADS");
+    if (!value) {
+        return 0;
+    }
+    int threads = std::atoi(value);
+    return threads > 0 ? static_cast<unsigned>(threads) : 0;
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned num_threads, bool pin) : queued(0), idle(0), running(true) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned slot = 0; slot < num_threads; ++slot) {
+        queues.emplace_back(new TaskQueue());
+    }
+    for (unsigned slot = 1; slot < num_threads; ++slot) {
+        workers.emplace_back(&ThreadPool::work, this, slot, pin);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    running.store(false);
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        wake.notify_all();
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+/**
+ * queued is raised before idle is read, and a sleeper raises idle before it reads queued, so
+ * (both being sequentially consistent) at least one side sees the other and no wake-up is lost.
+ */
+void ThreadPool::push(unsigned slot, const Task &task) {
+    {
+        std::lock_guard<std::mutex> lock(queues[slot]->mutex);
+        queues[slot]->tasks.push_back(task);
+    }
+    queued.fetch_add(1);
+    if (idle.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        wake.notify_one();
+    }
+}
+
+bool ThreadPool::take(unsigned slot, Task &task) {
+    {
+        TaskQueue &own = *queues[slot];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); ++i) {
+        TaskQueue &victim = *queues[(slot + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * The job must not be touched after remaining is lowered: the last decrement lets its owner
+ * return and destroy it.
+ */
+void ThreadPool::execute(unsigned slot, Task task) {
+    Job *job = task.job;
+    while (task.end - task.begin > job->grain) {
+        size_t middle = task.begin + (task.end - task.begin) / 2;
+        push(slot, Task{job, middle, task.end});
+        task.end = middle;
+    }
+    (*job->body)(task.begin, task.end);
+    job->remaining.fetch_sub(task.end - task.begin, std::memory_order_acq_rel);
+}
+
+void ThreadPool::work(unsigned slot, bool pin) {
+    current_pool = this;
+    current_index = slot;
+#ifdef __linux__
+    if (pin) {
+        unsigned num_cpus = std::max(1u, std::thread::hardware_concurrency());
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(slot % num_cpus, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#else
+    (void)pin;
+#endif
+
+    Task task;
+    while (true) {
+        bool found = false;
+        for (int round = 0; round < SPIN_ROUNDS && !found; ++round) {
+            found = take(slot, task);
+            if (!found) {
+                std::this_thread::yield();
+            }
+        }
+        if (found) {
+            execute(slot, task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        idle.fetch_add(1);
+        wake.wait(lock, [&]() { return queued.load() > 0 || !running.load(); });
+        idle.fetch_sub(1);
+        if (!running.load() && queued.load() == 0) {
+            return;
+        }
+    }
+}
+
+/**
+ * The caller helps with any queued task while it waits, its own job's or another's. An outside
+ * thread that finds slot 0 taken runs its range itself, in grain-sized pieces.
+ */
+void ThreadPool::run(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> &body) {
+    unsigned slot = current_slot();
+    std::unique_lock<std::mutex> lock(external, std::defer_lock);
+    if (current_pool != this && active_loops == 0 && !lock.try_lock()) {
+        for (size_t first = begin; first < end;) {
+            size_t last = end - first > grain ? first + grain : end;
+            body(first, last);
+            first = last;
+        }
+        return;
+    }
+    ++active_loops;
+
+    Job job;
+    job.body = &body;
+    job.grain = grain;
+    job.remaining.store(end - begin);
+    push(slot, Task{&job, begin, end});
+
+    Task task;
+    while (job.remaining.load(std::memory_order_acquire) > 0) {
+        if (take(slot, task)) {
+            execute(slot, task);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    --active_loops;
+}
+
+unsigned ThreadPool::size() const {
+    return static_cast<unsigned>(queues.size());
+}
+
+unsigned ThreadPool::current_slot() const {
+    return current_pool == this ? current_index : 0;
+}
+
+ThreadPool &ThreadPool::shared() {
+    ThreadPool *pool = shared_instance.load(std::memory_order_acquire);
+    if (pool) {
+        return *pool;
+    }
+    std::lock_guard<std::mutex> lock(shared_mutex);
+    if (!shared_pool) {
+        shared_pool.reset(new ThreadPool(environment_threads()));
+        shared_instance.store(shared_pool.get(), std::memory_order_release);
+    }
+    return *shared_pool;
+}
+
+void ThreadPool::set_shared_threads(unsigned num_threads, bool pin) {
+    std::lock_guard<std::mutex> lock(shared_mutex);
+    if (environment_threads() > 0 && shared_pool) {
+        return;
+    }
+    shared_instance.store(nullptr, std::memory_order_release);
+    shared_pool.reset(new ThreadPool(environment_threads() > 0 ? environment_threads() : num_threads, pin));
+    shared_instance.store(shared_pool.get(), std::memory_order_release);
+}
@@ -1,5 +1,6 @@
 #include <iostream>
 #include "data_handler.hpp"
+#include "instrumentation.hpp"
 
 void assert_equal(int a, int b, const std::string &msg) {
     if (a != b) {
@@ -27,5 +28,10 @@ int main() {
     assert_equal(dh->get_test_set()->size(), expected_test_size, "Test data size mismatch");
     std::cout << "All tests passed successfully!" << std::endl;
 
+    // Per-phase timings and counters of an instrumented build (make INSTRUMENT=1)
+    if (instrumentation::enabled) {
+        instrumentation::save("bin/instrumentation.json");
+    }
+
     return 0;
 }
\ No newline at end of file
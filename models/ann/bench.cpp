@@ -0,0 +1,87 @@
+#include <cstdlib>
+#include <iostream>
+#include "benchmark.hpp"
+#include "compiled_model.hpp"
+#include "data_handler.hpp"
+#include "neural_network.hpp"
+
+// Benchmarks of the training steps, whole epochs and inference, on generated MNIST-sized data
+int main(int argc, char **argv) {
+    const std::string output = argc > 1 ? argv[1] : "bin/bench.json";
+    const std::string images = "bin/bench-images.idx", labels = "bin/bench-labels.idx";
+    if (!synthetic::write_idx(images, labels, 6000, 28, 28, 10)) {
+        return 1;
+    }
+    srand(1);
+    DataHandler *dh = new DataHandler();
+    dh->read_input_data(images);
+    dh->read_label_data(labels);
+    dh->count_classes();
+    dh->normalize();
+    dh->split_data();
+    std::vector<DataPoint *> &training_set = *dh->get_training_set();
+    std::vector<DataPoint *> &test_set = *dh->get_test_set();
+    int input_size = static_cast<int>(training_set[0]->get_normalized_feature_vector()->size());
+    Benchmark bench("ann");
+
+    // Single-sample steps of a 784-64-32-10 network
+    NeuralNetwork *nn = new NeuralNetwork({64, 32}, input_size, 10, 0.01);
+    nn->set_training_data(&training_set);
+    nn->set_validation_data(dh->get_validation_set());
+    nn->set_test_data(&test_set);
+    size_t sample = 0;
+    DataPoint *point = training_set[0];
+    bench.run("fprop", [&]() { do_not_optimize(nn->fprop(training_set[sample++ % training_set.size()])); });
+    nn->fprop(point);
+    bench.run("bprop", [&]() { do_not_optimize(nn->bprop(point)); });
+    bench.run("update_weights", [&]() { nn->update_weights(point); });
+    bench.run("sgd_step", [&]() {
+        DataPoint *next = training_set[sample++ % training_set.size()];
+        nn->fprop(next);
+        nn->bprop(next);
+        nn->update_weights(next);
+    });
+
+    // Whole epochs (including the validation pass), per sample and in mini-batches, without the
+    // per-epoch progress line
+    nn->set_verbose(false);
+    bench.run("epoch_sgd", [&]() { nn->train(1); }, training_set.size());
+    NeuralNetwork *batched = new NeuralNetwork({64, 32}, input_size, 10, 0.1);
+    batched->set_training_data(&training_set);
+    batched->set_validation_data(dh->get_validation_set());
+    batched->set_batch_size(32);
+    batched->set_verbose(false);
+    bench.run("epoch_batch32", [&]() { batched->train(1); }, training_set.size());
+
+    // Serving from a compiled snapshot
+    InferenceContext context(nn->compile());
+    std::vector<real_t> queries;
+    for (DataPoint *query : test_set) {
+        queries.insert(queries.end(), query->get_normalized_feature_vector()->begin(),
+                       query->get_normalized_feature_vector()->end());
+    }
+    std::vector<int> predictions(test_set.size());
+    bench.run("inference_predict", [&]() {
+        do_not_optimize(context.predict(test_set[sample++ % test_set.size()]));
+    });
+    bench.run("inference_predict_batch", [&]() {
+        context.predict_batch(queries.data(), test_set.size(), static_cast<size_t>(input_size), predictions.data());
+    }, test_set.size());
+
+    // Convolutional network: 8 5x5 filters and 2x2 max pooling in front of the output layer
+    NeuralNetwork *cnn = new NeuralNetwork({1, 28, 28}, {FeatureLayerSpec::convolution(8, 5), FeatureLayerSpec::max_pool(2)},
+                                           {}, 10, 0.01);
+    bench.run("cnn_fprop", [&]() { do_not_optimize(cnn->fprop(training_set[sample++ % training_set.size()])); });
+    bench.run("cnn_sgd_step", [&]() {
+        DataPoint *next = training_set[sample++ % training_set.size()];
+        cnn->fprop(next);
+        cnn->bprop(next);
+        cnn->update_weights(next);
+    });
+
+    delete cnn;
+    delete batched;
+    delete nn;
+    delete dh;
+    return bench.save(output) ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "precision.hpp"
+
+/**
+ * @brief Activation function of a layer.
+ *
+ * The values are stored in model files, so existing entries must keep their numbers.
+ */
+enum class Activation : int32_t {
+    SIGMOID = 0,     ///< 1 / (1 + e^-x); paired with squared error on the output layer.
+    TANH = 1,        ///< Hyperbolic tangent.
+    RELU = 2,        ///< max(x, 0).
+    LEAKY_RELU = 3,  ///< x for x > 0, LEAKY_RELU_SLOPE * x otherwise.
+    SOFTMAX = 4      ///< Row-wise softmax; output layer only, trained with cross-entropy.
+};
+
+/**
+ * @brief Vectorized activation functions, their derivatives and the output-layer loss.
+ *
+ * Each function switches on the activation once and then runs a loop specialized for it at
+ * compile time, so there is no per-element branch or indirect call. Sigmoid, tanh and
+ * softmax share one polynomial exp (range reduction to 2^n * e^r), evaluated SIMD-wide
+ * instead of calling std::exp per neuron. Derivatives are computed from the activation
+ * outputs, which is all the backward pass keeps.
+ */
+namespace activation {
+
+/**
+ * @brief Slope of LEAKY_RELU for negative inputs.
+ */
+const real_t LEAKY_RELU_SLOPE = real_t(0.01);
+
+/**
+ * @brief Checks whether an activation can be used for a given layer.
+ * @param activation Activation function.
+ * @param is_output True for the last layer of the network.
+ * @return False for SOFTMAX on a hidden layer or an unknown value.
+ */
+bool is_valid(Activation activation, bool is_output);
+
+/**
+ * @brief Returns the name of an activation.
+ * @param activation Activation function.
+ * @return Upper-case name, e.g. "RELU".
+ */
+const char *name(Activation activation);
+
+/**
+ * @brief Adds the biases to every row and applies the activation in place.
+ * @param activation Activation function (SOFTMAX normalizes each row).
+ * @param values Row-major count x width pre-activations; receives the outputs.
+ * @param count Number of rows.
+ * @param width Number of neurons per row.
+ * @param biases Width biases added to every row, or nullptr if already included.
+ */
+void forward(Activation activation, real_t *values, size_t count, size_t width, const real_t *biases);
+
+/**
+ * @brief Multiplies back-propagated errors by the activation derivative: deltas *= f'(outputs).
+ * @param activation Elementwise activation function (not SOFTMAX).
+ * @param outputs Outputs of forward().
+ * @param deltas Errors with respect to the outputs; receives errors with respect to the inputs.
+ * @param n Number of values.
+ */
+void backward(Activation activation, const real_t *outputs, real_t *deltas, size_t n);
+
+/**
+ * @brief Computes the output-layer deltas (negative loss gradient) and the loss of one sample.
+ *
+ * SOFTMAX uses cross-entropy, fused into a single pass: delta = target - output and
+ * loss = -log(output[label]). Every other activation uses squared error:
+ * delta = (target - output) * f'(output) and loss = sum (target - output)^2.
+ *
+ * @param activation Activation of the output layer.
+ * @param outputs Width outputs of forward().
+ * @param label Index of the one-hot target.
+ * @param deltas Receives width deltas.
+ * @param width Number of outputs.
+ * @return Loss of the sample.
+ */
+double output_deltas(Activation activation, const real_t *outputs, size_t label, real_t *deltas, size_t width);
+
+} // namespace activation
@@ -0,0 +1,390 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "aligned_allocator.hpp"
+#include "convolution.hpp"
+#include "data_point.hpp"
+#include "feature_extractor.hpp"
+#include "layer.hpp"
+#include "model_file.hpp"
+
+/**
+ * @brief Read-only snapshot of a trained network's parameters.
+ *
+ * All weights and biases are copied once into a single aligned block. After construction
+ * nothing in the model changes, so any number of threads can share one instance (through a
+ * std::shared_ptr<const CompiledModel>) without locking. A model loaded from a file uses the
+ * block in place in the memory-mapped file instead of copying it.
+ *
+ * A network with feature layers also carries its convolution and pooling stages; their
+ * filters follow the fully connected layers in the block, and inference runs them first.
+ */
+class CompiledModel {
+public:
+    /**
+     * @brief Shape of one layer and where its parameters live in the block.
+     */
+    struct LayerView {
+        int input_size;        ///< Number of inputs.
+        int layer_size;        ///< Number of neurons.
+        int stride;            ///< Distance in elements between weight rows.
+        size_t weight_offset;  ///< Offset of the layer_size x stride weight matrix.
+        size_t bias_offset;    ///< Offset of the layer_size biases.
+        Activation activation; ///< Activation function of the layer.
+    };
+
+    /**
+     * @brief Geometry of one feature stage and where its filters live in the block.
+     */
+    struct StageView {
+        FeatureStage stage;    ///< Stage geometry.
+        int stride;            ///< Distance in elements between filter rows (convolutions only).
+        size_t weight_offset;  ///< Offset of the output channels x stride filters.
+        size_t bias_offset;    ///< Offset of the output channel biases.
+        Activation activation; ///< Activation function of a convolution.
+    };
+
+private:
+    /**
+     * @brief Shape and offsets of every layer.
+     */
+    std::vector<LayerView> views;
+
+    /**
+     * @brief Feature stages in front of the layers (empty for a fully connected network).
+     */
+    std::vector<StageView> stage_views;
+
+    /**
+     * @brief Storage of the parameter block when it was copied from layers.
+     */
+    AlignedVector<real_t> owned_parameters;
+
+    /**
+     * @brief Mapping that holds the parameter block when the model was loaded from a file.
+     */
+    std::shared_ptr<const MappedModelFile> file;
+
+    /**
+     * @brief Every layer's weights and biases, back to back (in owned_parameters or file).
+     */
+    const real_t *parameters;
+
+    /**
+     * @brief Number of elements in the parameter block.
+     */
+    size_t num_parameters;
+
+    /**
+     * @brief Width of the widest layer.
+     */
+    int max_width;
+
+public:
+    /**
+     * @brief Copies the parameters of the given layers.
+     * @param layers Layers of a trained network.
+     * @param features Feature stages in front of the layers, or nullptr.
+     */
+    explicit CompiledModel(const std::vector<Layer *> &layers, const FeatureExtractor *features = nullptr);
+
+    CompiledModel(const CompiledModel &) = delete;
+    CompiledModel &operator=(const CompiledModel &) = delete;
+
+    /**
+     * @brief Writes the layer shapes and the parameter block to a model file.
+     * @param path Destination file.
+     * @return True on success.
+     */
+    bool save(const std::string &path) const;
+
+    /**
+     * @brief Maps a model file written by save() and serves its parameters in place.
+     * @param path Model file.
+     * @return Shared model, or nullptr if the file is missing or invalid.
+     */
+    static std::shared_ptr<const CompiledModel> load(const std::string &path);
+
+    /**
+     * @brief Returns the number of layers.
+     * @return Layer count.
+     */
+    size_t num_layers() const;
+
+    /**
+     * @brief Returns the shape and offsets of a layer.
+     * @param layer Layer index.
+     * @return Layer view.
+     */
+    const LayerView &layer(size_t layer) const;
+
+    /**
+     * @brief Returns the weight matrix of a layer.
+     * @param layer Layer index.
+     * @return Pointer to layer_size x stride weights.
+     */
+    const real_t *weights(size_t layer) const;
+
+    /**
+     * @brief Returns the biases of a layer.
+     * @param layer Layer index.
+     * @return Pointer to layer_size biases.
+     */
+    const real_t *biases(size_t layer) const;
+
+    /**
+     * @brief Returns the number of feature stages.
+     * @return Stage count (0 for a fully connected network).
+     */
+    size_t num_stages() const;
+
+    /**
+     * @brief Returns the geometry and offsets of a feature stage.
+     * @param stage Stage index.
+     * @return Stage view.
+     */
+    const StageView &stage(size_t stage) const;
+
+    /**
+     * @brief Returns the filters of a convolution stage.
+     * @param stage Stage index.
+     * @return Pointer to output channels x stride weights.
+     */
+    const real_t *stage_weights(size_t stage) const;
+
+    /**
+     * @brief Returns the biases of a convolution stage.
+     * @param stage Stage index.
+     * @return Pointer to one bias per output channel.
+     */
+    const real_t *stage_biases(size_t stage) const;
+
+    /**
+     * @brief Returns the number of input features.
+     * @return Size of the input image with feature stages, else the first layer's input size.
+     */
+    int input_size() const;
+
+    /**
+     * @brief Returns the number of outputs (classes).
+     * @return Size of the last layer.
+     */
+    int output_size() const;
+
+    /**
+     * @brief Returns the width of the widest layer.
+     * @return Largest layer size.
+     */
+    int get_max_width() const;
+
+private:
+    friend class ModelPublisher;
+
+    /**
+     * @brief Copies new parameters of the same network into owned_parameters.
+     *
+     * Only for a model nobody else references (see ModelPublisher::publish).
+     *
+     * @param layers Layers the model was compiled from.
+     * @param features Feature stages the model was compiled from, or nullptr.
+     * @return False if the model is mapped from a file or the shapes differ.
+     */
+    bool refill(const std::vector<Layer *> &layers, const FeatureExtractor *features);
+
+    /**
+     * @brief Wraps a validated parameter block that lives in a mapped file.
+     */
+    CompiledModel(std::vector<LayerView> views, std::vector<StageView> stage_views,
+                  std::shared_ptr<const MappedModelFile> file, const real_t *parameters, size_t num_parameters);
+};
+
+/**
+ * @brief Publishes successive CompiledModel snapshots of a network that keeps training, for
+ * readers on other threads (read-copy-update).
+ *
+ * Readers poll get_version(), a single atomic load, and take a new snapshot with acquire()
+ * only when it changed (a shared_ptr copy). A snapshot is immutable and stays alive while
+ * any reader holds it, so readers never wait for an update or a copy of the weights, and
+ * never see a half-written set of them.
+ *
+ * The writer double-buffers: publish() refills the snapshot retired by the previous publish
+ * in place once no reader holds it any more, and allocates a new one only while a reader is
+ * still using it. publish() must only be called from one thread at a time.
+ */
+class ModelPublisher {
+private:
+    /**
+     * @brief Snapshot handed out by acquire(); accessed with the std::atomic_* shared_ptr functions.
+     */
+    std::shared_ptr<const CompiledModel> published;
+
+    /**
+     * @brief Writer's handles on the published snapshot and on the one it replaced.
+     */
+    std::shared_ptr<CompiledModel> front, back;
+
+    /**
+     * @brief Number of publish() calls so far.
+     */
+    std::atomic<uint64_t> version;
+
+public:
+    /**
+     * @brief Creates a publisher with nothing published (version 0).
+     */
+    ModelPublisher();
+
+    ModelPublisher(const ModelPublisher &) = delete;
+    ModelPublisher &operator=(const ModelPublisher &) = delete;
+
+    /**
+     * @brief Snapshots the given parameters and makes them the current model.
+     * @param layers Layers of the network.
+     * @param features Feature stages of the network, or nullptr.
+     */
+    void publish(const std::vector<Layer *> &layers, const FeatureExtractor *features);
+
+    /**
+     * @brief Returns the current model; safe to call from any thread.
+     * @return Shared read-only model (nullptr before the first publish()).
+     */
+    std::shared_ptr<const CompiledModel> acquire() const;
+
+    /**
+     * @brief Returns the number of models published so far; safe to call from any thread.
+     * @return Version of the current model.
+     */
+    uint64_t get_version() const;
+};
+
+/**
+ * @brief Per-thread inference session over a shared CompiledModel.
+ *
+ * Holds only activation scratch (two ping-pong buffers for up to `capacity` samples, plus
+ * per-sample stage buffers for a model with feature stages) and a reference to the model, so
+ * contexts are cheap to create and never copy weights. A context must not be used by two
+ * threads at once; give every thread its own.
+ *
+ * A context created from a ModelPublisher switches to the latest published model at the
+ * start of every forward pass.
+ */
+class InferenceContext {
+private:
+    /**
+     * @brief Shared read-only model.
+     */
+    std::shared_ptr<const CompiledModel> model;
+
+    /**
+     * @brief Source of new models, or nullptr for a fixed model.
+     */
+    const ModelPublisher *publisher;
+
+    /**
+     * @brief Publisher version of model.
+     */
+    uint64_t version;
+
+    /**
+     * @brief Number of samples the scratch can hold per pass.
+     */
+    size_t capacity;
+
+    /**
+     * @brief Ping-pong activation buffers, capacity x max_width each.
+     */
+    AlignedVector<real_t> buffers[2];
+
+    /**
+     * @brief Ping-pong stage outputs of one sample and the convolution scratch.
+     */
+    AlignedVector<real_t> stage_buffers[2], columns;
+
+    /**
+     * @brief Row-major capacity x feature size outputs of the last stage (the first layer's inputs).
+     */
+    AlignedVector<real_t> extracted;
+
+    /**
+     * @brief Runs the feature stages on up to capacity samples, one at a time.
+     * @param features Row-major count x input_size images.
+     * @param count Number of samples (at most capacity).
+     * @param stride Distance in elements between consecutive samples.
+     * @return Row-major count x first-layer input values in the scratch.
+     */
+    const real_t *extract(const real_t *features, size_t count, size_t stride);
+
+    /**
+     * @brief Grows the scratch to fit the current model (no allocation if it already fits).
+     */
+    void allocate();
+
+    /**
+     * @brief Switches to the publisher's latest model if it changed.
+     */
+    void refresh();
+
+    /**
+     * @brief Forward pass for up to capacity samples.
+     * @param features Row-major count x input_size features.
+     * @param count Number of samples (at most capacity).
+     * @param stride Distance in elements between consecutive samples.
+     * @return Row-major count x output_size outputs in the scratch.
+     */
+    const real_t *forward_rows(const real_t *features, size_t count, size_t stride);
+
+public:
+    /**
+     * @brief Creates a context over a compiled model.
+     * @param model Shared compiled model.
+     * @param capacity Samples per batched pass (predict_batch processes larger inputs in chunks).
+     */
+    explicit InferenceContext(std::shared_ptr<const CompiledModel> model, size_t capacity = 64);
+
+    /**
+     * @brief Creates a context that follows the models of a publisher.
+     * @param publisher Publisher with at least one published model; must outlive the context.
+     * @param capacity Samples per batched pass (predict_batch processes larger inputs in chunks).
+     */
+    explicit InferenceContext(const ModelPublisher &publisher, size_t capacity = 64);
+
+    /**
+     * @brief Forward pass for one sample.
+     * @param features Pointer to input_size features.
+     * @return Pointer to output_size outputs, valid until the next call on this context.
+     */
+    const real_t *forward(const real_t *features);
+
+    /**
+     * @brief Predicts the class of one sample.
+     * @param features Pointer to input_size features.
+     * @return Index of the largest output.
+     */
+    int predict(const real_t *features);
+
+    /**
+     * @brief Predicts the class of a data point from its normalized features.
+     * @param data_point Data point to classify.
+     * @return Index of the largest output.
+     */
+    int predict(DataPoint *data_point);
+
+    /**
+     * @brief Predicts many samples with one GEMM per layer per chunk.
+     * @param features Row-major count x input_size features.
+     * @param count Number of samples.
+     * @param stride Distance in elements between consecutive samples.
+     * @param labels Receives count predicted classes.
+     */
+    void predict_batch(const real_t *features, size_t count, size_t stride, int *labels);
+
+    /**
+     * @brief Returns the model this context runs (the one used by the last forward pass).
+     * @return Compiled model.
+     */
+    const CompiledModel &get_model() const;
+};
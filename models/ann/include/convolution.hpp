@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "activation.hpp"
+#include "precision.hpp"
+
+/**
+ * @brief Shape of an image tensor. Values are stored channel-major (CHW): channel c, row y,
+ * column x lives at (c * height + y) * width + x.
+ */
+struct ImageShape {
+    int channels;  ///< Number of channels (1 for grayscale input).
+    int height;    ///< Rows per channel.
+    int width;     ///< Columns per row.
+
+    /**
+     * @brief Returns the number of values.
+     * @return channels * height * width.
+     */
+    size_t size() const;
+};
+
+/**
+ * @brief Kind of a feature layer. The values are stored in model files.
+ */
+enum class FeatureLayerType : int32_t {
+    CONVOLUTION = 0,  ///< 2D convolution, stride 1, zero padding, with bias and activation.
+    MAX_POOL = 1      ///< Non-overlapping max pooling.
+};
+
+/**
+ * @brief User description of one feature layer (see NeuralNetwork's image constructor).
+ */
+struct FeatureLayerSpec {
+    FeatureLayerType type;  ///< Convolution or pooling.
+    int channels;           ///< Output channels (CONVOLUTION only).
+    int kernel_size;        ///< Side of the square kernel or pooling window.
+    int padding;            ///< Zeros added on each side of the input (CONVOLUTION only).
+
+    /**
+     * @brief A convolution with "same" padding (kernel_size / 2), which keeps the image size for odd kernels.
+     * @param channels Number of filters.
+     * @param kernel_size Side of each filter.
+     * @return Layer spec.
+     */
+    static FeatureLayerSpec convolution(int channels, int kernel_size);
+
+    /**
+     * @brief A max pooling layer over size x size windows with stride size.
+     * @param size Window side.
+     * @return Layer spec.
+     */
+    static FeatureLayerSpec max_pool(int size);
+};
+
+/**
+ * @brief Geometry of one feature layer, resolved against its input shape.
+ */
+struct FeatureStage {
+    FeatureLayerType type;  ///< Convolution or pooling.
+    ImageShape input;       ///< Input tensor shape.
+    ImageShape output;      ///< Output tensor shape.
+    int kernel_size;        ///< Side of the kernel or pooling window.
+    int padding;            ///< Zero padding on each side (0 for pooling).
+
+    /**
+     * @brief Returns the weights per filter: input channels * kernel_size^2 (convolutions only).
+     * @return Length of one filter row.
+     */
+    size_t taps() const;
+};
+
+/**
+ * @brief Convolution and pooling kernels on CHW tensors, shared by training (FeatureExtractor)
+ * and inference (InferenceContext).
+ *
+ * A convolution with F filters computes the F x pixels output matrix W * columns, where W holds
+ * one flattened filter per row (input channel, kernel row, kernel column) and row t of columns
+ * is the input shifted by tap t (im2col). That product runs on the blocked linalg::gemm, and the
+ * backward pass is two more GEMMs plus col2im. Filters with only a few taps (a grayscale input
+ * layer) would make a thin GEMM dominated by packing and the unfolding itself, so their forward
+ * pass uses a direct kernel instead that sums all taps into register-resident output vectors
+ * from a zero-padded copy of the input.
+ */
+namespace convolution {
+
+/**
+ * @brief Filters with at most this many taps use the direct kernel.
+ */
+const size_t DIRECT_MAX_TAPS = 32;
+
+/**
+ * @brief Resolves a layer spec against its input shape.
+ * @param input Input tensor shape.
+ * @param spec Layer description.
+ * @param stage Receives the geometry.
+ * @return False if the kernel or window does not fit the input.
+ */
+bool make_stage(const ImageShape &input, const FeatureLayerSpec &spec, FeatureStage &stage);
+
+/**
+ * @brief Returns the scratch size of a convolution: its column matrix or the direct kernel's
+ * padded input, whichever is larger.
+ * @param stage Convolution geometry.
+ * @return Number of values.
+ */
+size_t column_size(const FeatureStage &stage);
+
+/**
+ * @brief Whether forward() uses the direct kernel for a convolution.
+ * @param stage Convolution geometry.
+ * @return True if the filters have at most DIRECT_MAX_TAPS taps.
+ */
+bool is_direct(const FeatureStage &stage);
+
+/**
+ * @brief Unfolds the input into the taps x pixels column matrix (zeros where a tap falls in the padding).
+ * @param stage Convolution geometry.
+ * @param input Input tensor.
+ * @param columns Receives column_size() values.
+ */
+void im2col(const FeatureStage &stage, const real_t *input, real_t *columns);
+
+/**
+ * @brief Folds a column matrix back onto the input, summing overlapping taps (the adjoint of im2col).
+ * @param stage Convolution geometry.
+ * @param columns taps x pixels values.
+ * @param input Receives the input-shaped sums (overwritten).
+ */
+void col2im(const FeatureStage &stage, const real_t *columns, real_t *input);
+
+/**
+ * @brief Computes output = f(W * im2col(input) + b) for one sample.
+ * @param stage Convolution geometry.
+ * @param filters Row-major filters x filter_stride weights.
+ * @param filter_stride Distance in elements between filter rows.
+ * @param biases One bias per output channel.
+ * @param activation Elementwise activation.
+ * @param input Input tensor.
+ * @param output Receives the output tensor.
+ * @param columns Scratch of column_size() values (the direct kernel stages the padded input in it).
+ */
+void forward(const FeatureStage &stage, const real_t *filters, size_t filter_stride, const real_t *biases,
+             Activation activation, const real_t *input, real_t *output, real_t *columns);
+
+/**
+ * @brief Back-propagates the output deltas of one sample (already multiplied by f').
+ * @param stage Convolution geometry.
+ * @param filters Row-major filters x filter_stride weights.
+ * @param filter_stride Distance in elements between filter rows.
+ * @param input Input tensor of the forward pass.
+ * @param deltas Output-shaped deltas.
+ * @param columns Scratch of column_size() values.
+ * @param weight_direction Receives deltas * columns^T (filters x filter_stride; padding untouched).
+ * @param bias_direction Receives the per-channel sums of deltas.
+ * @param input_deltas Receives the input-shaped deltas, or nullptr to skip them (first layer).
+ */
+void backward(const FeatureStage &stage, const real_t *filters, size_t filter_stride, const real_t *input,
+              const real_t *deltas, real_t *columns, real_t *weight_direction, real_t *bias_direction,
+              real_t *input_deltas);
+
+/**
+ * @brief Max pooling of one sample.
+ * @param stage Pooling geometry.
+ * @param input Input tensor.
+ * @param output Receives the output tensor.
+ * @param argmax Receives the input index of every output maximum, or nullptr (inference).
+ */
+void max_pool(const FeatureStage &stage, const real_t *input, real_t *output, uint32_t *argmax);
+
+/**
+ * @brief Routes every output delta to the input position that won the max.
+ * @param stage Pooling geometry.
+ * @param deltas Output-shaped deltas.
+ * @param argmax Indices recorded by max_pool().
+ * @param input_deltas Receives the input-shaped deltas (overwritten).
+ */
+void max_pool_backward(const FeatureStage &stage, const real_t *deltas, const uint32_t *argmax, real_t *input_deltas);
+
+} // namespace convolution
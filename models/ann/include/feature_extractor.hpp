@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "aligned_allocator.hpp"
+#include "convolution.hpp"
+#include "layer.hpp"
+#include "optimizer.hpp"
+
+/**
+ * @brief Convolution and pooling stages in front of a network's fully connected layers.
+ *
+ * Every convolution keeps its filters in a Layer (one row of input channels x kernel_size^2
+ * weights per output channel), so initialization, the Optimizer and model snapshots treat
+ * them like any other weight matrix. The extractor owns the per-stage outputs, deltas and
+ * pooling indices of one sample plus a single im2col scratch sized for the largest stage,
+ * all allocated once by the constructor.
+ */
+class FeatureExtractor {
+private:
+    /**
+     * @brief Geometry of every stage, input to output.
+     */
+    std::vector<FeatureStage> stages;
+
+    /**
+     * @brief Filters of each stage (nullptr for pooling stages).
+     */
+    std::vector<Layer *> filters;
+
+    /**
+     * @brief Per stage: output tensor of the current sample.
+     */
+    std::vector<AlignedVector<real_t>> outputs;
+
+    /**
+     * @brief Per stage: deltas of the output tensor.
+     */
+    std::vector<AlignedVector<real_t>> deltas;
+
+    /**
+     * @brief Per pooling stage: input index of every output maximum.
+     */
+    std::vector<std::vector<uint32_t>> argmax;
+
+    /**
+     * @brief Per convolution: descent directions of the filters and biases.
+     */
+    std::vector<AlignedVector<real_t>> weight_directions, bias_directions;
+
+    /**
+     * @brief im2col scratch shared by all stages.
+     */
+    AlignedVector<real_t> columns;
+
+    /**
+     * @brief Input of the last forward() call.
+     */
+    const real_t *input;
+
+    /**
+     * @brief Index of the first convolution (stages before it need no deltas).
+     */
+    size_t first_convolution;
+
+    /**
+     * @brief Returns the input tensor of a stage for the current sample.
+     */
+    const real_t *stage_input(size_t stage) const;
+
+public:
+    /**
+     * @brief Resolves layer specs into chained stages, exiting with an error if one does not fit.
+     * @param input Shape of the network's input image.
+     * @param specs Feature layers, input to output.
+     * @return Stage geometry.
+     */
+    static std::vector<FeatureStage> plan(const ImageShape &input, const std::vector<FeatureLayerSpec> &specs);
+
+    /**
+     * @brief Allocates filters and buffers for the given stages.
+     * @param stages Stage geometry from plan().
+     * @param activation Activation function of every convolution.
+     */
+    FeatureExtractor(const std::vector<FeatureStage> &stages, Activation activation);
+
+    /**
+     * @brief Releases the filter layers.
+     */
+    ~FeatureExtractor();
+
+    FeatureExtractor(const FeatureExtractor &) = delete;
+    FeatureExtractor &operator=(const FeatureExtractor &) = delete;
+
+    /**
+     * @brief Runs every stage on one image (no heap allocation).
+     * @param input CHW input tensor; must stay valid until backward() and update() are done.
+     * @return The last stage's output, valid until the next forward().
+     */
+    const real_t *forward(const real_t *input);
+
+    /**
+     * @brief Returns the last stage's output of the last forward().
+     * @return output_size() values.
+     */
+    const real_t *output() const;
+
+    /**
+     * @brief Returns the buffer that receives the deltas of the last stage's output.
+     * @return output_size() values, filled by the caller before backward().
+     */
+    real_t *output_deltas();
+
+    /**
+     * @brief Back-propagates output_deltas() through the stages of the last forward() and
+     * computes the filter descent directions (no heap allocation).
+     */
+    void backward();
+
+    /**
+     * @brief Applies one optimizer step to the filters and biases.
+     * @param optimizer Optimizer configured with the network's layers followed by get_layers().
+     * @param first_layer Optimizer layer index of the first convolution.
+     * @param step Step returned by Optimizer::begin_step().
+     */
+    void update(Optimizer &optimizer, size_t first_layer, const Optimizer::Step &step);
+
+    /**
+     * @brief Returns the geometry of every stage.
+     * @return Stages, input to output.
+     */
+    const std::vector<FeatureStage> &get_stages() const;
+
+    /**
+     * @brief Returns the filters of a stage.
+     * @param stage Stage index.
+     * @return Filter layer, or nullptr for a pooling stage.
+     */
+    Layer *get_filters(size_t stage) const;
+
+    /**
+     * @brief Returns the filter layers of all convolutions, input to output.
+     * @return Filter layers.
+     */
+    std::vector<Layer *> get_layers() const;
+
+    /**
+     * @brief Returns the number of input values.
+     * @return Size of the input image.
+     */
+    size_t input_size() const;
+
+    /**
+     * @brief Returns the number of output values.
+     * @return Size of the last stage's output tensor.
+     */
+    size_t output_size() const;
+};
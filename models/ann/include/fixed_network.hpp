@@ -0,0 +1,265 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include "activation.hpp"
+#include "compiled_model.hpp"
+#include "data_point.hpp"
+#include "simd.hpp"
+
+namespace fixed_network {
+
+using simd::acc_src;
+using simd::acc_vec;
+using simd::ACC_LANES;
+
+/**
+ * @brief sum += x * src[0, ACC_LANES), widened to accum_t.
+ */
+inline void multiply_add(acc_vec &sum, const real_t *src, accum_t x) {
+    acc_src raw;
+    std::memcpy(&raw, src, sizeof(raw));
+    sum += __builtin_convertvector(raw, acc_vec) * x;
+}
+
+/**
+ * @brief Adds x times one weight column to every accumulator. The fold expands to straight-line
+ * code with constant indices, so the accumulators stay in registers across the input loop.
+ */
+template <size_t... K>
+inline void multiply_add_column(acc_vec *sums, const real_t *column, accum_t x, std::index_sequence<K...>) {
+    (multiply_add(sums[K], column + K * ACC_LANES, x), ...);
+}
+
+/**
+ * @brief Dense layer whose shape is part of its type.
+ *
+ * Weights are stored transposed (input-major), so the forward pass walks them once and adds
+ * each input times its weight column to one accumulator vector per group of neurons; no
+ * dot-product reduction is needed. Columns are padded with zeros to whole cache lines, so
+ * the accumulators are a constant, small number of vectors the compiler keeps in registers.
+ */
+template <size_t In, size_t Out>
+struct FixedLayer {
+    static constexpr size_t LINE = 64 / sizeof(real_t);
+    static constexpr size_t PADDED = (Out + LINE - 1) / LINE * LINE;  ///< Out rounded up to a cache line.
+    static constexpr size_t BLOCKS = PADDED / ACC_LANES;             ///< Accumulator vectors per row.
+
+    alignas(64) std::array<real_t, In * PADDED> weights{};  ///< weights[i * PADDED + j]: input i to neuron j.
+    alignas(64) std::array<real_t, PADDED> biases{};        ///< One bias per neuron, then zeros.
+    Activation activation = Activation::SIGMOID;           ///< Activation function.
+
+    /**
+     * @brief outputs = f(W * inputs + b) over the padded row.
+     *
+     * RELU and LEAKY_RELU are applied inline; SIGMOID and TANH run the shared vectorized
+     * kernels over the whole padded row, which has no remainder. Padding lanes hold
+     * f(0) and are never read by the next layer.
+     *
+     * @param inputs In input values.
+     * @param outputs Receives PADDED values, the first Out of them activations.
+     * @param argmax_only Skip a strictly increasing activation (all but RELU), which cannot
+     * change which output is largest.
+     */
+    void forward(const real_t *inputs, real_t *outputs, bool argmax_only) const {
+        // Even and odd inputs go to separate accumulators to halve the dependency chain
+        acc_vec sums[BLOCKS], odd_sums[BLOCKS];
+        acc_src raw;
+        for (size_t k = 0; k < BLOCKS; ++k) {
+            std::memcpy(&raw, &biases[k * ACC_LANES], sizeof(raw));
+            sums[k] = __builtin_convertvector(raw, acc_vec);
+            odd_sums[k] = acc_vec{};
+        }
+        for (size_t i = 0; i + 1 < In; i += 2) {
+            multiply_add_column(sums, &weights[i * PADDED], inputs[i], std::make_index_sequence<BLOCKS>());
+            multiply_add_column(odd_sums, &weights[(i + 1) * PADDED], inputs[i + 1], std::make_index_sequence<BLOCKS>());
+        }
+        if (In % 2 == 1) {
+            multiply_add_column(sums, &weights[(In - 1) * PADDED], inputs[In - 1], std::make_index_sequence<BLOCKS>());
+        }
+        for (size_t k = 0; k < BLOCKS; ++k) {
+            raw = __builtin_convertvector(sums[k] + odd_sums[k], acc_src);
+            std::memcpy(outputs + k * ACC_LANES, &raw, sizeof(raw));
+        }
+
+        if (argmax_only && activation != Activation::RELU) {
+            return;
+        }
+        switch (activation) {
+        case Activation::RELU:
+            for (size_t j = 0; j < PADDED; ++j) {
+                outputs[j] = std::max(outputs[j], real_t(0));
+            }
+            break;
+        case Activation::LEAKY_RELU:
+            for (size_t j = 0; j < PADDED; ++j) {
+                outputs[j] = std::max(outputs[j], activation::LEAKY_RELU_SLOPE * outputs[j]);
+            }
+            break;
+        case Activation::SOFTMAX:
+            activation::forward(activation, outputs, 1, Out, nullptr);
+            break;
+        default:
+            activation::forward(activation, outputs, 1, PADDED, nullptr);
+            break;
+        }
+    }
+
+    /**
+     * @brief Copies (and transposes) layer l of a compiled model.
+     * @param model Source model.
+     * @param l Layer index.
+     * @return False if the layer's shape differs from In x Out.
+     */
+    bool load(const CompiledModel &model, size_t l) {
+        const CompiledModel::LayerView &view = model.layer(l);
+        if (static_cast<size_t>(view.input_size) != In || static_cast<size_t>(view.layer_size) != Out) {
+            return false;
+        }
+        const real_t *rows = model.weights(l);
+        for (size_t j = 0; j < Out; ++j) {
+            for (size_t i = 0; i < In; ++i) {
+                weights[i * PADDED + j] = rows[j * view.stride + i];
+            }
+        }
+        std::copy(model.biases(l), model.biases(l) + Out, biases.begin());
+        activation = view.activation;
+        return true;
+    }
+};
+
+/**
+ * @brief The layers In -> Out -> Rest..., the hidden activations kept on the stack.
+ * forward() writes padded_outputs values of the last layer; argmax_only applies to it alone.
+ */
+template <size_t In, size_t... Sizes>
+struct LayerChain;
+
+template <size_t In, size_t Out>
+struct LayerChain<In, Out> {
+    static constexpr size_t outputs = Out;
+    static constexpr size_t padded_outputs = FixedLayer<In, Out>::PADDED;
+
+    FixedLayer<In, Out> head;
+
+    void forward(const real_t *inputs, real_t *outputs, bool argmax_only) const {
+        head.forward(inputs, outputs, argmax_only);
+    }
+
+    bool load(const CompiledModel &model, size_t l) {
+        return head.load(model, l);
+    }
+};
+
+template <size_t In, size_t Out, size_t Next, size_t... Rest>
+struct LayerChain<In, Out, Next, Rest...> {
+    static constexpr size_t outputs = LayerChain<Out, Next, Rest...>::outputs;
+    static constexpr size_t padded_outputs = LayerChain<Out, Next, Rest...>::padded_outputs;
+
+    FixedLayer<In, Out> head;
+    LayerChain<Out, Next, Rest...> tail;
+
+    void forward(const real_t *inputs, real_t *outputs, bool argmax_only) const {
+        alignas(64) std::array<real_t, FixedLayer<In, Out>::PADDED> hidden;
+        head.forward(inputs, hidden.data(), false);
+        tail.forward(hidden.data(), outputs, argmax_only);
+    }
+
+    bool load(const CompiledModel &model, size_t l) {
+        return head.load(model, l) && tail.load(model, l + 1);
+    }
+};
+
+} // namespace fixed_network
+
+/**
+ * @brief Inference-only network whose topology is fixed at compile time, e.g.
+ * FixedNetwork<4, 10, 10, 3> for iris (4 inputs, two hidden layers of 10, 3 classes).
+ *
+ * Weights live in std::array members, and every loop has a constant trip count, so the
+ * compiler unrolls and vectorizes the whole forward pass. predict() keeps the intermediate
+ * activations on the stack and never allocates, which makes it suited to tiny edge models.
+ * Train with NeuralNetwork and load the weights through a CompiledModel or a model file.
+ *
+ * All parameters are stored inline, so large instances (MNIST-sized inputs) belong on the
+ * heap or in static storage rather than on the stack. A loaded instance is immutable and
+ * may be shared by any number of threads.
+ */
+template <size_t Inputs, size_t... Sizes>
+class FixedNetwork {
+    static_assert(sizeof...(Sizes) > 0, "FixedNetwork needs at least an output layer");
+
+private:
+    typedef fixed_network::LayerChain<Inputs, Sizes...> Chain;
+
+    /**
+     * @brief Weights, biases and activation of every layer.
+     */
+    Chain layers;
+
+public:
+    static constexpr size_t num_inputs = Inputs;
+    static constexpr size_t num_outputs = Chain::outputs;
+    static constexpr size_t num_layers = sizeof...(Sizes);
+
+    /**
+     * @brief Copies the weights of a compiled model with exactly this topology.
+     * @param model Source model (e.g. NeuralNetwork::compile()).
+     * @return False if the model has feature stages or the layer count or any layer size differs.
+     */
+    bool load(const CompiledModel &model) {
+        if (model.num_stages() > 0 || model.num_layers() != num_layers || !layers.load(model, 0)) {
+            std::cerr << "Model does not match the FixedNetwork topology." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Copies the weights of a model file written by NeuralNetwork::save().
+     * @param path Model file.
+     * @return False if the file is invalid or has a different topology.
+     */
+    bool load(const std::string &path) {
+        std::shared_ptr<const CompiledModel> model = CompiledModel::load(path);
+        return model && load(*model);
+    }
+
+    /**
+     * @brief Computes the output activations of one sample.
+     * @param features num_inputs normalized features.
+     * @param outputs Receives num_outputs activations.
+     */
+    void forward(const real_t *features, real_t *outputs) const {
+        alignas(64) std::array<real_t, Chain::padded_outputs> padded;
+        layers.forward(features, padded.data(), false);
+        std::copy(padded.begin(), padded.begin() + num_outputs, outputs);
+    }
+
+    /**
+     * @brief Predicts the class of one sample. The output activation is skipped unless it
+     * is RELU, since the others preserve the order of the outputs.
+     * @param features num_inputs normalized features.
+     * @return Index of the largest output.
+     */
+    int predict(const real_t *features) const {
+        alignas(64) std::array<real_t, Chain::padded_outputs> outputs;
+        layers.forward(features, outputs.data(), true);
+        return static_cast<int>(std::max_element(outputs.begin(), outputs.begin() + num_outputs) - outputs.begin());
+    }
+
+    /**
+     * @brief Predicts the class of a data point from its normalized feature vector.
+     * @param data_point Sample with num_inputs normalized features.
+     * @return Predicted label.
+     */
+    int predict(DataPoint *data_point) const {
+        return predict(data_point->get_normalized_feature_vector()->data());
+    }
+};
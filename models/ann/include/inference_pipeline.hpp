@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "aligned_allocator.hpp"
+#include "compiled_model.hpp"
+#include "spsc_queue.hpp"
+
+/**
+ * @brief Streaming inference with the network split across threads, one segment of
+ * consecutive layers per thread.
+ *
+ * The feature stages and layers of a CompiledModel are cut into contiguous segments of about
+ * equal cost (multiply-adds), and every segment runs on its own worker thread, pinned to its
+ * own core where the platform allows it. Requests travel between the workers in fixed slots
+ * through lock-free single-producer/single-consumer queues, so while segment s works on
+ * request n, segment s - 1 already works on request n + 1: once the pipeline is full, one
+ * request completes per time of the slowest segment instead of per time of the whole network.
+ * Single-request latency does not improve; use InferenceContext for that.
+ *
+ * Slots are allocated once by the constructor and recycled; submit() and poll() never
+ * allocate or lock. submit() must only be called from one thread and poll() from one thread
+ * (the same one or another). Idle workers spin briefly, then yield, then sleep, so an empty
+ * pipeline costs little CPU but the first request after a pause pays a wake-up delay.
+ */
+class InferencePipeline {
+private:
+    /**
+     * @brief One in-flight request: its tag, its result and ping-pong activations.
+     */
+    struct Slot {
+        uint64_t tag;                         ///< Caller's request id.
+        int label;                            ///< Predicted class, set by the last segment.
+        AlignedVector<real_t> activations[2]; ///< Step s reads activations[s % 2], writes the other.
+    };
+
+    /**
+     * @brief Shared read-only model.
+     */
+    std::shared_ptr<const CompiledModel> model;
+
+    /**
+     * @brief Steps (feature stages, then layers) of each segment: segment s runs steps
+     * [boundaries[s], boundaries[s + 1]).
+     */
+    std::vector<size_t> boundaries;
+
+    /**
+     * @brief Every slot, owned here.
+     */
+    std::vector<Slot *> slots;
+
+    /**
+     * @brief Slots ready for submit() (filled by poll()).
+     */
+    SpscQueue<Slot *> free_slots;
+
+    /**
+     * @brief queues[s] feeds segment s; the last queue holds finished requests for poll().
+     */
+    std::vector<SpscQueue<Slot *> *> queues;
+
+    /**
+     * @brief One worker per segment.
+     */
+    std::vector<std::thread> workers;
+
+    /**
+     * @brief Cleared by the destructor to stop the workers.
+     */
+    std::atomic<bool> running;
+
+    /**
+     * @brief Runs one step of the network on a slot.
+     * @param step Step index (feature stages first, then layers).
+     * @param slot Request.
+     * @param columns Convolution scratch of the calling worker.
+     */
+    void run_step(size_t step, Slot *slot, real_t *columns) const;
+
+    /**
+     * @brief Body of the worker of a segment.
+     * @param segment Segment index.
+     */
+    void work(size_t segment);
+
+public:
+    /**
+     * @brief Splits a model into segments and starts one worker thread per segment.
+     * @param model Shared compiled model.
+     * @param num_segments Number of worker threads (at most one per feature stage and layer).
+     * @param depth Number of requests that can be in flight at once.
+     * @param pin Pin worker s to CPU s modulo the number of CPUs (Linux only).
+     */
+    InferencePipeline(std::shared_ptr<const CompiledModel> model, size_t num_segments, size_t depth = 64,
+                      bool pin = true);
+
+    /**
+     * @brief Stops the workers; requests still in flight are dropped.
+     */
+    ~InferencePipeline();
+
+    InferencePipeline(const InferencePipeline &) = delete;
+    InferencePipeline &operator=(const InferencePipeline &) = delete;
+
+    /**
+     * @brief Queues one request without blocking.
+     * @param features Pointer to input_size features, copied before the call returns.
+     * @param tag Id handed back by poll() with the result.
+     * @return False if `depth` requests are in flight; poll() results to make room.
+     */
+    bool submit(const real_t *features, uint64_t tag);
+
+    /**
+     * @brief Takes one finished request without blocking. Results arrive in submission order.
+     * @param tag Receives the id passed to submit().
+     * @param label Receives the predicted class.
+     * @return False if no request has finished yet.
+     */
+    bool poll(uint64_t &tag, int &label);
+
+    /**
+     * @brief Streams many samples through the pipeline from the calling thread, submitting and
+     * collecting as slots allow. The pipeline must hold no other requests.
+     * @param features Row-major count x input_size features.
+     * @param count Number of samples.
+     * @param stride Distance in elements between consecutive samples.
+     * @param labels Receives count predicted classes.
+     */
+    void predict_stream(const real_t *features, size_t count, size_t stride, int *labels);
+
+    /**
+     * @brief Returns the number of segments (worker threads).
+     * @return Segment count.
+     */
+    size_t num_segments() const;
+
+    /**
+     * @brief Returns the steps of a segment; steps count the feature stages first, then the layers.
+     * @param segment Segment index.
+     * @param first Receives the first step.
+     * @param last Receives one past the last step.
+     */
+    void get_segment(size_t segment, size_t &first, size_t &last) const;
+
+    /**
+     * @brief Returns the model the pipeline runs.
+     * @return Compiled model.
+     */
+    const CompiledModel &get_model() const;
+};
@@ -2,32 +2,105 @@
 
 #include <vector>
 #include <cstdint>
-#include "neuron.hpp"
+#include "activation.hpp"
+#include "aligned_allocator.hpp"
+#include "precision.hpp"
 
 /**
- * @brief Represents a single layer in a neural network.
+ * @brief Represents a single fully connected layer in a neural network.
+ *
+ * All weights live in one contiguous, cache-line-aligned row-major matrix (one row per
+ * neuron), so the forward and backward passes are single matrix-vector calls. A layer only
+ * holds parameters and its activation function; activations and deltas live in a Workspace.
+ *
+ * A pruned layer also keeps a mask of the weights it still uses; the Optimizer leaves the
+ * masked-out weights at zero.
  */
 class Layer {
 public:
+    /**
+     * @brief Number of inputs to this layer (previous layer size).
+     */
+    int input_size;
+
     /**
      * @brief Number of neurons in this layer.
      */
     int layer_size;
 
     /**
-     * @brief Collection of pointers to neurons in the layer.
+     * @brief Distance in elements between consecutive weight rows (input_size padded to a cache line).
+     */
+    int stride;
+
+    /**
+     * @brief Row-major layer_size x stride weight matrix; padding columns stay zero.
+     */
+    AlignedVector<real_t> weights;
+
+    /**
+     * @brief Bias of each neuron.
      */
-    std::vector<Neuron *> neurons;
+    AlignedVector<real_t> biases;
 
     /**
-     * @brief Output values of the layer after activation.
+     * @brief Activation function applied to this layer's outputs.
      */
-    std::vector<double> layer_outputs;
+    Activation activation;
 
     /**
-     * @brief Constructs a Layer with the given size.
+     * @brief 1 for every weight still in use and 0 for pruned ones, laid out like weights
+     * (empty until the layer is pruned).
+     */
+    AlignedVector<real_t> mask;
+
+    /**
+     * @brief Constructs a Layer with randomly initialized weights.
      * @param prev_layer_size Number of neurons in the previous layer.
      * @param current_layer_size Number of neurons in the current layer.
+     * @param activation Activation function of the layer.
+     */
+    Layer(int prev_layer_size, int current_layer_size, Activation activation = Activation::SIGMOID);
+
+    /**
+     * @brief Returns the weight row of a neuron.
+     * @param neuron Neuron index.
+     * @return Pointer to input_size weights.
+     */
+    real_t *row(int neuron);
+
+    /**
+     * @brief Returns the weight row of a neuron.
+     * @param neuron Neuron index.
+     * @return Pointer to input_size weights.
+     */
+    const real_t *row(int neuron) const;
+
+    /**
+     * @brief Initializes weights randomly, scaled for the layer's activation function.
+     *
+     * Sigmoid layers draw weights and biases from [-1.0, 1.0]. ReLU and leaky ReLU layers use
+     * He initialization (limit sqrt(6 / inputs)), tanh and softmax layers Glorot
+     * initialization (limit sqrt(6 / (inputs + neurons))); their biases start at zero.
+     */
+    void initialize_weights();
+
+    /**
+     * @brief Removes the smallest-magnitude weights until a fraction of them is zero.
+     *
+     * Weights are ranked in block_rows x block_cols tiles by their sum of squares, and whole
+     * tiles are pruned, so the mask keeps weights that are already pruned and only grows.
+     * 1 x 1 tiles prune individual weights.
+     *
+     * @param sparsity Fraction of the layer's weights to prune (the last tile may overshoot it).
+     * @param block_rows Tile height.
+     * @param block_cols Tile width.
+     */
+    void prune(double sparsity, size_t block_rows, size_t block_cols);
+
+    /**
+     * @brief Returns the fraction of weights removed by pruning.
+     * @return Pruned fraction (0 for an unpruned layer).
      */
-    Layer(int prev_layer_size, int current_layer_size);
-};
\ No newline at end of file
+    double sparsity() const;
+};
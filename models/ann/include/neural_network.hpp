@@ -1,15 +1,243 @@
 #pragma once
 
+#include <memory>
+#include <string>
 #include <vector>
+#include "compiled_model.hpp"
 #include "data_point.hpp"
 #include "data_set.hpp"
-#include "neuron.hpp"
+#include "feature_extractor.hpp"
 #include "layer.hpp"
+#include "optimizer.hpp"
+#include "parallel_trainer.hpp"
+#include "quantized_model.hpp"
+#include "sparse_matrix.hpp"
+#include "sparse_model.hpp"
+#include "workspace.hpp"
+
+/**
+ * @brief Iterative magnitude pruning schedule (see NeuralNetwork::prune).
+ */
+struct PruningConfig {
+    double target_sparsity = 0.9;    ///< Fraction of each pruned layer's weights to remove.
+    int rounds = 5;                  ///< Pruning rounds; sparsity ramps up cubically to the target.
+    int fine_tune_epochs = 2;        ///< Training epochs after every round.
+    double fine_tune_rate = 0.1;     ///< Fine-tuning learning rate as a fraction of the network's.
+    double max_accuracy_loss = 0.0;  ///< Stop at the last round within this validation accuracy loss (0 = no limit).
+    bool blocked = true;             ///< Prune whole BSR tiles (fast SparseModel) instead of single weights.
+    bool prune_output_layer = false; ///< Also prune the (small, sensitive) output layer.
+    int min_layer_weights = 1024;    ///< Smaller layers stay dense: they cost little and lose the most accuracy.
+};
+
+/**
+ * @brief Online learning settings (see NeuralNetwork::learn).
+ */
+struct OnlineConfig {
+    size_t max_batch = 32;     ///< Largest micro-batch applied as one step; larger batches take several steps.
+    int publish_interval = 1;  ///< learn() calls between two published snapshots.
+};
 
 /**
  * @brief Represents a feedforward neural network with backpropagation training.
+ *
+ * Each layer stores its weights as one contiguous matrix, so fprop is a chain of GEMV
+ * calls, bprop propagates errors with transposed GEMVs, and the weight update is a
+ * rank-one (GER) update per layer. With a batch size or thread count above one, training
+ * goes through ParallelTrainer: whole mini-batches, every pass a blocked GEMM, optionally
+ * spread over several threads.
+ *
+ * Every layer has its own activation function (see activation.hpp). A SOFTMAX output layer
+ * is trained with cross-entropy; any other output activation with squared error.
+ *
+ * Parameter updates go through an Optimizer (SGD by default; momentum, Nesterov or Adam,
+ * with an optional learning-rate schedule). train() can evaluate the validation set after
+ * every epoch, stop early once it stops improving or reaches a target accuracy, and keep
+ * (and checkpoint) the best weights seen.
+ *
+ * prune() removes the smallest weights in rounds with fine-tuning in between, and
+ * compile_sparse() exports the result in block-sparse form for inference.
+ *
+ * With sparse inputs enabled, per-sample SGD converts the training set to CSR once and the
+ * first layer's forward pass and weight update visit only the non-zero features, so its
+ * cost falls with the input density (about 15% of MNIST pixels are non-zero).
+ *
+ * The image constructor puts convolution and max pooling layers (a FeatureExtractor) in
+ * front of the fully connected layers. They train with per-sample SGD or any optimizer and
+ * are part of every CompiledModel snapshot and model file.
+ *
+ * learn() keeps training from labeled feedback one sample or micro-batch at a time while
+ * other threads serve predictions: every few updates the weights are published through a
+ * ModelPublisher, and InferenceContexts created from get_publisher() pick up each new
+ * snapshot without locking.
  */
 class NeuralNetwork : public DataSet {
+private:
+    /**
+     * @brief Number of samples per weight update (1 = per-sample SGD).
+     */
+    int batch_size;
+
+    /**
+     * @brief Number of training threads (0 = size of the shared ThreadPool).
+     */
+    unsigned num_threads;
+
+    /**
+     * @brief How training threads share the weights.
+     */
+    ParallelMode parallel_mode;
+
+    /**
+     * @brief Single-sample activations and deltas used by fprop, bprop and update_weights.
+     */
+    Workspace workspace;
+
+    /**
+     * @brief Update rule and its per-parameter state.
+     */
+    Optimizer optimizer;
+
+    /**
+     * @brief Epochs trained so far, across train() calls (drives the learning-rate schedule).
+     */
+    int epochs_trained;
+
+    /**
+     * @brief Epochs without validation improvement before train() stops (0 = never).
+     */
+    int patience;
+
+    /**
+     * @brief Smallest validation accuracy gain that counts as an improvement.
+     */
+    double min_delta;
+
+    /**
+     * @brief Validation accuracy at which train() stops (0 = none).
+     */
+    double target_accuracy;
+
+    /**
+     * @brief File that receives the best weights whenever validation improves (empty = none).
+     */
+    std::string checkpoint_path;
+
+    /**
+     * @brief Whether train() and prune() print their progress.
+     */
+    bool verbose;
+
+    /**
+     * @brief Whether per-sample SGD feeds the first layer from sparse_training_set.
+     */
+    bool sparse_inputs;
+
+    /**
+     * @brief CSR copy of the training set's features, built by train() when sparse inputs are used.
+     */
+    SparseMatrix sparse_training_set;
+
+    /**
+     * @brief Training set that sparse_training_set was built from.
+     */
+    const std::vector<DataPoint *> *sparse_source;
+
+    /**
+     * @brief First-layer weights transposed to input-major (input_size x layer_size) while
+     * training on sparse inputs, so each non-zero feature selects one contiguous row.
+     */
+    AlignedVector<real_t> input_weights;
+
+    /**
+     * @brief Convolution and pooling stages in front of layers (nullptr for a fully connected network).
+     */
+    FeatureExtractor *features;
+
+    /**
+     * @brief Online learning settings.
+     */
+    OnlineConfig online_config;
+
+    /**
+     * @brief Mini-batch trainer sized for online micro-batches (created by start_online()).
+     */
+    std::unique_ptr<ParallelTrainer> online_trainer;
+
+    /**
+     * @brief Whether start_online() has prepared the optimizer for learn().
+     */
+    bool online;
+
+    /**
+     * @brief learn() calls since the last publish.
+     */
+    int unpublished_updates;
+
+    /**
+     * @brief Snapshots of the weights for concurrent inference during online learning.
+     */
+    ModelPublisher publisher;
+
+    /**
+     * @brief Counts one learn() call and publishes the weights every publish_interval calls.
+     */
+    void finish_update();
+
+    /**
+     * @brief Returns every weight matrix the optimizer updates: layers, then the convolution filters.
+     * @return Layers in optimizer slot order.
+     */
+    std::vector<Layer *> parameter_layers() const;
+
+    /**
+     * @brief Copies the first layer's weights between its rows and input_weights.
+     * @param to_input_major True to fill input_weights, false to write them back to the layer.
+     */
+    void transpose_input_weights(bool to_input_major);
+
+    /**
+     * @brief Forward pass of one training sample from its CSR row (first layer sparse, rest dense).
+     * @param row Row of sparse_training_set.
+     */
+    void fprop_sparse(size_t row);
+
+    /**
+     * @brief SGD step of one training sample whose first-layer update touches only the
+     * input_weights rows of its non-zero features.
+     * @param row Row of sparse_training_set.
+     */
+    void update_weights_sparse(size_t row);
+
+    /**
+     * @brief Forward pass through layers [first, end) (no heap allocation).
+     * @param first Index of the first layer to run.
+     * @param inputs Inputs of that layer.
+     * @return Pointer to the output layer's activations.
+     */
+    const real_t *fprop_layers(size_t first, const real_t *inputs);
+
+    /**
+     * @brief Optimizer step for layers [first, end) (no heap allocation).
+     * @param first Index of the first layer to update.
+     * @param inputs Inputs of that layer.
+     * @param step Step returned by Optimizer::begin_step().
+     */
+    void update_layers(size_t first, const real_t *inputs, const Optimizer::Step &step);
+
+    /**
+     * @brief Computes the accuracy of the current weights on a set.
+     * @param samples Data points to classify.
+     * @param loss If not null, receives the mean loss over the samples.
+     * @return Fraction of correctly predicted samples.
+     */
+    double evaluate(const std::vector<DataPoint *> &samples, double *loss = nullptr);
+
+    /**
+     * @brief Copies the weights of a compiled model with the same layer sizes.
+     * @param model Source model.
+     */
+    void restore(const CompiledModel &model);
+
 public:
     /**
      * @brief Layers of the neural network.
@@ -32,8 +260,32 @@ public:
      * @param input_size Number of input features.
      * @param output_size Number of output classes.
      * @param learning_rate Learning rate for training.
+     * @param hidden_activation Activation function of every hidden layer.
+     * @param output_activation Activation function of the output layer.
+     */
+    NeuralNetwork(std::vector<int> spec, int input_size, int output_size, double learning_rate,
+                  Activation hidden_activation = Activation::SIGMOID,
+                  Activation output_activation = Activation::SIGMOID);
+
+    /**
+     * @brief Constructs a convolutional network for image inputs.
+     *
+     * The feature layers run first, each convolution followed by hidden_activation; the
+     * fully connected layers take the last feature layer's output, flattened. Exits with an
+     * error if a feature layer does not fit its input.
+     *
+     * @param input_shape Channels, height and width of the (CHW) input features.
+     * @param feature_layers Convolution and pooling layers, input to output.
+     * @param spec Vector specifying number of neurons per fully connected hidden layer.
+     * @param output_size Number of output classes.
+     * @param learning_rate Learning rate for training.
+     * @param hidden_activation Activation function of every convolution and hidden layer.
+     * @param output_activation Activation function of the output layer.
      */
-    NeuralNetwork(std::vector<int> spec, int input_size, int output_size, double learning_rate);
+    NeuralNetwork(const ImageShape &input_shape, const std::vector<FeatureLayerSpec> &feature_layers,
+                  std::vector<int> spec, int output_size, double learning_rate,
+                  Activation hidden_activation = Activation::RELU,
+                  Activation output_activation = Activation::SOFTMAX);
 
     /**
      * @brief Destructor that cleans up allocated memory.
@@ -41,58 +293,253 @@ public:
     ~NeuralNetwork();
 
     /**
-     * @brief Forward propagation through the network.
-     * @param data Pointer to input data.
-     * @return Output vector from the network.
+     * @brief Forward propagation through the network (no heap allocation).
+     * @param data_point Pointer to input data.
+     * @return Pointer to the output layer's activations, valid until the next fprop.
      */
-    std::vector<double> fprop(DataPoint *data_point);
+    const real_t *fprop(DataPoint *data_point);
 
     /**
-     * @brief Computes dot product between inputs and weights.
-     * @param inputs Input feature vector.
-     * @param weights Weight vector.
-     * @return Dot product result.
+     * @brief Backward propagation of errors through the network (no heap allocation).
+     *
+     * Uses the activations left in the workspace by the preceding fprop of the same point.
+     *
+     * @param data_point Pointer to the training data point.
+     * @return Loss of the point (cross-entropy for a SOFTMAX output, squared error otherwise).
      */
-    double activate(const std::vector<double> &inputs, const std::vector<double> &weights);
+    double bprop(DataPoint *data_point);
 
     /**
-     * @brief Activation function (e.g., sigmoid).
-     * @param x Input value.
-     * @return Activated output.
+     * @brief Updates weights based on the error terms (no heap allocation).
+     * @param data_point Pointer to the training data point.
      */
-    double transfer(double x);
+    void update_weights(DataPoint *data_point);
 
     /**
-     * @brief Derivative of the activation function.
-     * @param x Input value.
-     * @return Derivative result.
+     * @brief Predicts the label for a given input.
+     * @param data_point Pointer to the data point.
+     * @return Predicted label (index of max output).
      */
-    double transfer_derivative(double x);
+    int predict(DataPoint *data_point);
 
     /**
-     * @brief Backward propagation of errors through the network.
-     * @param data_point Pointer to the training data point.
+     * @brief Changes the activation function of one layer and re-initializes its weights
+     * for it, so call it before training.
+     * @param layer Layer index (the last layer is the output layer).
+     * @param activation Activation function; SOFTMAX is only allowed on the output layer.
      */
-    void bprop(DataPoint *data_point);
+    void set_activation(size_t layer, Activation activation);
 
     /**
-     * @brief Updates weights based on the error terms.
-     * @param data_point Pointer to the training data point.
+     * @brief Sets the mini-batch size used by train().
+     *
+     * Gradients are averaged over the batch, so larger batches usually want a larger
+     * learning rate.
+     *
+     * @param batch_size Samples per weight update (1 = per-sample SGD).
      */
-    void update_weights(DataPoint *data_point);
+    void set_batch_size(int batch_size);
 
     /**
-     * @brief Predicts the label for a given input.
-     * @param data_point Pointer to the data point.
-     * @return Predicted label (index of max output).
+     * @brief Returns the mini-batch size used by train().
+     * @return Samples per weight update.
      */
-    int predict(DataPoint *data_point);
+    int get_batch_size() const;
+
+    /**
+     * @brief Sets the number of threads used by train().
+     *
+     * In DATA_PARALLEL mode each mini-batch is split across the threads, so the batch size
+     * should be several times the thread count.
+     *
+     * @param num_threads Worker threads on the shared ThreadPool (0 = all of them, 1 = single-threaded).
+     */
+    void set_num_threads(unsigned num_threads);
+
+    /**
+     * @brief Selects how training threads share the weights.
+     * @param mode DATA_PARALLEL (deterministic) or HOGWILD (lock-free, asynchronous).
+     */
+    void set_parallel_mode(ParallelMode mode);
+
+    /**
+     * @brief Trains the first layer from a sparse (CSR) copy of the training set.
+     *
+     * Applies to per-sample SGD (batch size and thread count of one, SGD optimizer) of an
+     * unpruned network without feature layers; other configurations train densely. Worth enabling when most input features are zero.
+     *
+     * @param enabled True to skip zero features in the first layer.
+     */
+    void set_sparse_inputs(bool enabled);
+
+    /**
+     * @brief Selects the update rule and learning-rate schedule used by train().
+     *
+     * Clears any optimizer state. Adaptive rules usually want a smaller learning rate than
+     * SGD (around 0.001 for Adam).
+     *
+     * @param config Optimizer hyperparameters.
+     */
+    void set_optimizer(const OptimizerConfig &config);
+
+    /**
+     * @brief Stops train() once validation accuracy has not improved for a number of epochs.
+     *
+     * An epoch with the best accuracy so far and a lower validation loss also counts as an
+     * improvement, so a small validation set that scores perfectly early does not stop
+     * training. train() then restores the weights of the best epoch.
+     *
+     * @param patience Epochs without improvement (0 = disabled).
+     * @param min_delta Smallest accuracy gain (fraction) that counts as an improvement.
+     */
+    void set_early_stopping(int patience, double min_delta = 0.0);
+
+    /**
+     * @brief Stops train() as soon as validation accuracy reaches a target.
+     * @param accuracy Target accuracy as a fraction (0 = disabled).
+     */
+    void set_target_accuracy(double accuracy);
+
+    /**
+     * @brief Saves the weights to a model file every time validation accuracy improves.
+     * @param path Destination file (empty = disabled).
+     */
+    void set_checkpoint_path(const std::string &path);
+
+    /**
+     * @brief Turns the progress lines of train() and prune() (one per epoch, early stopping,
+     * pruning rounds) on or off; on by default. Warnings still go to std::cerr.
+     * @param verbose Whether to print progress.
+     */
+    void set_verbose(bool verbose);
+
+    /**
+     * @brief Snapshots the current weights into an immutable model for concurrent inference.
+     *
+     * Training may continue afterwards without affecting the snapshot. Serve predictions
+     * from it with one InferenceContext per thread.
+     *
+     * @return Shared read-only model.
+     */
+    std::shared_ptr<const CompiledModel> compile() const;
+
+    /**
+     * @brief Writes the current weights to a model file (see CompiledModel::save).
+     * @param path Destination file.
+     * @return True on success.
+     */
+    bool save(const std::string &path) const;
+
+    /**
+     * @brief Replaces the weights with those of a model file written by save().
+     * @param path Model file.
+     * @return True if the file was valid and matches this network's feature layers, layer sizes and activations.
+     */
+    bool load(const std::string &path);
+
+    /**
+     * @brief Builds an int8 inference model from the current weights.
+     *
+     * Activation ranges are calibrated on the validation set. The model reads raw uint8
+     * features, so it needs the per-feature range that normalized the training data.
+     *
+     * @param feature_mins Per-feature minimums (DataHandler::get_feature_mins()).
+     * @param feature_maxs Per-feature maximums (DataHandler::get_feature_maxs()).
+     * @param granularity Per-layer or per-channel weight scales.
+     * @return Shared read-only quantized model, or nullptr for a network with feature layers.
+     */
+    std::shared_ptr<const QuantizedModel> quantize(const std::vector<double> &feature_mins,
+                                                   const std::vector<double> &feature_maxs,
+                                                   QuantizationGranularity granularity) const;
+
+    /**
+     * @brief Iterative magnitude pruning with fine-tuning.
+     *
+     * Every round raises the sparsity of the pruned layers along a cubic ramp to the target,
+     * zeroes the lowest-magnitude weights (or BSR tiles) and fine-tunes the survivors with
+     * train() at a reduced learning rate and with fresh optimizer state, since momentum
+     * gathered for the unpruned weights would push the survivors off course; pruned weights
+     * stay zero in later training. The validation accuracy after each
+     * round is printed. With max_accuracy_loss set, a round that loses more than that against
+     * the unpruned network is rolled back and pruning stops there, which trades sparsity for
+     * accuracy.
+     *
+     * @param config Pruning schedule.
+     * @return Fraction of the pruned layers' weights that was removed.
+     */
+    double prune(const PruningConfig &config);
+
+    /**
+     * @brief Snapshots the current weights into a block-sparse inference model.
+     *
+     * Meant for pruned networks: only weight tiles with a non-zero entry are kept, and
+     * inference skips the rest.
+     *
+     * @return Shared read-only sparse model, or nullptr for a network with feature layers.
+     */
+    std::shared_ptr<const SparseModel> compile_sparse() const;
+
+    /**
+     * @brief Trains the network for up to a given number of epochs.
+     *
+     * With early stopping, a target accuracy or a checkpoint path set, the validation set is
+     * evaluated after every epoch, and training ends with the weights of the best epoch.
+     * Networks with feature layers train one sample at a time, whatever the batch size.
+     *
+     * @param iterations Maximum number of epochs.
+     * @return Number of epochs run.
+     */
+    int train(int iterations);
+
+    /**
+     * @brief Prepares online learning and publishes the current weights.
+     *
+     * Sizes all scratch for the largest micro-batch and fixes the learning rate at the
+     * schedule's value for the epochs trained so far, so learn() does no allocation (apart
+     * from a snapshot that a reader still holds when the next one is published). Called by
+     * the first learn() if needed; call it again after changing the optimizer or training
+     * with train().
+     *
+     * @param config Online learning settings.
+     */
+    void start_online(const OnlineConfig &config = OnlineConfig());
+
+    /**
+     * @brief Applies one optimizer step for a single labeled sample.
+     *
+     * The cost is one forward and backward pass, independent of the training set. Must not
+     * run concurrently with other calls on this network; serve predictions from
+     * get_publisher() instead.
+     *
+     * @param sample Labeled data point with normalized features.
+     * @return Loss of the sample before the update.
+     */
+    double learn(DataPoint *sample);
+
+    /**
+     * @brief Applies one averaged optimizer step per max_batch samples of a micro-batch.
+     *
+     * Each step is one batched (GEMM) pass; networks with feature layers step per sample.
+     *
+     * @param samples Labeled data points with normalized features.
+     * @return Sum of the samples' losses before their updates.
+     */
+    double learn(const std::vector<DataPoint *> &samples);
+
+    /**
+     * @brief Publishes the current weights right away.
+     */
+    void publish();
 
     /**
-     * @brief Trains the network for a given number of iterations.
-     * @param iterations Number of training iterations.
+     * @brief Returns the publisher of the weights learned online.
+     *
+     * Create one InferenceContext per serving thread from it; each switches to the latest
+     * published weights on its next prediction.
+     *
+     * @return Publisher, valid for the lifetime of the network.
      */
-    void train(int iterations);
+    const ModelPublisher &get_publisher() const;
 
     /**
      * @brief Tests the model on the test set.
@@ -101,7 +548,8 @@ public:
     double test();
 
     /**
-     * @brief Validates the model on the validation set.
+     * @brief Validates the model on the validation set and prints the accuracy.
+     * @return Accuracy as a fraction.
      */
-    void validate();
+    double validate();
 };
\ No newline at end of file
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include "aligned_allocator.hpp"
+#include "layer.hpp"
+
+/**
+ * @brief Parameter update rule.
+ */
+enum class OptimizerType {
+    SGD,       ///< w += lr * d
+    MOMENTUM,  ///< v = mu * v + d; w += lr * v
+    NESTEROV,  ///< v = mu * v + d; w += lr * (d + mu * v)
+    ADAM       ///< Bias-corrected first and second moment estimates of d.
+};
+
+/**
+ * @brief How the learning rate changes from epoch to epoch.
+ */
+enum class LearningRateSchedule {
+    CONSTANT,     ///< lr
+    STEP,         ///< lr * decay^(epoch / schedule_epochs)
+    EXPONENTIAL,  ///< lr * decay^epoch
+    COSINE        ///< Cosine annealing from lr to min_learning_rate over schedule_epochs.
+};
+
+/**
+ * @brief Hyperparameters of an Optimizer. The base learning rate is the network's.
+ */
+struct OptimizerConfig {
+    OptimizerType type = OptimizerType::SGD;
+    double momentum = 0.9;       ///< Velocity decay of MOMENTUM and NESTEROV.
+    double beta1 = 0.9;          ///< ADAM first moment decay.
+    double beta2 = 0.999;        ///< ADAM second moment decay.
+    double epsilon = 1e-8;       ///< ADAM denominator guard.
+    LearningRateSchedule schedule = LearningRateSchedule::CONSTANT;
+    double decay = 0.5;          ///< STEP factor per schedule_epochs, EXPONENTIAL factor per epoch.
+    int schedule_epochs = 10;    ///< STEP interval, COSINE period.
+    double min_learning_rate = 0.0;  ///< COSINE floor.
+};
+
+/**
+ * @brief Applies one update rule to every weight and bias of a network.
+ *
+ * Updates are given as a descent direction d (the negative gradient, which is what the
+ * network's deltas times inputs are) times a scale, so the per-sample path can pass a delta
+ * and an input row and batched paths a summed gradient and 1 / batch size, without
+ * materializing anything. Each rule is one fused, vectorized pass that reads the direction
+ * and updates the optimizer state and the parameters together.
+ *
+ * State is kept per parameter array in the same layout as the layer, so disjoint ranges can
+ * be updated from different threads. begin_step() is thread-safe.
+ */
+class Optimizer {
+public:
+    /**
+     * @brief Scalars of one update step, fixed when the step begins.
+     */
+    struct Step {
+        real_t learning_rate;  ///< Scheduled rate, including ADAM's bias correction.
+        real_t momentum;       ///< MOMENTUM / NESTEROV velocity decay.
+        real_t beta1;          ///< ADAM first moment decay.
+        real_t beta2;          ///< ADAM second moment decay.
+        real_t epsilon;        ///< ADAM denominator guard.
+    };
+
+private:
+    /**
+     * @brief Hyperparameters.
+     */
+    OptimizerConfig config;
+
+    /**
+     * @brief Per parameter array (see slot()): velocity, or ADAM's first moment.
+     */
+    std::vector<AlignedVector<real_t>> first_moments;
+
+    /**
+     * @brief Per parameter array: ADAM's second moment.
+     */
+    std::vector<AlignedVector<real_t>> second_moments;
+
+    /**
+     * @brief Per parameter array: the owning layer's pruning mask, or null if every parameter is trained.
+     */
+    std::vector<const real_t *> masks;
+
+    /**
+     * @brief Number of steps begun so far.
+     */
+    std::atomic<long> steps;
+
+    /**
+     * @brief Learning rate of the current epoch.
+     */
+    double epoch_learning_rate;
+
+public:
+    /**
+     * @brief Creates a plain SGD optimizer.
+     */
+    Optimizer();
+
+    /**
+     * @brief Replaces the hyperparameters and clears all state.
+     * @param config Hyperparameters.
+     */
+    void set_config(const OptimizerConfig &config);
+
+    /**
+     * @brief Returns the hyperparameters.
+     * @return Current configuration.
+     */
+    const OptimizerConfig &get_config() const;
+
+    /**
+     * @brief Sizes the state for the given layers; keeps existing state if it already fits.
+     * Also picks up the layers' pruning masks, so call it again after pruning.
+     * @param layers Layers of the network.
+     */
+    void configure(const std::vector<Layer *> &layers);
+
+    /**
+     * @brief Clears all state, e.g. after pruning moved the weights it was accumulated for.
+     * The next configure() starts it at zero again.
+     */
+    void reset();
+
+    /**
+     * @brief Whether the rule keeps state, i.e. needs a materialized gradient per step.
+     * @return False for SGD.
+     */
+    bool is_stateful() const;
+
+    /**
+     * @brief Whether any layer was pruned, i.e. updates must go through apply() to keep
+     * pruned weights at zero.
+     * @return True if a mask was found by configure().
+     */
+    bool is_masked() const;
+
+    /**
+     * @brief Sets the learning rate of an epoch from the schedule.
+     * @param base_learning_rate Network learning rate.
+     * @param epoch Number of epochs trained before this one.
+     * @return Scheduled learning rate.
+     */
+    double start_epoch(double base_learning_rate, int epoch);
+
+    /**
+     * @brief Begins one update step (one sample or mini-batch); safe to call concurrently.
+     * @return Scalars to pass to every apply() of the step.
+     */
+    Step begin_step();
+
+    /**
+     * @brief Index of a parameter array: 2 * layer for weights, 2 * layer + 1 for biases.
+     * @param layer Layer index.
+     * @param biases True for the bias vector.
+     * @return State slot.
+     */
+    static size_t slot(size_t layer, bool biases);
+
+    /**
+     * @brief Updates params[0, n) with direction scale * direction[0, n); parameters masked
+     * out by pruning stay zero.
+     * @param slot Parameter array (see slot()).
+     * @param offset Offset of params[0] within the array.
+     * @param n Number of parameters.
+     * @param scale Factor applied to the direction.
+     * @param direction Descent direction (negative gradient).
+     * @param params Parameters to update.
+     * @param step Scalars from begin_step().
+     */
+    void apply(size_t slot, size_t offset, size_t n, real_t scale, const real_t *direction, real_t *params,
+               const Step &step);
+};
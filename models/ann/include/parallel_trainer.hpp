@@ -0,0 +1,158 @@
+#pragma once
+
+#include <vector>
+#include "aligned_allocator.hpp"
+#include "data_point.hpp"
+#include "optimizer.hpp"
+#include "workspace.hpp"
+
+class NeuralNetwork;
+
+/**
+ * @brief How worker threads share the weights during multithreaded training.
+ */
+enum class ParallelMode {
+    DATA_PARALLEL,  ///< Shard each mini-batch, reduce per-thread gradients in a fixed tree order, update once.
+    HOGWILD         ///< Each thread trains on its own mini-batches and updates the shared weights without locks.
+};
+
+/**
+ * @brief Mini-batch trainer for NeuralNetwork that spreads each epoch over worker threads.
+ *
+ * The work runs on the shared ThreadPool as num_threads worker states (shards, slices or
+ * Hogwild streams). Results depend on num_threads, never on how many pool threads execute them.
+ *
+ * In DATA_PARALLEL mode every mini-batch is split into one shard per thread. Each thread
+ * computes the gradient of its shard into its own buffers. The buffers are then summed
+ * pairwise in a fixed tree order (each thread reduces and applies one slice of every layer),
+ * so the result depends only on the thread count and never on scheduling.
+ *
+ * In HOGWILD mode threads take whole mini-batches round-robin and add their updates straight
+ * into the shared weights. Concurrent updates may overwrite each other; that lost-update
+ * race is the point of Hogwild and is harmless for sparse or small updates.
+ *
+ * With one thread both modes reduce to plain serial mini-batch training.
+ *
+ * Every update is one Optimizer step. SGD adds the batch gradient straight into the weights
+ * with a fused GEMM; stateful rules (momentum, Adam) and pruned networks first sum the
+ * gradient into the worker's buffers and then run the optimizer's fused update over them.
+ */
+class ParallelTrainer {
+private:
+    /**
+     * @brief Scratch owned by one worker thread.
+     */
+    struct WorkerState {
+        Workspace workspace;                                   ///< Batched inputs, activations and deltas.
+        std::vector<AlignedVector<real_t>> weight_gradients;   ///< Per layer: layer_size x stride gradient sums.
+        std::vector<AlignedVector<real_t>> bias_gradients;     ///< Per layer: layer_size gradient sums.
+        double error_sum = 0.0;                                ///< Loss of the last shard.
+    };
+
+    /**
+     * @brief Network whose weights are trained.
+     */
+    NeuralNetwork &network;
+
+    /**
+     * @brief Update rule shared by all workers.
+     */
+    Optimizer &optimizer;
+
+    /**
+     * @brief Number of worker threads.
+     */
+    unsigned num_threads;
+
+    /**
+     * @brief Weight sharing strategy.
+     */
+    ParallelMode mode;
+
+    /**
+     * @brief Per-thread scratch, indexed by worker.
+     */
+    std::vector<WorkerState> workers;
+
+    /**
+     * @brief Forward and backward pass over samples [first, first + count).
+     * @param state Worker scratch receiving activations and deltas.
+     * @param samples Training samples.
+     * @param first Index of the first sample.
+     * @param count Number of samples.
+     * @return Sum of the samples' losses.
+     */
+    double forward_backward(WorkerState &state, const std::vector<DataPoint *> &samples, size_t first, size_t count);
+
+    /**
+     * @brief Writes the summed gradient of the last forward_backward call into the worker's buffers.
+     * @param state Worker scratch.
+     * @param count Number of samples in the last forward_backward call.
+     */
+    void store_gradients(WorkerState &state, size_t count);
+
+    /**
+     * @brief Adds step times the gradient of the last forward_backward call to the network weights.
+     * @param state Worker scratch.
+     * @param count Number of samples in the last forward_backward call.
+     * @param step Learning rate divided by the batch size.
+     */
+    void apply_direct(WorkerState &state, size_t count, real_t step);
+
+    /**
+     * @brief Runs an optimizer step on the gradient stored by store_gradients.
+     * @param state Worker scratch.
+     * @param scale Inverse of the batch size.
+     * @param step Scalars from Optimizer::begin_step().
+     */
+    void apply_stored(WorkerState &state, real_t scale, const Optimizer::Step &step);
+
+    /**
+     * @brief Tree-reduces one slice of every layer's gradients across workers and applies it.
+     * @param slice Index of the slice (the calling worker).
+     * @param scale Inverse of the batch size.
+     * @param step Scalars from Optimizer::begin_step().
+     */
+    void reduce_and_apply(unsigned slice, real_t scale, const Optimizer::Step &step);
+
+    /**
+     * @brief Runs one DATA_PARALLEL epoch.
+     * @param samples Training samples.
+     * @param batch_size Samples per update.
+     * @return Sum of the samples' losses.
+     */
+    double data_parallel_epoch(const std::vector<DataPoint *> &samples, size_t batch_size);
+
+    /**
+     * @brief Runs one HOGWILD epoch (or a serial epoch with one thread).
+     * @param samples Training samples.
+     * @param batch_size Samples per update.
+     * @return Sum of the samples' losses.
+     */
+    double hogwild_epoch(const std::vector<DataPoint *> &samples, size_t batch_size);
+
+public:
+    /**
+     * @brief Creates a trainer with scratch sized for the network and batch size.
+     * @param network Network to train; must outlive the trainer.
+     * @param optimizer Update rule, configured for the network's layers; must outlive the trainer.
+     * @param batch_size Largest mini-batch that will be passed to train_epoch.
+     * @param num_threads Number of worker states (0 = size of the shared ThreadPool).
+     * @param mode Weight sharing strategy.
+     */
+    ParallelTrainer(NeuralNetwork &network, Optimizer &optimizer, size_t batch_size, unsigned num_threads, ParallelMode mode);
+
+    /**
+     * @brief Trains one pass over the samples in consecutive mini-batches.
+     * @param samples Training samples.
+     * @param batch_size Samples per update (the last batch may be smaller).
+     * @return Sum of the samples' losses over the epoch.
+     */
+    double train_epoch(const std::vector<DataPoint *> &samples, size_t batch_size);
+
+    /**
+     * @brief Returns the number of worker threads.
+     * @return Worker count.
+     */
+    unsigned get_num_threads() const;
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "aligned_allocator.hpp"
+#include "compiled_model.hpp"
+#include "data_point.hpp"
+
+/**
+ * @brief How many weight scales each quantized layer keeps.
+ */
+enum class QuantizationGranularity {
+    PER_LAYER,   ///< One scale for the whole weight matrix.
+    PER_CHANNEL  ///< One scale per output neuron (weight row).
+};
+
+/**
+ * @brief Accuracy and size of a quantized model next to its floating-point reference.
+ */
+struct QuantizationReport {
+    double float_accuracy;      ///< Accuracy of the floating-point model (fraction).
+    double quantized_accuracy;  ///< Accuracy of the int8 model (fraction).
+    double accuracy_delta;      ///< quantized_accuracy - float_accuracy.
+    size_t float_bytes;         ///< Bytes of floating-point weights and biases.
+    size_t quantized_bytes;     ///< Bytes of int8 weights plus scales and biases.
+    const char *kernel;         ///< Int8 kernel used on this machine.
+
+    /**
+     * @brief Prints the report to stdout.
+     */
+    void print() const;
+};
+
+/**
+ * @brief Post-training int8 quantization of a trained network, for inference only.
+ *
+ * Weights become symmetric int8 (|q| <= 63, so the AVX2 pmaddubsw pair sums can never
+ * saturate) with per-layer or per-channel scales. Hidden activations are requantized to
+ * uint8 with a per-layer scale calibrated from their largest value on a calibration set, so
+ * negative outputs of tanh and leaky ReLU layers are clipped to zero.
+ *
+ * The min/max input normalization is folded into the first layer, so raw uint8 pixels feed
+ * the integer kernel directly: W'_ij = W_ij / range_j and b'_i = b_i - sum_j W'_ij * min_j.
+ *
+ * The model is immutable; predict() keeps its scratch in thread-local buffers, so one
+ * instance can serve any number of threads.
+ */
+class QuantizedModel {
+private:
+    /**
+     * @brief One quantized fully connected layer.
+     */
+    struct QuantizedLayer {
+        int input_size;                ///< Number of inputs.
+        int layer_size;                ///< Number of neurons.
+        int stride;                    ///< Distance in bytes between weight rows.
+        AlignedVector<int8_t> weights; ///< Row-major layer_size x stride int8 weights.
+        std::vector<double> scales;    ///< Per neuron: weight scale times input scale.
+        std::vector<double> biases;    ///< Per neuron bias (input normalization folded in for layer 0).
+        double output_scale;           ///< Value of one uint8 step of this layer's activations.
+        Activation activation;         ///< Activation function of the layer.
+    };
+
+    /**
+     * @brief Quantized layers, input to output.
+     */
+    std::vector<QuantizedLayer> layers;
+
+    /**
+     * @brief Scale granularity the model was built with.
+     */
+    QuantizationGranularity granularity;
+
+public:
+    /**
+     * @brief Quantizes a compiled model.
+     * @param model Trained floating-point model without feature stages.
+     * @param feature_mins Per-feature minimum used to normalize the training data.
+     * @param feature_maxs Per-feature maximum used to normalize the training data.
+     * @param calibration_set Samples used to calibrate activation ranges (e.g. the validation set).
+     * @param granularity Per-layer or per-channel weight scales.
+     */
+    QuantizedModel(const CompiledModel &model,
+                   const std::vector<double> &feature_mins,
+                   const std::vector<double> &feature_maxs,
+                   const std::vector<DataPoint *> &calibration_set,
+                   QuantizationGranularity granularity);
+
+    /**
+     * @brief Predicts the class of raw (unnormalized) uint8 features.
+     * @param pixels Pointer to input_size raw feature values.
+     * @return Index of the largest output.
+     */
+    int predict(const uint8_t *pixels) const;
+
+    /**
+     * @brief Predicts the class of a data point from its raw feature vector.
+     * @param data_point Data point with raw uint8 features (e.g. MNIST).
+     * @return Index of the largest output.
+     */
+    int predict(DataPoint *data_point) const;
+
+    /**
+     * @brief Computes accuracy on a set of data points.
+     * @param samples Data points with raw uint8 features.
+     * @return Fraction of correctly predicted samples.
+     */
+    double evaluate(const std::vector<DataPoint *> &samples) const;
+
+    /**
+     * @brief Compares accuracy and size against the floating-point model.
+     * @param reference Model this one was quantized from.
+     * @param samples Data points with raw and normalized features.
+     * @return Accuracy-delta report.
+     */
+    QuantizationReport compare(std::shared_ptr<const CompiledModel> reference,
+                               const std::vector<DataPoint *> &samples) const;
+
+    /**
+     * @brief Returns the bytes of int8 weights plus scales and biases.
+     * @return Parameter footprint.
+     */
+    size_t parameter_bytes() const;
+
+    /**
+     * @brief Returns the scale granularity.
+     * @return Per-layer or per-channel.
+     */
+    QuantizationGranularity get_granularity() const;
+};
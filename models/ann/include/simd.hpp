@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include "precision.hpp"
+
+/**
+ * @brief Native-width vectors shared by the element-wise kernels (activation, optimizer and
+ * convolution) and the fixed-shape network. Internal to the model; not part of its API.
+ */
+namespace simd {
+
+// Comparisons on generic vectors wider than the hardware's are lowered one lane at a time,
+// and the kernels select lanes by comparison, so the width follows the target.
+#if defined(__AVX__)
+typedef real_t vec __attribute__((vector_size(32)));
+#else
+typedef real_t vec __attribute__((vector_size(16)));
+#endif
+constexpr size_t VEC_LANES = sizeof(vec) / sizeof(real_t);
+
+// Native-width accumulator vector, filled by widening ACC_LANES real_t values (a no-op
+// unless accum_t is wider than real_t)
+#if defined(__AVX__)
+typedef accum_t acc_vec __attribute__((vector_size(32)));
+#else
+typedef accum_t acc_vec __attribute__((vector_size(16)));
+#endif
+constexpr size_t ACC_LANES = sizeof(acc_vec) / sizeof(accum_t);
+typedef real_t acc_src __attribute__((vector_size(ACC_LANES * sizeof(real_t))));
+
+/**
+ * @brief Loads n < VEC_LANES values into the low lanes, zeroing the others.
+ */
+inline void load_partial(const real_t *src, size_t n, vec &dst) {
+    dst = vec{};
+    std::memcpy(&dst, src, n * sizeof(real_t));
+}
+
+} // namespace simd
+
+// Unaligned vector load that works for any element offset
+#define LOAD_VEC(dst, src) std::memcpy(&(dst), (src), sizeof(simd::vec))
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "aligned_allocator.hpp"
+#include "compiled_model.hpp"
+#include "data_point.hpp"
+
+/**
+ * @brief Accuracy, size and speed of a block-sparse model next to its dense reference.
+ */
+struct SparsityReport {
+    double dense_accuracy;   ///< Accuracy of the dense model (fraction).
+    double sparse_accuracy;  ///< Accuracy of the sparse model (fraction).
+    double accuracy_delta;   ///< sparse_accuracy - dense_accuracy.
+    double sparsity;         ///< Fraction of weights that are zero.
+    double block_density;    ///< Fraction of weight blocks that are stored.
+    size_t dense_bytes;      ///< Bytes of dense weights and biases.
+    size_t sparse_bytes;     ///< Bytes of stored blocks, block indices and biases.
+    double dense_ns;         ///< Mean prediction time of the dense model (InferenceContext).
+    double sparse_ns;        ///< Mean prediction time of the sparse model.
+
+    /**
+     * @brief Prints the report to stdout.
+     */
+    void print() const;
+};
+
+/**
+ * @brief Inference-only copy of a pruned network with every weight matrix in block-sparse
+ * (BSR) form.
+ *
+ * Weights are cut into linalg::BSR_BLOCK_ROWS x linalg::BSR_BLOCK_COLS tiles and only tiles
+ * with a non-zero weight are stored, so linalg::bsr_gemv does work in proportion to the
+ * stored tiles. Networks pruned in whole tiles (PruningConfig::blocked) leave no zeros inside
+ * the stored tiles; at 80-95% sparsity most of the first layer's work disappears.
+ *
+ * The model is immutable; predict() keeps its scratch in thread-local buffers, so one
+ * instance can serve any number of threads.
+ */
+class SparseModel {
+private:
+    /**
+     * @brief One fully connected layer in BSR form.
+     */
+    struct SparseLayer {
+        int input_size;                   ///< Number of inputs.
+        int layer_size;                   ///< Number of neurons.
+        size_t block_rows;                ///< Number of block rows (layer_size rounded up to whole blocks).
+        std::vector<uint32_t> row_offsets; ///< block_rows + 1 offsets into block_cols and blocks.
+        std::vector<uint32_t> block_cols; ///< First column of every stored block.
+        AlignedVector<real_t> blocks;     ///< Row-major tiles, zero-padded past the matrix edges.
+        AlignedVector<real_t> biases;     ///< Bias of each neuron.
+        Activation activation;            ///< Activation function of the layer.
+    };
+
+    /**
+     * @brief Sparse layers, input to output.
+     */
+    std::vector<SparseLayer> layers;
+
+    /**
+     * @brief Activation buffer width: the widest layer input or output, padded to whole blocks.
+     */
+    size_t scratch_size;
+
+    /**
+     * @brief Number of weights (excluding padding) and how many of them are zero.
+     */
+    size_t num_weights, num_zeros;
+
+    /**
+     * @brief Number of tiles over all layers and how many of them are stored.
+     */
+    size_t num_blocks, num_stored_blocks;
+
+public:
+    /**
+     * @brief Converts a compiled model, keeping every tile that has a non-zero weight.
+     * @param model Trained (and usually pruned) model without feature stages.
+     */
+    explicit SparseModel(const CompiledModel &model);
+
+    /**
+     * @brief Computes the output activations of one sample.
+     * @param features input_size normalized features.
+     * @param outputs Receives the output layer's activations.
+     */
+    void forward(const real_t *features, real_t *outputs) const;
+
+    /**
+     * @brief Predicts the class of one sample.
+     * @param features input_size normalized features.
+     * @return Index of the largest output.
+     */
+    int predict(const real_t *features) const;
+
+    /**
+     * @brief Predicts the class of a data point from its normalized feature vector.
+     * @param data_point Data point with normalized features.
+     * @return Index of the largest output.
+     */
+    int predict(DataPoint *data_point) const;
+
+    /**
+     * @brief Computes accuracy on a set of data points.
+     * @param samples Data points with normalized features.
+     * @return Fraction of correctly predicted samples.
+     */
+    double evaluate(const std::vector<DataPoint *> &samples) const;
+
+    /**
+     * @brief Compares accuracy, size and prediction time against the dense model.
+     * @param reference Model this one was built from.
+     * @param samples Data points with normalized features.
+     * @return Sparsity report.
+     */
+    SparsityReport compare(std::shared_ptr<const CompiledModel> reference,
+                           const std::vector<DataPoint *> &samples) const;
+
+    /**
+     * @brief Returns the bytes of stored blocks, block indices and biases.
+     * @return Parameter footprint.
+     */
+    size_t parameter_bytes() const;
+
+    /**
+     * @brief Returns the fraction of weights that are zero.
+     * @return Weight sparsity.
+     */
+    double sparsity() const;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vector>
+#include "aligned_allocator.hpp"
+#include "layer.hpp"
+
+/**
+ * @brief Preallocated activation and delta storage for every layer of a network.
+ *
+ * Sized once from the layer spec for up to `capacity` samples (one per row), so forward
+ * and backward passes never touch the heap. Row r of every buffer belongs to sample r
+ * of the current batch; the per-sample passes use row 0.
+ */
+class Workspace {
+private:
+    /**
+     * @brief Maximum number of samples per pass.
+     */
+    size_t capacity = 0;
+
+    /**
+     * @brief Number of input features.
+     */
+    size_t input_size = 0;
+
+    /**
+     * @brief Width (neuron count) of each layer.
+     */
+    std::vector<size_t> widths;
+
+    /**
+     * @brief Row-major capacity x input_size staging area for batched inputs.
+     */
+    AlignedVector<real_t> inputs;
+
+    /**
+     * @brief Per layer: row-major capacity x width outputs after activation.
+     */
+    std::vector<AlignedVector<real_t>> activations;
+
+    /**
+     * @brief Per layer: row-major capacity x width error terms.
+     */
+    std::vector<AlignedVector<real_t>> deltas;
+
+public:
+    /**
+     * @brief Creates an empty workspace; call configure() before use.
+     */
+    Workspace() = default;
+
+    /**
+     * @brief Creates a workspace sized for the given layers.
+     * @param layers Layers of the network.
+     * @param capacity Maximum number of samples per pass.
+     */
+    Workspace(const std::vector<Layer *> &layers, size_t capacity);
+
+    /**
+     * @brief (Re)allocates every buffer for the given layers; the only allocating call.
+     * @param layers Layers of the network.
+     * @param capacity Maximum number of samples per pass.
+     */
+    void configure(const std::vector<Layer *> &layers, size_t capacity);
+
+    /**
+     * @brief Returns the maximum number of samples per pass.
+     * @return Row capacity.
+     */
+    size_t get_capacity() const;
+
+    /**
+     * @brief Returns the staged input row of a sample.
+     * @param row Sample index within the batch.
+     * @return Pointer to input_size features.
+     */
+    real_t *input(size_t row = 0);
+
+    /**
+     * @brief Returns the activations of a layer for a sample.
+     * @param layer Layer index.
+     * @param row Sample index within the batch (rows are contiguous).
+     * @return Pointer to the layer's width outputs.
+     */
+    real_t *activation(size_t layer, size_t row = 0);
+
+    /**
+     * @brief Returns the activations of a layer for a sample.
+     * @param layer Layer index.
+     * @param row Sample index within the batch (rows are contiguous).
+     * @return Pointer to the layer's width outputs.
+     */
+    const real_t *activation(size_t layer, size_t row = 0) const;
+
+    /**
+     * @brief Returns the error terms of a layer for a sample.
+     * @param layer Layer index.
+     * @param row Sample index within the batch (rows are contiguous).
+     * @return Pointer to the layer's width deltas.
+     */
+    real_t *delta(size_t layer, size_t row = 0);
+
+    /**
+     * @brief Returns the final layer's outputs for a sample.
+     * @param row Sample index within the batch.
+     * @return Pointer to the network outputs.
+     */
+    const real_t *output(size_t row = 0) const;
+};
@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include "activation.hpp"
+#include "linalg.hpp"
+#include "simd.hpp"
+
+using simd::vec;
+using simd::VEC_LANES;
+using simd::load_partial;
+
+namespace {
+
+// Integer lanes as wide as real_t, for masks and to build powers of two from their bits
+typedef std::conditional<sizeof(real_t) == 4, int32_t, int64_t>::type real_bits;
+typedef real_bits vec_bits __attribute__((vector_size(sizeof(vec))));
+
+constexpr bool IS_FLOAT = sizeof(real_t) == 4;
+
+// e^x = 2^n * e^r with n = round(x / ln 2) and |r| <= ln 2 / 2. Inputs are clamped so that
+// 2^n stays a normal number.
+constexpr real_t EXP_LIMIT = IS_FLOAT ? real_t(87) : real_t(708);
+constexpr real_t LOG2E = real_t(1.4426950408889634);
+
+// ln 2 split in two, so n * LN2_HI is exact and r keeps full precision (Cody-Waite)
+constexpr real_t LN2_HI = IS_FLOAT ? real_t(0.693359375) : real_t(6.93145751953125e-1);
+constexpr real_t LN2_LO = IS_FLOAT ? real_t(-2.12194440e-4) : real_t(1.42860682030941723212e-6);
+
+// Adding 1.5 * 2^mantissa_bits rounds to an integer, which then sits in the low mantissa bits
+constexpr int MANTISSA_BITS = IS_FLOAT ? 23 : 52;
+constexpr real_bits EXPONENT_BIAS = IS_FLOAT ? 127 : 1023;
+constexpr real_t ROUND_MAGIC = real_t(1.5) * static_cast<real_t>(real_bits(1) << MANTISSA_BITS);
+constexpr real_bits ROUND_MAGIC_BITS = IS_FLOAT ? real_bits(0x4B400000) : real_bits(0x4338000000000000);
+
+// Degree of the Taylor polynomial of e^r: the truncation error is below half an ulp on |r| <= ln 2 / 2
+constexpr int EXP_DEGREE = IS_FLOAT ? 7 : 12;
+
+// Taylor coefficients 1 / k!, computed in double at compile time
+struct ExpCoefficients {
+    real_t c[EXP_DEGREE + 1];
+
+    constexpr ExpCoefficients() : c() {
+        double value = 1.0;
+        for (int k = 0; k <= EXP_DEGREE; ++k) {
+            value /= k > 1 ? k : 1;
+            c[k] = static_cast<real_t>(value);
+        }
+    }
+};
+constexpr ExpCoefficients EXP_COEFFICIENTS;
+
+/**
+ * @brief Lane-wise mask ? if_true : if_false with bitwise operations (the ?: operator on
+ * generic vectors is scalarized when the target lacks a blend instruction).
+ */
+inline void select(const vec_bits &mask, const vec &if_true, const vec &if_false, vec &result) {
+    result = (vec)(((vec_bits)if_true & mask) | ((vec_bits)if_false & ~mask));
+}
+
+/**
+ * @brief Lane-wise e^x.
+ */
+inline void exp_vec(const vec &input, vec &result) {
+    const vec upper = vec{} + EXP_LIMIT;
+    const vec lower = vec{} - EXP_LIMIT;
+    vec x;
+    select((vec_bits)(input > upper), upper, input, x);
+    select((vec_bits)(x < lower), lower, x, x);
+
+    vec rounded = x * LOG2E + ROUND_MAGIC;
+    vec n = rounded - ROUND_MAGIC;
+    vec r = x - n * LN2_HI - n * LN2_LO;
+
+    vec p = vec{} + EXP_COEFFICIENTS.c[EXP_DEGREE];
+    for (int k = EXP_DEGREE - 1; k >= 0; --k) {
+        p = p * r + EXP_COEFFICIENTS.c[k];
+    }
+
+    vec_bits exponent = (vec_bits)rounded - ROUND_MAGIC_BITS + EXPONENT_BIAS;
+    result = p * (vec)(exponent << MANTISSA_BITS);
+}
+
+template <Activation A>
+inline void apply_vec(const vec &x, vec &y);
+
+template <>
+inline void apply_vec<Activation::SIGMOID>(const vec &x, vec &y) {
+    vec e;
+    exp_vec(-x, e);
+    y = real_t(1) / (real_t(1) + e);
+}
+
+// tanh(x) = 2 * sigmoid(2x) - 1
+template <>
+inline void apply_vec<Activation::TANH>(const vec &x, vec &y) {
+    vec e;
+    exp_vec(real_t(-2) * x, e);
+    y = real_t(2) / (real_t(1) + e) - real_t(1);
+}
+
+template <>
+inline void apply_vec<Activation::RELU>(const vec &x, vec &y) {
+    select((vec_bits)(x > real_t(0)), x, vec{}, y);
+}
+
+template <>
+inline void apply_vec<Activation::LEAKY_RELU>(const vec &x, vec &y) {
+    select((vec_bits)(x > real_t(0)), x, x * activation::LEAKY_RELU_SLOPE, y);
+}
+
+template <Activation A>
+inline void derivative_vec(const vec &output, vec &d);
+
+template <>
+inline void derivative_vec<Activation::SIGMOID>(const vec &output, vec &d) {
+    d = output * (real_t(1) - output);
+}
+
+template <>
+inline void derivative_vec<Activation::TANH>(const vec &output, vec &d) {
+    d = real_t(1) - output * output;
+}
+
+template <>
+inline void derivative_vec<Activation::RELU>(const vec &output, vec &d) {
+    select((vec_bits)(output > real_t(0)), vec{} + real_t(1), vec{}, d);
+}
+
+template <>
+inline void derivative_vec<Activation::LEAKY_RELU>(const vec &output, vec &d) {
+    select((vec_bits)(output > real_t(0)), vec{} + real_t(1), vec{} + activation::LEAKY_RELU_SLOPE, d);
+}
+
+/**
+ * @brief values = f(values + biases) over one row (biases may be null); the tail goes
+ * through a zero-padded vector so every element takes the same path.
+ */
+template <Activation A>
+void map_row(real_t *values, size_t width, const real_t *biases) {
+    vec x, b, y;
+    size_t j = 0;
+    for (; j + VEC_LANES <= width; j += VEC_LANES) {
+        LOAD_VEC(x, values + j);
+        if (biases) {
+            LOAD_VEC(b, biases + j);
+            x += b;
+        }
+        apply_vec<A>(x, y);
+        std::memcpy(values + j, &y, sizeof(vec));
+    }
+    if (j < width) {
+        size_t rest = width - j;
+        load_partial(values + j, rest, x);
+        if (biases) {
+            load_partial(biases + j, rest, b);
+            x += b;
+        }
+        apply_vec<A>(x, y);
+        std::memcpy(values + j, &y, rest * sizeof(real_t));
+    }
+}
+
+template <Activation A>
+void forward_rows(real_t *values, size_t count, size_t width, const real_t *biases) {
+    if (!biases) {
+        map_row<A>(values, count * width, nullptr);  // elementwise: the rows are one long row
+        return;
+    }
+    for (size_t b = 0; b < count; ++b) {
+        map_row<A>(values + b * width, width, biases);
+    }
+}
+
+/**
+ * @brief Numerically stable softmax: e^(x - max) / sum, with the sum in accum_t.
+ */
+void softmax_row(real_t *values, size_t width, const real_t *biases) {
+    if (biases) {
+        linalg::axpy(width, 1.0, biases, values);
+    }
+    real_t max_value = *std::max_element(values, values + width);
+
+    vec x, y, sums = {};
+    accum_t total = 0;
+    size_t j = 0;
+    for (; j + VEC_LANES <= width; j += VEC_LANES) {
+        LOAD_VEC(x, values + j);
+        exp_vec(x - max_value, y);
+        sums += y;
+        std::memcpy(values + j, &y, sizeof(vec));
+    }
+    if (j < width) {
+        size_t rest = width - j;
+        load_partial(values + j, rest, x);
+        exp_vec(x - max_value, y);
+        for (size_t lane = 0; lane < rest; ++lane) {
+            total += y[lane];
+        }
+        std::memcpy(values + j, &y, rest * sizeof(real_t));
+    }
+    for (size_t lane = 0; lane < VEC_LANES; ++lane) {
+        total += sums[lane];
+    }
+
+    real_t scale = static_cast<real_t>(1 / total);
+    for (j = 0; j < width; ++j) {
+        values[j] *= scale;
+    }
+}
+
+template <Activation A>
+void backward_values(const real_t *outputs, real_t *deltas, size_t n) {
+    vec o, d, g;
+    size_t i = 0;
+    for (; i + VEC_LANES <= n; i += VEC_LANES) {
+        LOAD_VEC(o, outputs + i);
+        LOAD_VEC(d, deltas + i);
+        derivative_vec<A>(o, g);
+        d *= g;
+        std::memcpy(deltas + i, &d, sizeof(vec));
+    }
+    if (i < n) {
+        size_t rest = n - i;
+        load_partial(outputs + i, rest, o);
+        load_partial(deltas + i, rest, d);
+        derivative_vec<A>(o, g);
+        d *= g;
+        std::memcpy(deltas + i, &d, rest * sizeof(real_t));
+    }
+}
+
+} // namespace
+
+namespace activation {
+
+bool is_valid(Activation activation, bool is_output) {
+    switch (activation) {
+    case Activation::SIGMOID:
+    case Activation::TANH:
+    case Activation::RELU:
+    case Activation::LEAKY_RELU:
+        return true;
+    case Activation::SOFTMAX:
+        return is_output;
+    }
+    return false;
+}
+
+const char *name(Activation activation) {
+    switch (activation) {
+    case Activation::SIGMOID:
+        return "SIGMOID";
+    case Activation::TANH:
+        return "TANH";
+    case Activation::RELU:
+        return "RELU";
+    case Activation::LEAKY_RELU:
+        return "LEAKY_RELU";
+    case Activation::SOFTMAX:
+        return "SOFTMAX";
+    }
+    return "UNKNOWN";
+}
+
+void forward(Activation activation, real_t *values, size_t count, size_t width, const real_t *biases) {
+    switch (activation) {
+    case Activation::SIGMOID:
+        forward_rows<Activation::SIGMOID>(values, count, width, biases);
+        break;
+    case Activation::TANH:
+        forward_rows<Activation::TANH>(values, count, width, biases);
+        break;
+    case Activation::RELU:
+        forward_rows<Activation::RELU>(values, count, width, biases);
+        break;
+    case Activation::LEAKY_RELU:
+        forward_rows<Activation::LEAKY_RELU>(values, count, width, biases);
+        break;
+    case Activation::SOFTMAX:
+        for (size_t b = 0; b < count; ++b) {
+            softmax_row(values + b * width, width, biases);
+        }
+        break;
+    }
+}
+
+void backward(Activation activation, const real_t *outputs, real_t *deltas, size_t n) {
+    switch (activation) {
+    case Activation::SIGMOID:
+        backward_values<Activation::SIGMOID>(outputs, deltas, n);
+        break;
+    case Activation::TANH:
+        backward_values<Activation::TANH>(outputs, deltas, n);
+        break;
+    case Activation::RELU:
+        backward_values<Activation::RELU>(outputs, deltas, n);
+        break;
+    case Activation::LEAKY_RELU:
+        backward_values<Activation::LEAKY_RELU>(outputs, deltas, n);
+        break;
+    case Activation::SOFTMAX:
+        break;  // only used on the output layer, see output_deltas
+    }
+}
+
+double output_deltas(Activation activation, const real_t *outputs, size_t label, real_t *deltas, size_t width) {
+    if (activation == Activation::SOFTMAX) {
+        // d(cross-entropy)/d(logits) = output - target, so the delta needs no derivative
+        for (size_t j = 0; j < width; ++j) {
+            deltas[j] = (j == label ? real_t(1) : real_t(0)) - outputs[j];
+        }
+        double probability = std::max<double>(outputs[label], std::numeric_limits<real_t>::min());
+        return -std::log(probability);
+    }
+
+    double error_sum = 0.0;
+    for (size_t j = 0; j < width; ++j) {
+        real_t diff = (j == label ? real_t(1) : real_t(0)) - outputs[j];
+        error_sum += static_cast<double>(diff) * diff;
+        deltas[j] = diff;
+    }
+    backward(activation, outputs, deltas, width);
+    return error_sum;
+}
+
+} // namespace activation
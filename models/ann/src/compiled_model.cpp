@@ -0,0 +1,459 @@
+#include <algorithm>
+#include <iostream>
+#include "activation.hpp"
+#include "compiled_model.hpp"
+#include "instrumentation.hpp"
+#include "linalg.hpp"
+
+namespace {
+
+const uint32_t LAYER_SECTION = section_tag("LAYR");
+const uint32_t PARAMETER_SECTION = section_tag("PARM");
+const uint32_t STAGE_SECTION = section_tag("STGE");
+
+/**
+ * @brief Fixed-width on-disk form of a LayerView. Files written before activations were
+ * recorded hold 0 (SIGMOID) in the activation field.
+ */
+struct LayerRecord {
+    int32_t input_size;
+    int32_t layer_size;
+    int32_t stride;
+    int32_t activation;
+    uint64_t weight_offset;
+    uint64_t bias_offset;
+};
+
+/**
+ * @brief Fixed-width on-disk form of a StageView. Output shapes are not stored; load()
+ * recomputes them from the input shape and the kernel.
+ */
+struct StageRecord {
+    int32_t type;
+    int32_t input_channels;
+    int32_t input_height;
+    int32_t input_width;
+    int32_t channels;
+    int32_t kernel_size;
+    int32_t padding;
+    int32_t stride;
+    int32_t activation;
+    int32_t reserved;
+    uint64_t weight_offset;
+    uint64_t bias_offset;
+};
+
+} // namespace
+
+/**
+ * @brief Lays every layer out back to back, each matrix starting on a cache line, followed
+ * by the filters of the convolution stages.
+ */
+CompiledModel::CompiledModel(const std::vector<Layer *> &layers, const FeatureExtractor *features)
+    : max_width(0)
+{
+    const size_t line = 64 / sizeof(real_t);
+    size_t offset = 0;
+    for (const Layer *layer : layers) {
+        LayerView view;
+        view.input_size = layer->input_size;
+        view.layer_size = layer->layer_size;
+        view.stride = layer->stride;
+        view.weight_offset = offset;
+        offset += layer->weights.size();
+        view.bias_offset = offset;
+        view.activation = layer->activation;
+        offset += (layer->biases.size() + line - 1) / line * line;
+        views.push_back(view);
+        max_width = std::max(max_width, layer->layer_size);
+    }
+    for (size_t i = 0; features && i < features->get_stages().size(); ++i) {
+        StageView view = {features->get_stages()[i], 0, offset, offset, Activation::SIGMOID};
+        const Layer *filters = features->get_filters(i);
+        if (filters) {
+            view.stride = filters->stride;
+            offset += filters->weights.size();
+            view.bias_offset = offset;
+            view.activation = filters->activation;
+            offset += (filters->biases.size() + line - 1) / line * line;
+        }
+        stage_views.push_back(view);
+    }
+
+    owned_parameters.assign(offset, 0.0);
+    parameters = owned_parameters.data();
+    num_parameters = owned_parameters.size();
+    refill(layers, features);
+}
+
+/**
+ * @brief Checks every layer and filter bank against its view before copying, so a recycled
+ * model can only be refilled from the network it was compiled from.
+ */
+bool CompiledModel::refill(const std::vector<Layer *> &layers, const FeatureExtractor *features) {
+    size_t num_stages = features ? features->get_stages().size() : 0;
+    bool same_shape = !file && layers.size() == views.size() && num_stages == stage_views.size();
+    for (size_t l = 0; same_shape && l < layers.size(); ++l) {
+        same_shape = layers[l]->layer_size == views[l].layer_size && layers[l]->stride == views[l].stride;
+    }
+    for (size_t i = 0; same_shape && i < num_stages; ++i) {
+        const Layer *filters = features->get_filters(i);
+        same_shape = !filters || (filters->layer_size == stage_views[i].stage.output.channels
+                                  && filters->stride == stage_views[i].stride);
+    }
+    if (!same_shape) {
+        return false;
+    }
+
+    for (size_t l = 0; l < layers.size(); ++l) {
+        std::copy(layers[l]->weights.begin(), layers[l]->weights.end(), owned_parameters.begin() + views[l].weight_offset);
+        std::copy(layers[l]->biases.begin(), layers[l]->biases.end(), owned_parameters.begin() + views[l].bias_offset);
+    }
+    for (size_t i = 0; i < num_stages; ++i) {
+        const Layer *filters = features->get_filters(i);
+        if (filters) {
+            std::copy(filters->weights.begin(), filters->weights.end(), owned_parameters.begin() + stage_views[i].weight_offset);
+            std::copy(filters->biases.begin(), filters->biases.end(), owned_parameters.begin() + stage_views[i].bias_offset);
+        }
+    }
+    return true;
+}
+
+CompiledModel::CompiledModel(std::vector<LayerView> views, std::vector<StageView> stage_views,
+                             std::shared_ptr<const MappedModelFile> file, const real_t *parameters, size_t num_parameters)
+    : views(std::move(views)),
+      stage_views(std::move(stage_views)),
+      file(std::move(file)),
+      parameters(parameters),
+      num_parameters(num_parameters),
+      max_width(0)
+{
+    for (const LayerView &view : this->views) {
+        max_width = std::max(max_width, view.layer_size);
+    }
+}
+
+bool CompiledModel::save(const std::string &path) const {
+    std::vector<LayerRecord> records;
+    for (const LayerView &view : views) {
+        records.push_back({view.input_size, view.layer_size, view.stride, static_cast<int32_t>(view.activation),
+                           view.weight_offset, view.bias_offset});
+    }
+    ModelWriter writer(ModelType::NEURAL_NETWORK);
+    writer.add_section(LAYER_SECTION, records.data(), records.size() * sizeof(LayerRecord));
+    writer.add_section(PARAMETER_SECTION, parameters, num_parameters * sizeof(real_t));
+    std::vector<StageRecord> stage_records;
+    for (const StageView &view : stage_views) {
+        const FeatureStage &stage = view.stage;
+        stage_records.push_back({static_cast<int32_t>(stage.type), stage.input.channels, stage.input.height,
+                                 stage.input.width, stage.output.channels, stage.kernel_size, stage.padding, view.stride,
+                                 static_cast<int32_t>(view.activation), 0, view.weight_offset, view.bias_offset});
+    }
+    if (!stage_records.empty()) {
+        writer.add_section(STAGE_SECTION, stage_records.data(), stage_records.size() * sizeof(StageRecord));
+    }
+    return writer.save(path);
+}
+
+/**
+ * @brief Checks that every layer chains onto the previous one, has a known activation and
+ * that its weights and biases lie inside the parameter section before trusting any offset.
+ */
+std::shared_ptr<const CompiledModel> CompiledModel::load(const std::string &path) {
+    std::shared_ptr<const MappedModelFile> file = MappedModelFile::open(path, ModelType::NEURAL_NETWORK);
+    if (!file) {
+        return nullptr;
+    }
+    size_t record_bytes, parameter_bytes;
+    const LayerRecord *records = static_cast<const LayerRecord *>(file->section(LAYER_SECTION, record_bytes));
+    const real_t *parameters = static_cast<const real_t *>(file->section(PARAMETER_SECTION, parameter_bytes));
+    size_t num_layers = record_bytes / sizeof(LayerRecord);
+    size_t num_parameters = parameter_bytes / sizeof(real_t);
+
+    std::vector<LayerView> views;
+    for (size_t l = 0; l < num_layers && parameters; ++l) {
+        const LayerRecord &record = records[l];
+        Activation activation = static_cast<Activation>(record.activation);
+        size_t weight_count = static_cast<size_t>(record.layer_size) * static_cast<size_t>(record.stride);
+        bool valid = record.input_size > 0 && record.layer_size > 0 && record.stride >= record.input_size
+                     && (l == 0 || record.input_size == views.back().layer_size)
+                     && activation::is_valid(activation, l + 1 == num_layers)
+                     && record.weight_offset <= num_parameters && weight_count <= num_parameters - record.weight_offset
+                     && record.bias_offset <= num_parameters
+                     && static_cast<size_t>(record.layer_size) <= num_parameters - record.bias_offset;
+        if (!valid) {
+            break;
+        }
+        views.push_back({record.input_size, record.layer_size, record.stride, record.weight_offset, record.bias_offset,
+                         activation});
+    }
+    if (views.empty() || views.size() != num_layers) {
+        std::cerr << "Model file '" << path << "' has inconsistent layer shapes." << std::endl;
+        return nullptr;
+    }
+
+    // Optional feature stages: each must chain onto the previous one and the last must feed the first layer
+    size_t stage_bytes;
+    const StageRecord *stage_records = static_cast<const StageRecord *>(file->section(STAGE_SECTION, stage_bytes));
+    size_t num_stages = stage_records ? stage_bytes / sizeof(StageRecord) : 0;
+    std::vector<StageView> stage_views;
+    for (size_t i = 0; i < num_stages; ++i) {
+        const StageRecord &record = stage_records[i];
+        FeatureLayerType type = static_cast<FeatureLayerType>(record.type);
+        ImageShape input = {record.input_channels, record.input_height, record.input_width};
+        FeatureLayerSpec spec = {type, record.channels, record.kernel_size, record.padding};
+        StageView view = {FeatureStage(), record.stride, record.weight_offset, record.bias_offset,
+                          static_cast<Activation>(record.activation)};
+        bool valid = (type == FeatureLayerType::CONVOLUTION || type == FeatureLayerType::MAX_POOL)
+                     && convolution::make_stage(input, spec, view.stage)
+                     && (i == 0 || (input.channels == stage_views.back().stage.output.channels
+                                    && input.height == stage_views.back().stage.output.height
+                                    && input.width == stage_views.back().stage.output.width));
+        if (valid && type == FeatureLayerType::CONVOLUTION) {
+            size_t weight_count = static_cast<size_t>(record.channels) * static_cast<size_t>(record.stride);
+            valid = record.stride > 0 && static_cast<size_t>(record.stride) >= view.stage.taps()
+                    && activation::is_valid(view.activation, false)
+                    && record.weight_offset <= num_parameters && weight_count <= num_parameters - record.weight_offset
+                    && record.bias_offset <= num_parameters
+                    && static_cast<size_t>(record.channels) <= num_parameters - record.bias_offset;
+        }
+        if (!valid) {
+            break;
+        }
+        stage_views.push_back(view);
+    }
+    if (stage_views.size() != num_stages
+        || (num_stages > 0 && stage_views.back().stage.output.size() != static_cast<size_t>(views.front().input_size))) {
+        std::cerr << "Model file '" << path << "' has inconsistent feature stages." << std::endl;
+        return nullptr;
+    }
+    return std::shared_ptr<const CompiledModel>(new CompiledModel(std::move(views), std::move(stage_views),
+                                                                  std::move(file), parameters, num_parameters));
+}
+
+size_t CompiledModel::num_layers() const {
+    return views.size();
+}
+
+const CompiledModel::LayerView &CompiledModel::layer(size_t layer) const {
+    return views[layer];
+}
+
+const real_t *CompiledModel::weights(size_t layer) const {
+    return parameters + views[layer].weight_offset;
+}
+
+const real_t *CompiledModel::biases(size_t layer) const {
+    return parameters + views[layer].bias_offset;
+}
+
+size_t CompiledModel::num_stages() const {
+    return stage_views.size();
+}
+
+const CompiledModel::StageView &CompiledModel::stage(size_t stage) const {
+    return stage_views[stage];
+}
+
+const real_t *CompiledModel::stage_weights(size_t stage) const {
+    return parameters + stage_views[stage].weight_offset;
+}
+
+const real_t *CompiledModel::stage_biases(size_t stage) const {
+    return parameters + stage_views[stage].bias_offset;
+}
+
+int CompiledModel::input_size() const {
+    if (!stage_views.empty()) {
+        return static_cast<int>(stage_views.front().stage.input.size());
+    }
+    return views.front().input_size;
+}
+
+int CompiledModel::output_size() const {
+    return views.back().layer_size;
+}
+
+int CompiledModel::get_max_width() const {
+    return max_width;
+}
+
+ModelPublisher::ModelPublisher()
+    : version(0) {}
+
+/**
+ * @brief The retired snapshot is free once the writer's handle is its only owner: readers
+ * can no longer acquire it, and the acquire fence orders their last reads of it before the
+ * writes of the refill.
+ */
+void ModelPublisher::publish(const std::vector<Layer *> &layers, const FeatureExtractor *features) {
+    bool recycled = false;
+    if (back && back.use_count() == 1) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        recycled = back->refill(layers, features);
+    }
+    if (!recycled) {
+        back = std::make_shared<CompiledModel>(layers, features);
+    }
+    std::atomic_store_explicit(&published, std::shared_ptr<const CompiledModel>(back), std::memory_order_release);
+    version.fetch_add(1, std::memory_order_release);
+    std::swap(front, back);
+}
+
+std::shared_ptr<const CompiledModel> ModelPublisher::acquire() const {
+    return std::atomic_load_explicit(&published, std::memory_order_acquire);
+}
+
+uint64_t ModelPublisher::get_version() const {
+    return version.load(std::memory_order_acquire);
+}
+
+InferenceContext::InferenceContext(std::shared_ptr<const CompiledModel> model, size_t capacity)
+    : model(std::move(model)), publisher(nullptr), version(0), capacity(std::max<size_t>(1, capacity))
+{
+    allocate();
+}
+
+InferenceContext::InferenceContext(const ModelPublisher &publisher, size_t capacity)
+    : publisher(&publisher), version(publisher.get_version()), capacity(std::max<size_t>(1, capacity))
+{
+    model = publisher.acquire();
+    allocate();
+}
+
+void InferenceContext::allocate() {
+    size_t size = capacity * static_cast<size_t>(model->get_max_width());
+    for (AlignedVector<real_t> &buffer : buffers) {
+        if (buffer.size() < size) {
+            buffer.assign(size, 0.0);
+        }
+    }
+
+    size_t stage_size = 0, column_size = 0;
+    for (size_t i = 0; i < model->num_stages(); ++i) {
+        const FeatureStage &stage = model->stage(i).stage;
+        stage_size = std::max(stage_size, stage.output.size());
+        if (stage.type == FeatureLayerType::CONVOLUTION) {
+            column_size = std::max(column_size, convolution::column_size(stage));
+        }
+    }
+    if (stage_size > 0) {
+        for (AlignedVector<real_t> &buffer : stage_buffers) {
+            if (buffer.size() < stage_size) {
+                buffer.assign(stage_size, 0.0);
+            }
+        }
+        if (columns.size() < column_size) {
+            columns.assign(column_size, 0.0);
+        }
+        size_t extracted_size = capacity * static_cast<size_t>(model->layer(0).input_size);
+        if (extracted.size() < extracted_size) {
+            extracted.assign(extracted_size, 0.0);
+        }
+    }
+}
+
+/**
+ * @brief The version is read before the model, so a publish in between at worst makes the
+ * next call switch again.
+ */
+void InferenceContext::refresh() {
+    if (!publisher) {
+        return;
+    }
+    uint64_t latest = publisher->get_version();
+    if (latest != version) {
+        version = latest;
+        model = publisher->acquire();
+        allocate();
+    }
+}
+
+/**
+ * @brief Stage i writes stage buffer i % 2, except the last one, which writes the sample's
+ * row of extracted.
+ */
+const real_t *InferenceContext::extract(const real_t *features, size_t count, size_t stride) {
+    size_t width = static_cast<size_t>(model->layer(0).input_size);
+    size_t last = model->num_stages() - 1;
+    for (size_t b = 0; b < count; ++b) {
+        const real_t *inputs = features + b * stride;
+        for (size_t i = 0; i <= last; ++i) {
+            const CompiledModel::StageView &view = model->stage(i);
+            real_t *outputs = i == last ? extracted.data() + b * width : stage_buffers[i % 2].data();
+            if (view.stage.type == FeatureLayerType::CONVOLUTION) {
+                convolution::forward(view.stage, model->stage_weights(i), static_cast<size_t>(view.stride),
+                                     model->stage_biases(i), view.activation, inputs, outputs, columns.data());
+            } else {
+                convolution::max_pool(view.stage, inputs, outputs, nullptr);
+            }
+            inputs = outputs;
+        }
+    }
+    return extracted.data();
+}
+
+/**
+ * @brief Layer l reads buffer (l + 1) % 2 and writes buffer l % 2; a single sample uses GEMV,
+ * a batch uses GEMM.
+ */
+const real_t *InferenceContext::forward_rows(const real_t *features, size_t count, size_t stride) {
+    const real_t *inputs = features;
+    size_t input_stride = stride;
+    if (model->num_stages() > 0) {
+        inputs = extract(features, count, stride);
+        input_stride = static_cast<size_t>(model->layer(0).input_size);
+    }
+    for (size_t l = 0; l < model->num_layers(); ++l) {
+        const CompiledModel::LayerView &view = model->layer(l);
+        size_t width = static_cast<size_t>(view.layer_size);
+        const real_t *biases = model->biases(l);
+        real_t *outputs = buffers[l % 2].data();
+        RTML_COUNT("inference_context.bytes_scanned", width * view.stride * sizeof(real_t));
+
+        if (count == 1) {
+            linalg::gemv(width, view.input_size, 1.0, model->weights(l), view.stride, inputs, 0.0, outputs);
+        } else {
+            linalg::gemm(linalg::Transpose::NO, linalg::Transpose::YES, count, width, view.input_size,
+                         1.0, inputs, input_stride, model->weights(l), view.stride, 0.0, outputs, width);
+        }
+        activation::forward(view.activation, outputs, count, width, biases);
+        inputs = outputs;
+        input_stride = width;
+    }
+    return inputs;
+}
+
+const real_t *InferenceContext::forward(const real_t *features) {
+    refresh();
+    return forward_rows(features, 1, static_cast<size_t>(model->input_size()));
+}
+
+int InferenceContext::predict(const real_t *features) {
+    RTML_TIMER("inference_context.predict");
+    const real_t *outputs = forward(features);
+    return static_cast<int>(std::max_element(outputs, outputs + model->output_size()) - outputs);
+}
+
+int InferenceContext::predict(DataPoint *data_point) {
+    return predict(data_point->get_normalized_feature_vector()->data());
+}
+
+void InferenceContext::predict_batch(const real_t *features, size_t count, size_t stride, int *labels) {
+    RTML_TIMER("inference_context.predict_batch");
+    RTML_COUNT("inference_context.predictions", count);
+    refresh();
+    size_t num_outputs = static_cast<size_t>(model->output_size());
+    for (size_t first = 0; first < count; first += capacity) {
+        size_t rows = std::min(capacity, count - first);
+        const real_t *outputs = forward_rows(features + first * stride, rows, stride);
+        for (size_t b = 0; b < rows; ++b) {
+            const real_t *row = outputs + b * num_outputs;
+            labels[first + b] = static_cast<int>(std::max_element(row, row + num_outputs) - row);
+        }
+    }
+}
+
+const CompiledModel &InferenceContext::get_model() const {
+    return *model;
+}
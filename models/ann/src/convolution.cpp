@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <cstring>
+#include "convolution.hpp"
+#include "linalg.hpp"
+#include "simd.hpp"
+
+using simd::vec;
+using simd::VEC_LANES;
+
+namespace {
+
+/**
+ * @brief y[0, n) += a * x[0, n), inlined into col2im, which calls it once per image row.
+ */
+inline void add_scaled_row(real_t *y, const real_t *x, size_t n, real_t a) {
+    vec vx, vy;
+    size_t i = 0;
+    for (; i + VEC_LANES <= n; i += VEC_LANES) {
+        std::memcpy(&vx, x + i, sizeof(vec));
+        std::memcpy(&vy, y + i, sizeof(vec));
+        vy += a * vx;
+        std::memcpy(y + i, &vy, sizeof(vec));
+    }
+    for (; i < n; ++i) {
+        y[i] += a * x[i];
+    }
+}
+
+/**
+ * @brief Output columns [begin, end) whose input column ox + offset lies inside a row of `width`.
+ */
+inline void valid_range(int offset, int width, int output_width, int &begin, int &end) {
+    begin = std::max(0, -offset);
+    end = std::min(output_width, width - offset);
+    if (end < begin) {
+        end = begin;
+    }
+}
+
+} // namespace
+
+size_t ImageShape::size() const {
+    return static_cast<size_t>(channels) * height * width;
+}
+
+FeatureLayerSpec FeatureLayerSpec::convolution(int channels, int kernel_size) {
+    return {FeatureLayerType::CONVOLUTION, channels, kernel_size, kernel_size / 2};
+}
+
+FeatureLayerSpec FeatureLayerSpec::max_pool(int size) {
+    return {FeatureLayerType::MAX_POOL, 0, size, 0};
+}
+
+size_t FeatureStage::taps() const {
+    return static_cast<size_t>(input.channels) * kernel_size * kernel_size;
+}
+
+namespace convolution {
+
+bool make_stage(const ImageShape &input, const FeatureLayerSpec &spec, FeatureStage &stage) {
+    stage.type = spec.type;
+    stage.input = input;
+    stage.kernel_size = spec.kernel_size;
+    if (spec.kernel_size < 1 || input.channels < 1 || input.height < 1 || input.width < 1) {
+        return false;
+    }
+    if (spec.type == FeatureLayerType::CONVOLUTION) {
+        stage.padding = spec.padding;
+        stage.output.channels = spec.channels;
+        stage.output.height = input.height + 2 * spec.padding - spec.kernel_size + 1;
+        stage.output.width = input.width + 2 * spec.padding - spec.kernel_size + 1;
+        return spec.channels > 0 && spec.padding >= 0 && spec.padding < spec.kernel_size
+               && stage.output.height > 0 && stage.output.width > 0;
+    }
+    stage.padding = 0;
+    stage.output.channels = input.channels;
+    stage.output.height = input.height / spec.kernel_size;
+    stage.output.width = input.width / spec.kernel_size;
+    return stage.output.height > 0 && stage.output.width > 0;
+}
+
+/**
+ * @brief Rows of the direct kernel's staging area: the input plus the padding on both sides.
+ */
+static size_t padded_height(const FeatureStage &stage) {
+    return static_cast<size_t>(stage.input.height) + 2 * stage.padding;
+}
+
+/**
+ * @brief Columns of the direct kernel's staging area: every output chunk of two vectors
+ * reads kernel_size - 1 values past its end.
+ */
+static size_t padded_width(const FeatureStage &stage) {
+    size_t chunk = 2 * VEC_LANES;
+    return (static_cast<size_t>(stage.output.width) + chunk - 1) / chunk * chunk + stage.kernel_size - 1;
+}
+
+size_t column_size(const FeatureStage &stage) {
+    size_t columns = stage.taps() * static_cast<size_t>(stage.output.height) * stage.output.width;
+    size_t staged = static_cast<size_t>(stage.input.channels) * padded_height(stage) * padded_width(stage);
+    return std::max(columns, staged);
+}
+
+bool is_direct(const FeatureStage &stage) {
+    return stage.taps() <= DIRECT_MAX_TAPS;
+}
+
+/**
+ * @brief Row (c, r, s) of the column matrix is channel c shifted by (r - padding, s - padding);
+ * every in-range output row is one contiguous copy.
+ */
+void im2col(const FeatureStage &stage, const real_t *input, real_t *columns) {
+    const int k = stage.kernel_size, pad = stage.padding;
+    const int height = stage.input.height, width = stage.input.width;
+    const int out_height = stage.output.height, out_width = stage.output.width;
+    const size_t pixels = static_cast<size_t>(out_height) * out_width;
+    for (int c = 0; c < stage.input.channels; ++c) {
+        for (int r = 0; r < k; ++r) {
+            for (int s = 0; s < k; ++s) {
+                real_t *row = columns + ((static_cast<size_t>(c) * k + r) * k + s) * pixels;
+                int begin, end;
+                valid_range(s - pad, width, out_width, begin, end);
+                for (int oy = 0; oy < out_height; ++oy) {
+                    real_t *out = row + static_cast<size_t>(oy) * out_width;
+                    int iy = oy + r - pad;
+                    if (iy < 0 || iy >= height) {
+                        std::fill(out, out + out_width, real_t(0));
+                        continue;
+                    }
+                    const real_t *in = input + (static_cast<size_t>(c) * height + iy) * width + (s - pad);
+                    std::fill(out, out + begin, real_t(0));
+                    std::copy(in + begin, in + end, out + begin);
+                    std::fill(out + end, out + out_width, real_t(0));
+                }
+            }
+        }
+    }
+}
+
+void col2im(const FeatureStage &stage, const real_t *columns, real_t *input) {
+    const int k = stage.kernel_size, pad = stage.padding;
+    const int height = stage.input.height, width = stage.input.width;
+    const int out_height = stage.output.height, out_width = stage.output.width;
+    const size_t pixels = static_cast<size_t>(out_height) * out_width;
+    std::fill(input, input + stage.input.size(), real_t(0));
+    for (int c = 0; c < stage.input.channels; ++c) {
+        for (int r = 0; r < k; ++r) {
+            for (int s = 0; s < k; ++s) {
+                const real_t *row = columns + ((static_cast<size_t>(c) * k + r) * k + s) * pixels;
+                int begin, end;
+                valid_range(s - pad, width, out_width, begin, end);
+                for (int oy = std::max(0, pad - r); oy < std::min(out_height, height + pad - r); ++oy) {
+                    real_t *in = input + (static_cast<size_t>(c) * height + oy + r - pad) * width + (s - pad);
+                    add_scaled_row(in + begin, row + static_cast<size_t>(oy) * out_width + begin,
+                                   static_cast<size_t>(end - begin), real_t(1));
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief The direct kernel copies the input into a zero-bordered staging area (rows padded so
+ * whole vectors can be read past the right edge) and then, for every filter and output row,
+ * keeps two vectors of outputs in registers while it sums all taps into them. The im2col
+ * kernel is one GEMM. Both then add the channel biases and apply the activation over the
+ * whole tensor.
+ */
+void forward(const FeatureStage &stage, const real_t *filters, size_t filter_stride, const real_t *biases,
+             Activation activation, const real_t *input, real_t *output, real_t *columns) {
+    const size_t k = static_cast<size_t>(stage.kernel_size), pad = static_cast<size_t>(stage.padding);
+    const size_t height = static_cast<size_t>(stage.input.height), width = static_cast<size_t>(stage.input.width);
+    const size_t out_height = static_cast<size_t>(stage.output.height), out_width = static_cast<size_t>(stage.output.width);
+    const size_t pixels = out_height * out_width;
+    const size_t num_filters = static_cast<size_t>(stage.output.channels);
+
+    if (is_direct(stage)) {
+        const size_t staged_height = padded_height(stage), staged_width = padded_width(stage);
+        std::fill(columns, columns + stage.input.channels * staged_height * staged_width, real_t(0));
+        for (size_t c = 0; c < static_cast<size_t>(stage.input.channels); ++c) {
+            for (size_t y = 0; y < height; ++y) {
+                const real_t *in = input + (c * height + y) * width;
+                std::copy(in, in + width, columns + (c * staged_height + y + pad) * staged_width + pad);
+            }
+        }
+
+        const size_t chunk = 2 * VEC_LANES;
+        alignas(64) real_t tail[2 * VEC_LANES];
+        for (size_t f = 0; f < num_filters; f += 2) {
+            // Filters are handled in pairs so every input vector loaded feeds two accumulators
+            const size_t g = std::min(f + 1, num_filters - 1);
+            const real_t *filter0 = filters + f * filter_stride, *filter1 = filters + g * filter_stride;
+            for (size_t oy = 0; oy < out_height; ++oy) {
+                for (size_t ox = 0; ox < out_width; ox += chunk) {
+                    vec acc00 = vec{} + biases[f], acc01 = acc00, acc10 = vec{} + biases[g], acc11 = acc10, v0, v1;
+                    size_t t = 0;
+                    for (size_t c = 0; c < static_cast<size_t>(stage.input.channels); ++c) {
+                        for (size_t r = 0; r < k; ++r) {
+                            const real_t *in = columns + (c * staged_height + oy + r) * staged_width + ox;
+                            for (size_t s = 0; s < k; ++s, ++t) {
+                                std::memcpy(&v0, in + s, sizeof(vec));
+                                std::memcpy(&v1, in + s + VEC_LANES, sizeof(vec));
+                                acc00 += filter0[t] * v0;
+                                acc01 += filter0[t] * v1;
+                                acc10 += filter1[t] * v0;
+                                acc11 += filter1[t] * v1;
+                            }
+                        }
+                    }
+                    const vec *results[2][2] = {{&acc00, &acc01}, {&acc10, &acc11}};
+                    for (size_t i = 0; i < 2 && f + i < num_filters; ++i) {
+                        real_t *out = output + (f + i) * pixels + oy * out_width + ox;
+                        if (ox + chunk <= out_width) {
+                            std::memcpy(out, results[i][0], sizeof(vec));
+                            std::memcpy(out + VEC_LANES, results[i][1], sizeof(vec));
+                        } else {
+                            std::memcpy(tail, results[i][0], sizeof(vec));
+                            std::memcpy(tail + VEC_LANES, results[i][1], sizeof(vec));
+                            std::copy(tail, tail + (out_width - ox), out);
+                        }
+                    }
+                }
+            }
+        }
+    } else {
+        im2col(stage, input, columns);
+        linalg::gemm(linalg::Transpose::NO, linalg::Transpose::NO, num_filters, pixels, stage.taps(),
+                     1.0, filters, filter_stride, columns, pixels, 0.0, output, pixels);
+        for (size_t f = 0; f < num_filters; ++f) {
+            real_t *plane = output + f * pixels;
+            for (size_t p = 0; p < pixels; ++p) {
+                plane[p] += biases[f];
+            }
+        }
+    }
+    activation::forward(activation, output, 1, num_filters * pixels, nullptr);
+}
+
+/**
+ * @brief dW = deltas * columns^T and d(columns) = W^T * deltas, the latter folded back with
+ * col2im. The column scratch is reused for d(columns) once dW is done.
+ */
+void backward(const FeatureStage &stage, const real_t *filters, size_t filter_stride, const real_t *input,
+              const real_t *deltas, real_t *columns, real_t *weight_direction, real_t *bias_direction,
+              real_t *input_deltas) {
+    const size_t pixels = static_cast<size_t>(stage.output.height) * stage.output.width;
+    const size_t num_filters = static_cast<size_t>(stage.output.channels);
+    const size_t taps = stage.taps();
+
+    im2col(stage, input, columns);
+    linalg::gemm(linalg::Transpose::NO, linalg::Transpose::YES, num_filters, taps, pixels,
+                 1.0, deltas, pixels, columns, pixels, 0.0, weight_direction, filter_stride);
+    for (size_t f = 0; f < num_filters; ++f) {
+        const real_t *plane = deltas + f * pixels;
+        accum_t sum = 0;
+        for (size_t p = 0; p < pixels; ++p) {
+            sum += plane[p];
+        }
+        bias_direction[f] = static_cast<real_t>(sum);
+    }
+
+    if (input_deltas) {
+        linalg::gemm(linalg::Transpose::YES, linalg::Transpose::NO, taps, pixels, num_filters,
+                     1.0, filters, filter_stride, deltas, pixels, 0.0, columns, pixels);
+        col2im(stage, columns, input_deltas);
+    }
+}
+
+void max_pool(const FeatureStage &stage, const real_t *input, real_t *output, uint32_t *argmax) {
+    const int k = stage.kernel_size;
+    const int height = stage.input.height, width = stage.input.width;
+    size_t o = 0;
+    for (int c = 0; c < stage.output.channels; ++c) {
+        for (int oy = 0; oy < stage.output.height; ++oy) {
+            for (int ox = 0; ox < stage.output.width; ++ox, ++o) {
+                size_t best = (static_cast<size_t>(c) * height + oy * k) * width + ox * k;
+                for (int r = 0; r < k; ++r) {
+                    size_t row = (static_cast<size_t>(c) * height + oy * k + r) * width + ox * k;
+                    for (int s = 0; s < k; ++s) {
+                        if (input[row + s] > input[best]) {
+                            best = row + s;
+                        }
+                    }
+                }
+                output[o] = input[best];
+                if (argmax) {
+                    argmax[o] = static_cast<uint32_t>(best);
+                }
+            }
+        }
+    }
+}
+
+void max_pool_backward(const FeatureStage &stage, const real_t *deltas, const uint32_t *argmax, real_t *input_deltas) {
+    std::fill(input_deltas, input_deltas + stage.input.size(), real_t(0));
+    for (size_t o = 0; o < stage.output.size(); ++o) {
+        input_deltas[argmax[o]] += deltas[o];
+    }
+}
+
+} // namespace convolution
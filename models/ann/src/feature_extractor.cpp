@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include "activation.hpp"
+#include "feature_extractor.hpp"
+
+std::vector<FeatureStage> FeatureExtractor::plan(const ImageShape &input, const std::vector<FeatureLayerSpec> &specs) {
+    std::vector<FeatureStage> stages;
+    ImageShape shape = input;
+    for (size_t i = 0; i < specs.size(); ++i) {
+        FeatureStage stage;
+        if (!convolution::make_stage(shape, specs[i], stage)) {
+            std::cerr << "Error: feature layer " << i << " does not fit its " << shape.channels << "x"
+                      << shape.height << "x" << shape.width << " input." << std::endl;
+            exit(1);
+        }
+        stages.push_back(stage);
+        shape = stage.output;
+    }
+    if (stages.empty()) {
+        std::cerr << "Error: an image network needs at least one feature layer." << std::endl;
+        exit(1);
+    }
+    return stages;
+}
+
+/**
+ * @brief Filters are Layers with one row per output channel and one column per tap, so their
+ * initialization scales with the fan-in of a tap window.
+ */
+FeatureExtractor::FeatureExtractor(const std::vector<FeatureStage> &stages, Activation activation)
+    : stages(stages), input(nullptr), first_convolution(stages.size())
+{
+    size_t column_size = 0;
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const FeatureStage &stage = stages[i];
+        outputs.emplace_back(stage.output.size(), 0.0);
+        deltas.emplace_back(stage.output.size(), 0.0);
+        if (stage.type == FeatureLayerType::CONVOLUTION) {
+            Layer *layer = new Layer(static_cast<int>(stage.taps()), stage.output.channels, activation);
+            filters.push_back(layer);
+            argmax.emplace_back();
+            weight_directions.emplace_back(layer->weights.size(), 0.0);
+            bias_directions.emplace_back(layer->biases.size(), 0.0);
+            column_size = std::max(column_size, convolution::column_size(stage));
+            first_convolution = std::min(first_convolution, i);
+        } else {
+            filters.push_back(nullptr);
+            argmax.emplace_back(stage.output.size(), 0);
+            weight_directions.emplace_back();
+            bias_directions.emplace_back();
+        }
+    }
+    columns.assign(column_size, 0.0);
+}
+
+FeatureExtractor::~FeatureExtractor() {
+    for (Layer *layer : filters) {
+        delete layer;
+    }
+}
+
+const real_t *FeatureExtractor::stage_input(size_t stage) const {
+    return stage == 0 ? input : outputs[stage - 1].data();
+}
+
+const real_t *FeatureExtractor::forward(const real_t *input) {
+    this->input = input;
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const FeatureStage &stage = stages[i];
+        if (stage.type == FeatureLayerType::CONVOLUTION) {
+            const Layer *layer = filters[i];
+            convolution::forward(stage, layer->weights.data(), static_cast<size_t>(layer->stride), layer->biases.data(),
+                                 layer->activation, stage_input(i), outputs[i].data(), columns.data());
+        } else {
+            convolution::max_pool(stage, stage_input(i), outputs[i].data(), argmax[i].data());
+        }
+    }
+    return outputs.back().data();
+}
+
+const real_t *FeatureExtractor::output() const {
+    return outputs.back().data();
+}
+
+real_t *FeatureExtractor::output_deltas() {
+    return deltas.back().data();
+}
+
+/**
+ * @brief Walks the stages backwards down to the first convolution; only stages above it
+ * pass deltas on to their inputs.
+ */
+void FeatureExtractor::backward() {
+    for (size_t i = stages.size(); i-- > first_convolution;) {
+        const FeatureStage &stage = stages[i];
+        real_t *input_deltas = i > first_convolution ? deltas[i - 1].data() : nullptr;
+        if (stage.type == FeatureLayerType::CONVOLUTION) {
+            const Layer *layer = filters[i];
+            activation::backward(layer->activation, outputs[i].data(), deltas[i].data(), stage.output.size());
+            convolution::backward(stage, layer->weights.data(), static_cast<size_t>(layer->stride), stage_input(i),
+                                  deltas[i].data(), columns.data(), weight_directions[i].data(),
+                                  bias_directions[i].data(), input_deltas);
+        } else if (input_deltas) {
+            convolution::max_pool_backward(stage, deltas[i].data(), argmax[i].data(), input_deltas);
+        }
+    }
+}
+
+void FeatureExtractor::update(Optimizer &optimizer, size_t first_layer, const Optimizer::Step &step) {
+    size_t l = first_layer;
+    for (size_t i = 0; i < stages.size(); ++i) {
+        Layer *layer = filters[i];
+        if (!layer) {
+            continue;
+        }
+        optimizer.apply(Optimizer::slot(l, false), 0, layer->weights.size(), 1.0, weight_directions[i].data(),
+                        layer->weights.data(), step);
+        optimizer.apply(Optimizer::slot(l, true), 0, layer->biases.size(), 1.0, bias_directions[i].data(),
+                        layer->biases.data(), step);
+        ++l;
+    }
+}
+
+const std::vector<FeatureStage> &FeatureExtractor::get_stages() const {
+    return stages;
+}
+
+Layer *FeatureExtractor::get_filters(size_t stage) const {
+    return filters[stage];
+}
+
+std::vector<Layer *> FeatureExtractor::get_layers() const {
+    std::vector<Layer *> layers;
+    for (Layer *layer : filters) {
+        if (layer) {
+            layers.push_back(layer);
+        }
+    }
+    return layers;
+}
+
+size_t FeatureExtractor::input_size() const {
+    return stages.front().input.size();
+}
+
+size_t FeatureExtractor::output_size() const {
+    return stages.back().output.size();
+}
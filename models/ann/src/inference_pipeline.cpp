@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "activation.hpp"
+#include "inference_pipeline.hpp"
+#include "linalg.hpp"
+
+namespace {
+
+/**
+ * @brief Idle strategy of a polling thread: spin first, then yield the core, then sleep.
+ */
+class Backoff {
+private:
+    unsigned rounds = 0;
+
+public:
+    void pause() {
+        if (++rounds < 64) {
+            return;
+        }
+        if (rounds < 1024) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    void reset() {
+        rounds = 0;
+    }
+};
+
+/**
+ * @brief Multiply-adds of one step (a pooling stage counts one per input value).
+ */
+double step_cost(const CompiledModel &model, size_t step) {
+    if (step < model.num_stages()) {
+        const FeatureStage &stage = model.stage(step).stage;
+        if (stage.type == FeatureLayerType::CONVOLUTION) {
+            return static_cast<double>(stage.output.size()) * static_cast<double>(stage.taps());
+        }
+        return static_cast<double>(stage.input.size());
+    }
+    const CompiledModel::LayerView &view = model.layer(step - model.num_stages());
+    return static_cast<double>(view.layer_size) * (view.input_size + 1);
+}
+
+/**
+ * @brief Cuts the steps into contiguous segments that minimize the most expensive one
+ * (dynamic programming over the prefix sums of the step costs).
+ * @return num_segments + 1 boundaries from 0 to the number of steps.
+ */
+std::vector<size_t> balance(const CompiledModel &model, size_t num_steps, size_t num_segments) {
+    std::vector<double> prefix(num_steps + 1, 0.0);
+    for (size_t i = 0; i < num_steps; ++i) {
+        prefix[i + 1] = prefix[i] + step_cost(model, i);
+    }
+
+    // bottleneck[g][n]: best largest segment cost when the first n steps form g segments
+    const double none = std::numeric_limits<double>::infinity();
+    std::vector<std::vector<double>> bottleneck(num_segments + 1, std::vector<double>(num_steps + 1, none));
+    std::vector<std::vector<size_t>> cut(num_segments + 1, std::vector<size_t>(num_steps + 1, 0));
+    bottleneck[0][0] = 0.0;
+    for (size_t g = 1; g <= num_segments; ++g) {
+        for (size_t n = g; n <= num_steps; ++n) {
+            for (size_t k = g - 1; k < n; ++k) {
+                double cost = std::max(bottleneck[g - 1][k], prefix[n] - prefix[k]);
+                if (cost < bottleneck[g][n]) {
+                    bottleneck[g][n] = cost;
+                    cut[g][n] = k;
+                }
+            }
+        }
+    }
+
+    std::vector<size_t> boundaries(num_segments + 1, 0);
+    boundaries[num_segments] = num_steps;
+    for (size_t g = num_segments; g > 1; --g) {
+        boundaries[g - 1] = cut[g][boundaries[g]];
+    }
+    return boundaries;
+}
+
+} // namespace
+
+/**
+ * @brief Every queue can hold all slots, so a worker's push never fails and only the
+ * free-slot queue limits how much is in flight.
+ */
+InferencePipeline::InferencePipeline(std::shared_ptr<const CompiledModel> model, size_t num_segments, size_t depth,
+                                     bool pin)
+    : model(std::move(model)), free_slots(std::max<size_t>(1, depth)), running(true)
+{
+    const CompiledModel &compiled = *this->model;
+    size_t num_steps = compiled.num_stages() + compiled.num_layers();
+    num_segments = std::min(std::max<size_t>(1, num_segments), num_steps);
+    depth = std::max<size_t>(1, depth);
+    boundaries = balance(compiled, num_steps, num_segments);
+
+    size_t width = static_cast<size_t>(std::max(compiled.input_size(), compiled.get_max_width()));
+    for (size_t i = 0; i < compiled.num_stages(); ++i) {
+        width = std::max(width, compiled.stage(i).stage.output.size());
+    }
+    for (size_t i = 0; i < depth; ++i) {
+        Slot *slot = new Slot();
+        slot->tag = 0;
+        slot->label = -1;
+        for (AlignedVector<real_t> &activations : slot->activations) {
+            activations.assign(width, 0.0);
+        }
+        slots.push_back(slot);
+        free_slots.try_push(slot);
+    }
+    for (size_t s = 0; s <= num_segments; ++s) {
+        queues.push_back(new SpscQueue<Slot *>(depth));
+    }
+
+    unsigned num_cpus = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t s = 0; s < num_segments; ++s) {
+        workers.emplace_back(&InferencePipeline::work, this, s);
+#ifdef __linux__
+        if (pin) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(s % num_cpus, &cpus);
+            pthread_setaffinity_np(workers.back().native_handle(), sizeof(cpus), &cpus);
+        }
+#else
+        (void)pin;
+        (void)num_cpus;
+#endif
+    }
+}
+
+InferencePipeline::~InferencePipeline() {
+    running.store(false, std::memory_order_relaxed);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    for (SpscQueue<Slot *> *queue : queues) {
+        delete queue;
+    }
+    for (Slot *slot : slots) {
+        delete slot;
+    }
+}
+
+void InferencePipeline::run_step(size_t step, Slot *slot, real_t *columns) const {
+    const real_t *inputs = slot->activations[step % 2].data();
+    real_t *outputs = slot->activations[(step + 1) % 2].data();
+    if (step < model->num_stages()) {
+        const CompiledModel::StageView &view = model->stage(step);
+        if (view.stage.type == FeatureLayerType::CONVOLUTION) {
+            convolution::forward(view.stage, model->stage_weights(step), static_cast<size_t>(view.stride),
+                                 model->stage_biases(step), view.activation, inputs, outputs, columns);
+        } else {
+            convolution::max_pool(view.stage, inputs, outputs, nullptr);
+        }
+        return;
+    }
+    size_t l = step - model->num_stages();
+    const CompiledModel::LayerView &view = model->layer(l);
+    size_t width = static_cast<size_t>(view.layer_size);
+    linalg::gemv(width, view.input_size, 1.0, model->weights(l), view.stride, inputs, 0.0, outputs);
+    activation::forward(view.activation, outputs, 1, width, model->biases(l));
+}
+
+/**
+ * @brief The convolution scratch is allocated on the worker itself, so it lands next to the
+ * core the worker is pinned to.
+ */
+void InferencePipeline::work(size_t segment) {
+    size_t first = boundaries[segment], last = boundaries[segment + 1];
+    size_t column_size = 0;
+    for (size_t step = first; step < std::min(last, model->num_stages()); ++step) {
+        const FeatureStage &stage = model->stage(step).stage;
+        if (stage.type == FeatureLayerType::CONVOLUTION) {
+            column_size = std::max(column_size, convolution::column_size(stage));
+        }
+    }
+    AlignedVector<real_t> columns(column_size, 0.0);
+
+    bool is_last = segment + 1 == num_segments();
+    size_t num_outputs = static_cast<size_t>(model->output_size());
+    SpscQueue<Slot *> &input = *queues[segment];
+    SpscQueue<Slot *> &output = *queues[segment + 1];
+    Backoff backoff;
+    Slot *slot;
+    while (running.load(std::memory_order_relaxed)) {
+        if (!input.try_pop(slot)) {
+            backoff.pause();
+            continue;
+        }
+        backoff.reset();
+        for (size_t step = first; step < last; ++step) {
+            run_step(step, slot, columns.data());
+        }
+        if (is_last) {
+            const real_t *outputs = slot->activations[last % 2].data();
+            slot->label = static_cast<int>(std::max_element(outputs, outputs + num_outputs) - outputs);
+        }
+        output.try_push(slot);
+    }
+}
+
+bool InferencePipeline::submit(const real_t *features, uint64_t tag) {
+    Slot *slot;
+    if (!free_slots.try_pop(slot)) {
+        return false;
+    }
+    std::memcpy(slot->activations[0].data(), features, static_cast<size_t>(model->input_size()) * sizeof(real_t));
+    slot->tag = tag;
+    queues.front()->try_push(slot);
+    return true;
+}
+
+bool InferencePipeline::poll(uint64_t &tag, int &label) {
+    Slot *slot;
+    if (!queues.back()->try_pop(slot)) {
+        return false;
+    }
+    tag = slot->tag;
+    label = slot->label;
+    free_slots.try_push(slot);
+    return true;
+}
+
+/**
+ * @brief Tags are sample indices, so the pipeline must not hold other requests.
+ */
+void InferencePipeline::predict_stream(const real_t *features, size_t count, size_t stride, int *labels) {
+    size_t submitted = 0, finished = 0;
+    Backoff backoff;
+    while (finished < count) {
+        bool progress = false;
+        while (submitted < count && submit(features + submitted * stride, submitted)) {
+            ++submitted;
+            progress = true;
+        }
+        uint64_t tag;
+        int label;
+        while (poll(tag, label)) {
+            labels[tag] = label;
+            ++finished;
+            progress = true;
+        }
+        if (progress) {
+            backoff.reset();
+        } else {
+            backoff.pause();
+        }
+    }
+}
+
+size_t InferencePipeline::num_segments() const {
+    return boundaries.size() - 1;
+}
+
+void InferencePipeline::get_segment(size_t segment, size_t &first, size_t &last) const {
+    first = boundaries[segment];
+    last = boundaries[segment + 1];
+}
+
+const CompiledModel &InferencePipeline::get_model() const {
+    return *model;
+}
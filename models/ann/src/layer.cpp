@@ -1,15 +1,128 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
 #include "layer.hpp"
 
 /**
- * @brief Constructs a Layer with neurons initialized based on previous layer size.
+ * @brief Number of real_t values in a 64-byte cache line; weight rows are padded to a multiple of it.
+ */
+static const int ROW_ALIGNMENT = 64 / sizeof(real_t);
+
+/**
+ * @brief Constructs a Layer with a contiguous weight matrix sized from the previous layer.
  * @param prev_layer_size Number of neurons in the previous layer.
  * @param current_layer_size Number of neurons in the current layer.
+ * @param activation Activation function of the layer.
+ */
+Layer::Layer(int prev_layer_size, int current_layer_size, Activation activation)
+    : input_size(prev_layer_size),
+      layer_size(current_layer_size),
+      stride((prev_layer_size + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT),
+      weights(static_cast<size_t>(current_layer_size) * stride, 0.0),
+      biases(current_layer_size, 0.0),
+      activation(activation)
+{
+    initialize_weights();
+}
+
+real_t *Layer::row(int neuron) {
+    return weights.data() + static_cast<size_t>(neuron) * stride;
+}
+
+const real_t *Layer::row(int neuron) const {
+    return weights.data() + static_cast<size_t>(neuron) * stride;
+}
+
+/**
+ * @brief Initializes weights uniformly in [-limit, limit] for the layer's activation.
+ * Padding columns are left at zero, and any pruning mask is dropped.
  */
-Layer::Layer(int prev_layer_size, int current_layer_size)
-    : layer_size(current_layer_size)
+void Layer::initialize_weights()
 {
-    neurons.reserve(current_layer_size);
-    for (int i = 0; i < current_layer_size; ++i) {
-        neurons.push_back(new Neuron(prev_layer_size));
+    static std::random_device rd;  // only seeded once
+    static std::mt19937 gen(rd());
+
+    double limit = 1.0;
+    bool random_biases = false;
+    switch (activation) {
+    case Activation::SIGMOID:
+        random_biases = true;
+        break;
+    case Activation::RELU:
+    case Activation::LEAKY_RELU:
+        limit = std::sqrt(6.0 / input_size);
+        break;
+    case Activation::TANH:
+    case Activation::SOFTMAX:
+        limit = std::sqrt(6.0 / (input_size + layer_size));
+        break;
+    }
+    std::uniform_real_distribution<real_t> dist(-limit, limit);
+    mask.clear();
+
+    for (int j = 0; j < layer_size; ++j) {
+        real_t *weight_row = row(j);
+        for (int i = 0; i < input_size; ++i) {
+            weight_row[i] = dist(gen);
+        }
+        biases[j] = random_biases ? dist(gen) : real_t(0);
+    }
+}
+
+/**
+ * @brief Ranks the tiles by the energy of their unpruned weights (pruned tiles score zero and
+ * come first) and zeroes whole tiles, lowest first, until enough weights are pruned.
+ */
+void Layer::prune(double sparsity, size_t block_rows, size_t block_cols) {
+    size_t rows = static_cast<size_t>(layer_size);
+    size_t cols = static_cast<size_t>(input_size);
+    if (mask.empty()) {
+        mask.assign(weights.size(), 0.0);
+        for (size_t j = 0; j < rows; ++j) {
+            std::fill(mask.begin() + j * stride, mask.begin() + j * stride + cols, real_t(1));
+        }
+    }
+
+    size_t grid_cols = (cols + block_cols - 1) / block_cols;
+    size_t num_blocks = (rows + block_rows - 1) / block_rows * grid_cols;
+    std::vector<std::pair<double, size_t>> scores(num_blocks);
+    for (size_t b = 0; b < num_blocks; ++b) {
+        size_t row_begin = b / grid_cols * block_rows, col_begin = b % grid_cols * block_cols;
+        double energy = 0.0;
+        for (size_t j = row_begin; j < std::min(rows, row_begin + block_rows); ++j) {
+            for (size_t i = col_begin; i < std::min(cols, col_begin + block_cols); ++i) {
+                double weight = weights[j * stride + i] * mask[j * stride + i];
+                energy += weight * weight;
+            }
+        }
+        scores[b] = std::make_pair(energy, b);
+    }
+    std::sort(scores.begin(), scores.end());
+
+    size_t target = static_cast<size_t>(std::llround(std::min(1.0, std::max(0.0, sparsity)) * rows * cols));
+    size_t pruned = 0;
+    for (size_t k = 0; k < num_blocks && pruned < target; ++k) {
+        size_t b = scores[k].second;
+        size_t row_begin = b / grid_cols * block_rows, col_begin = b % grid_cols * block_cols;
+        for (size_t j = row_begin; j < std::min(rows, row_begin + block_rows); ++j) {
+            for (size_t i = col_begin; i < std::min(cols, col_begin + block_cols); ++i) {
+                weights[j * stride + i] = 0.0;
+                mask[j * stride + i] = 0.0;
+                ++pruned;
+            }
+        }
+    }
+}
+
+double Layer::sparsity() const {
+    if (mask.empty()) {
+        return 0.0;
+    }
+    size_t pruned = 0;
+    for (int j = 0; j < layer_size; ++j) {
+        const real_t *mask_row = mask.data() + static_cast<size_t>(j) * stride;
+        pruned += static_cast<size_t>(std::count(mask_row, mask_row + input_size, real_t(0)));
     }
-}
\ No newline at end of file
+    return static_cast<double>(pruned) / (static_cast<double>(layer_size) * input_size);
+}
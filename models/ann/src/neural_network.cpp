@@ -1,9 +1,16 @@
 #include <numeric>
 #include <cstdio>
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include "activation.hpp"
 #include "data_handler.hpp"
+#include "instrumentation.hpp"
 #include "layer.hpp"
+#include "linalg.hpp"
 #include "neural_network.hpp"
 
 /**
@@ -12,230 +19,759 @@
  * @param input_size Number of input features.
  * @param num_classes Number of output classes.
  * @param learning_rate Learning rate for weight updates.
+ * @param hidden_activation Activation function of every hidden layer.
+ * @param output_activation Activation function of the output layer.
  */
-NeuralNetwork::NeuralNetwork(std::vector<int> spec, int input_size, int num_classes, double learning_rate)
-    : learning_rate(learning_rate), test_performance(0.0)
+NeuralNetwork::NeuralNetwork(std::vector<int> spec, int input_size, int num_classes, double learning_rate,
+                             Activation hidden_activation, Activation output_activation)
+    : batch_size(1), num_threads(1), parallel_mode(ParallelMode::DATA_PARALLEL), epochs_trained(0), patience(0),
+      min_delta(0.0), target_accuracy(0.0), verbose(true), sparse_inputs(false), sparse_source(nullptr),
+      features(nullptr), online(false), unpublished_updates(0), learning_rate(learning_rate), test_performance(0.0)
 {
+    if (!activation::is_valid(hidden_activation, false) || !activation::is_valid(output_activation, true)) {
+        std::cerr << "Error: SOFTMAX can only be used on the output layer." << std::endl;
+        exit(1);
+    }
+
     for (size_t i = 0; i < spec.size(); ++i) {
         if (i == 0) {
             // First hidden layer connected to input layer
-            layers.push_back(new Layer(input_size, spec.at(i)));
+            layers.push_back(new Layer(input_size, spec.at(i), hidden_activation));
         } else {
             // Subsequent hidden layers connected to previous hidden layer
-            layers.push_back(new Layer(static_cast<int>(layers.at(i - 1)->neurons.size()), spec.at(i)));
+            layers.push_back(new Layer(static_cast<int>(layers.at(i - 1)->layer_size), spec.at(i), hidden_activation));
         }
     }
     // Output layer connected to last hidden layer
-    layers.push_back(new Layer(static_cast<int>(layers.back()->neurons.size()), num_classes));
+    int last_size = layers.empty() ? input_size : layers.back()->layer_size;
+    layers.push_back(new Layer(last_size, num_classes, output_activation));
+
+    // Every per-sample buffer is allocated here, once
+    workspace.configure(layers, 1);
 }
 
 /**
- * @brief Destructor that releases dynamically allocated neurons and layers.
+ * @brief Builds the fully connected part on the flattened output of the feature layers, then
+ * the feature layers themselves.
+ * @param input_shape Shape of the input image.
+ * @param feature_layers Convolution and pooling layers.
+ * @param spec Vector containing number of neurons in each hidden layer.
+ * @param num_classes Number of output classes.
+ * @param learning_rate Learning rate for weight updates.
+ * @param hidden_activation Activation function of every convolution and hidden layer.
+ * @param output_activation Activation function of the output layer.
+ */
+NeuralNetwork::NeuralNetwork(const ImageShape &input_shape, const std::vector<FeatureLayerSpec> &feature_layers,
+                             std::vector<int> spec, int num_classes, double learning_rate,
+                             Activation hidden_activation, Activation output_activation)
+    : NeuralNetwork(spec, static_cast<int>(FeatureExtractor::plan(input_shape, feature_layers).back().output.size()),
+                    num_classes, learning_rate, hidden_activation, output_activation)
+{
+    features = new FeatureExtractor(FeatureExtractor::plan(input_shape, feature_layers), hidden_activation);
+}
+
+/**
+ * @brief Destructor that releases dynamically allocated layers.
  */
 NeuralNetwork::~NeuralNetwork() {
     for (Layer* layer : layers) {
-        for (Neuron* neuron : layer->neurons) {
-            delete neuron;
-        }
         delete layer;
     }
     layers.clear();
+    delete features;
 }
 
 /**
- * @brief Computes the activation for a neuron as weighted sum + bias.
- * @param weights Weights vector including bias as last element.
- * @param inputs Input feature vector.
- * @return Activation value.
+ * @brief Forward propagation through all layers: outputs = f(W * inputs + b).
+ * @param data_point Input data point.
+ * @return Pointer to the final layer's outputs in the workspace.
  */
-double NeuralNetwork::activate(const std::vector<double> &weights, const std::vector<double> &inputs) {
-    double activation = weights.back(); // Bias term
-    for (size_t i = 0; i < weights.size() - 1; ++i) {
-        activation += weights[i] * inputs[i];
+const real_t *NeuralNetwork::fprop(DataPoint *data_point) {
+    RTML_TIMER("ann.fprop");
+    // Start with input features, passed through the feature layers if there are any
+    const real_t *inputs = data_point->get_normalized_feature_vector()->data();
+    if (features) {
+        inputs = features->forward(inputs);
     }
-    return activation;
+    return fprop_layers(0, inputs);
 }
 
 /**
- * @brief Sigmoid activation function.
- * @param activation Raw activation input.
- * @return Output after sigmoid.
+ * @brief Propagates through the layers from `first` on.
+ * @param first First layer to run.
+ * @param inputs Inputs of that layer.
+ * @return Pointer to the final layer's outputs in the workspace.
  */
-double NeuralNetwork::transfer(double activation) {
-    return 1.0 / (1.0 + std::exp(-activation));
+const real_t *NeuralNetwork::fprop_layers(size_t first, const real_t *inputs) {
+    // Propagate through each layer
+    for (size_t l = first; l < layers.size(); ++l) {
+        const Layer* layer = layers[l];
+        real_t *outputs = workspace.activation(l);
+        RTML_COUNT("ann.bytes_scanned", static_cast<size_t>(layer->layer_size) * layer->stride * sizeof(real_t));
+        linalg::gemv(layer->layer_size, layer->input_size, 1.0, layer->weights.data(), layer->stride,
+                     inputs, 0.0, outputs);
+        activation::forward(layer->activation, outputs, 1, layer->layer_size, layer->biases.data());
+
+        inputs = outputs;  // outputs become inputs for next layer
+    }
+
+    return workspace.output();  // final output layer's outputs
 }
 
 /**
- * @brief Derivative of sigmoid function used in backpropagation.
- * @param output Output from sigmoid function.
- * @return Derivative value.
+ * @brief Backward propagation of error and calculation of delta values.
+ * @param data_point Training data point.
+ * @return Loss of the point.
  */
-double NeuralNetwork::transfer_derivative(double output) {
-    return output * (1.0 - output);
+double NeuralNetwork::bprop(DataPoint *data_point) {
+    RTML_TIMER("ann.bprop");
+    // Output layer: deltas against the one-hot target (1 at the raw label), fused with the loss
+    size_t last = layers.size() - 1;
+    double loss = activation::output_deltas(layers[last]->activation, workspace.activation(last),
+                                            data_point->get_label(), workspace.delta(last),
+                                            static_cast<size_t>(layers[last]->layer_size));
+
+    // Hidden layers: error is W_next^T * delta_next, then scaled by the activation derivative
+    for (size_t l = last; l-- > 0;) {
+        const Layer* next_layer = layers[l + 1];
+        real_t *deltas = workspace.delta(l);
+        linalg::gemv_t(next_layer->layer_size, next_layer->input_size, 1.0, next_layer->weights.data(),
+                       next_layer->stride, workspace.delta(l + 1), 0.0, deltas);
+        activation::backward(layers[l]->activation, workspace.activation(l), deltas, layers[l]->layer_size);
+    }
+
+    // Feature layers: error of their flattened output is W_0^T * delta_0
+    if (features) {
+        const Layer *first_layer = layers.front();
+        linalg::gemv_t(first_layer->layer_size, first_layer->input_size, 1.0, first_layer->weights.data(),
+                       first_layer->stride, workspace.delta(0), 0.0, features->output_deltas());
+        features->backward();
+    }
+    return loss;
 }
 
 /**
- * @brief Forward propagation through all layers.
- * @param data_point Input data point.
- * @return Output vector from final layer.
+ * @brief Applies one optimizer step with direction delta * inputs^T to the weights and delta to
+ * the biases. Each weight row is one fused update scaled by its delta, so the outer product is
+ * never materialized.
+ * @param data_point Training data point.
+ */
+void NeuralNetwork::update_weights(DataPoint *data_point) {
+    RTML_TIMER("ann.update");
+    Optimizer::Step step = optimizer.begin_step();
+    if (features) {
+        // Inputs to the first layer: output of the feature layers; their filters take slots after the layers
+        update_layers(0, features->output(), step);
+        features->update(optimizer, layers.size(), step);
+        return;
+    }
+    // Inputs to the first layer: normalized feature vector
+    update_layers(0, data_point->get_normalized_feature_vector()->data(), step);
+}
+
+/**
+ * @brief Updates the layers from `first` on with one optimizer step.
+ * @param first First layer to update.
+ * @param inputs Inputs of that layer.
+ * @param step Current optimizer step.
  */
-std::vector<double> NeuralNetwork::fprop(DataPoint *data_point) {
-    // Start with input features
-    std::vector<double> inputs = *data_point->get_normalized_feature_vector();
+void NeuralNetwork::update_layers(size_t first, const real_t *inputs, const Optimizer::Step &step) {
+    for (size_t l = first; l < layers.size(); ++l) {
+        Layer* layer = layers[l];
+        const real_t *deltas = workspace.delta(l);
+        for (int j = 0; j < layer->layer_size; ++j) {
+            size_t row = static_cast<size_t>(j) * layer->stride;
+            optimizer.apply(Optimizer::slot(l, false), row, layer->input_size, deltas[j], inputs,
+                            layer->weights.data() + row, step);
+        }
+        optimizer.apply(Optimizer::slot(l, true), 0, layer->layer_size, 1.0, deltas, layer->biases.data(), step);
 
-    // Propagate through each layer
-    for (Layer* layer : layers) {
-        std::vector<double> new_inputs;
+        // Prepare inputs for the next layer: current layer's outputs
+        inputs = workspace.activation(l);
+    }
+}
 
-        // Compute output of each neuron in the layer
-        for (Neuron* neuron : layer->neurons) {
-            double activation = activate(neuron->weights, inputs);
-            neuron->output = transfer(activation);
-            new_inputs.push_back(neuron->output);
+/**
+ * @brief Transposes the first layer's row-major weights into input_weights, or back.
+ * @param to_input_major Direction of the copy.
+ */
+void NeuralNetwork::transpose_input_weights(bool to_input_major) {
+    Layer *layer = layers.front();
+    size_t width = static_cast<size_t>(layer->layer_size);
+    input_weights.resize(static_cast<size_t>(layer->input_size) * width);
+    for (size_t j = 0; j < width; ++j) {
+        real_t *row = layer->row(static_cast<int>(j));
+        for (int i = 0; i < layer->input_size; ++i) {
+            if (to_input_major) {
+                input_weights[i * width + j] = row[i];
+            } else {
+                row[i] = input_weights[i * width + j];
+            }
         }
+    }
+}
+
+/**
+ * @brief First layer: outputs = f(sum over non-zero features i of x_i * input_weights[i] + b).
+ * @param row Training sample index.
+ */
+void NeuralNetwork::fprop_sparse(size_t row) {
+    RTML_TIMER("ann.fprop");
+    const Layer *layer = layers.front();
+    size_t width = static_cast<size_t>(layer->layer_size);
+    real_t *outputs = workspace.activation(0);
+    linalg::sparse_gemv_t(width, 1.0, input_weights.data(), width, sparse_training_set.row_nonzeros(row),
+                          sparse_training_set.row_indices(row), sparse_training_set.row_values(row), 0.0, outputs);
+    activation::forward(layer->activation, outputs, 1, width, layer->biases.data());
+    fprop_layers(1, outputs);
+}
+
+/**
+ * @brief The SGD update of a weight is learning_rate * delta * input, so only the weights of
+ * non-zero features change; those are whole rows of input_weights.
+ * @param row Training sample index.
+ */
+void NeuralNetwork::update_weights_sparse(size_t row) {
+    RTML_TIMER("ann.update");
+    Optimizer::Step step = optimizer.begin_step();
+    Layer *layer = layers.front();
+    size_t width = static_cast<size_t>(layer->layer_size);
+    linalg::sparse_ger(width, step.learning_rate, sparse_training_set.row_nonzeros(row),
+                       sparse_training_set.row_indices(row), sparse_training_set.row_values(row),
+                       workspace.delta(0), input_weights.data(), width);
+    optimizer.apply(Optimizer::slot(0, true), 0, width, 1.0, workspace.delta(0), layer->biases.data(), step);
+    update_layers(1, workspace.activation(0), step);
+}
+
+/**
+ * @brief Predicts label for input data by selecting neuron with max output.
+ * @param data_point Input data point.
+ * @return Index of predicted class.
+ */
+int NeuralNetwork::predict(DataPoint *data_point) {
+    RTML_TIMER("ann.predict");
+    const real_t *outputs = fprop(data_point);
+    return static_cast<int>(std::max_element(outputs, outputs + layers.back()->layer_size) - outputs);
+}
 
-        inputs = std::move(new_inputs);  // outputs become inputs for next layer
+/**
+ * @brief Switches one layer's activation and redraws its weights with the matching scale.
+ * @param layer Layer index.
+ * @param activation Activation function.
+ */
+void NeuralNetwork::set_activation(size_t layer, Activation activation) {
+    if (layer >= layers.size() || !activation::is_valid(activation, layer + 1 == layers.size())) {
+        std::cerr << "Error: invalid activation for layer " << layer << "." << std::endl;
+        exit(1);
     }
+    layers[layer]->activation = activation;
+    layers[layer]->initialize_weights();
+}
 
-    return inputs;  // final output layer's outputs
+/**
+ * @brief Sets the number of samples per weight update.
+ * @param batch_size Mini-batch size (values below 1 are treated as 1).
+ */
+void NeuralNetwork::set_batch_size(int batch_size) {
+    this->batch_size = std::max(1, batch_size);
 }
 
 /**
- * @brief Backward propagation of error and calculation of delta values.
- * @param data Training data point.
- */
-void NeuralNetwork::bprop(DataPoint *data_point) {
-    for (int i = static_cast<int>(layers.size()) - 1; i >= 0; --i) {
-        Layer* layer = layers.at(i);
-        std::vector<double> errors;
-
-        if (i != static_cast<int>(layers.size()) - 1) {
-            // Hidden layers: error is weighted sum of next layer deltas
-            for (size_t j = 0; j < layer->neurons.size(); ++j) {
-                double error = 0.0;
-                Layer* next_layer = layers.at(i + 1);
-                for (Neuron* neuron : next_layer->neurons) {
-                    error += neuron->weights[j] * neuron->delta;
-                }
-                errors.push_back(error);
-            }
-        } else {
-            // Output layer: error is difference between expected and actual output
-            for (size_t j = 0; j < layer->neurons.size(); ++j) {
-                Neuron* neuron = layer->neurons.at(j);
-                errors.push_back(static_cast<double>(data_point->get_class_vector().at(j)) - neuron->output);
-            }
+ * @brief Returns the number of samples per weight update.
+ * @return Mini-batch size.
+ */
+int NeuralNetwork::get_batch_size() const {
+    return batch_size;
+}
+
+/**
+ * @brief Sets the number of training threads.
+ * @param num_threads Worker threads (0 = hardware concurrency).
+ */
+void NeuralNetwork::set_num_threads(unsigned num_threads) {
+    this->num_threads = num_threads;
+}
+
+/**
+ * @brief Selects data-parallel or Hogwild multithreaded training.
+ * @param mode Weight sharing strategy.
+ */
+void NeuralNetwork::set_parallel_mode(ParallelMode mode) {
+    parallel_mode = mode;
+}
+
+/**
+ * @brief Enables or disables the sparse first-layer path of per-sample training.
+ * @param enabled Whether to skip zero input features.
+ */
+void NeuralNetwork::set_sparse_inputs(bool enabled) {
+    sparse_inputs = enabled;
+}
+
+/**
+ * @brief Replaces the optimizer configuration and resets its state.
+ * @param config Optimizer hyperparameters.
+ */
+void NeuralNetwork::set_optimizer(const OptimizerConfig &config) {
+    optimizer.set_config(config);
+}
+
+/**
+ * @brief Enables or disables early stopping on validation accuracy.
+ * @param patience Epochs without improvement before stopping (0 = disabled).
+ * @param min_delta Minimum accuracy gain that counts as an improvement.
+ */
+void NeuralNetwork::set_early_stopping(int patience, double min_delta) {
+    this->patience = std::max(0, patience);
+    this->min_delta = min_delta;
+}
+
+/**
+ * @brief Sets the validation accuracy at which training stops.
+ * @param accuracy Target accuracy (0 = disabled).
+ */
+void NeuralNetwork::set_target_accuracy(double accuracy) {
+    target_accuracy = accuracy;
+}
+
+/**
+ * @brief Sets the file receiving the best weights during training.
+ * @param path Model file path (empty = disabled).
+ */
+void NeuralNetwork::set_checkpoint_path(const std::string &path) {
+    checkpoint_path = path;
+}
+
+void NeuralNetwork::set_verbose(bool verbose) {
+    this->verbose = verbose;
+}
+
+/**
+ * @brief Copies the current weights into a read-only CompiledModel.
+ * @return Shared immutable model.
+ */
+std::shared_ptr<const CompiledModel> NeuralNetwork::compile() const {
+    return std::make_shared<const CompiledModel>(layers, features);
+}
+
+std::vector<Layer *> NeuralNetwork::parameter_layers() const {
+    std::vector<Layer *> parameters = layers;
+    if (features) {
+        std::vector<Layer *> filters = features->get_layers();
+        parameters.insert(parameters.end(), filters.begin(), filters.end());
+    }
+    return parameters;
+}
+
+bool NeuralNetwork::save(const std::string &path) const {
+    return compile()->save(path);
+}
+
+/**
+ * @brief Copies the weights out of the mapped file, since training may modify them later.
+ */
+bool NeuralNetwork::load(const std::string &path) {
+    std::shared_ptr<const CompiledModel> model = CompiledModel::load(path);
+    if (!model) {
+        return false;
+    }
+    if (model->num_layers() != layers.size()) {
+        std::cerr << "Model file '" << path << "' has a different number of layers." << std::endl;
+        return false;
+    }
+    size_t num_stages = features ? features->get_stages().size() : 0;
+    bool same_stages = model->num_stages() == num_stages;
+    for (size_t i = 0; same_stages && i < num_stages; ++i) {
+        const FeatureStage &stage = features->get_stages()[i];
+        const CompiledModel::StageView &view = model->stage(i);
+        const Layer *filters = features->get_filters(i);
+        same_stages = view.stage.type == stage.type && view.stage.input.channels == stage.input.channels
+                      && view.stage.input.height == stage.input.height && view.stage.input.width == stage.input.width
+                      && view.stage.output.channels == stage.output.channels
+                      && view.stage.kernel_size == stage.kernel_size && view.stage.padding == stage.padding
+                      && (!filters || (view.stride == filters->stride && view.activation == filters->activation));
+    }
+    if (!same_stages) {
+        std::cerr << "Model file '" << path << "' has different feature layers." << std::endl;
+        return false;
+    }
+    for (size_t l = 0; l < layers.size(); ++l) {
+        const CompiledModel::LayerView &view = model->layer(l);
+        if (view.input_size != layers[l]->input_size || view.layer_size != layers[l]->layer_size
+            || view.stride != layers[l]->stride) {
+            std::cerr << "Model file '" << path << "' has different layer sizes." << std::endl;
+            return false;
+        }
+        if (view.activation != layers[l]->activation) {
+            std::cerr << "Model file '" << path << "' uses " << activation::name(view.activation)
+                      << " instead of " << activation::name(layers[l]->activation) << " in layer " << l << "." << std::endl;
+            return false;
         }
+    }
+    restore(*model);
+    for (Layer *layer : layers) {
+        layer->mask.clear();  // the file's weights need not follow an earlier pruning
+    }
+    return true;
+}
 
-        // Calculate delta = error * derivative of activation function
-        for (size_t j = 0; j < layer->neurons.size(); ++j) {
-            Neuron* neuron = layer->neurons.at(j);
-            neuron->delta = errors[j] * transfer_derivative(neuron->output);
+void NeuralNetwork::restore(const CompiledModel &model) {
+    for (size_t l = 0; l < layers.size(); ++l) {
+        Layer *layer = layers[l];
+        std::copy(model.weights(l), model.weights(l) + layer->weights.size(), layer->weights.begin());
+        std::copy(model.biases(l), model.biases(l) + layer->biases.size(), layer->biases.begin());
+    }
+    for (size_t i = 0; i < model.num_stages(); ++i) {
+        Layer *filters = features->get_filters(i);
+        if (filters) {
+            std::copy(model.stage_weights(i), model.stage_weights(i) + filters->weights.size(), filters->weights.begin());
+            std::copy(model.stage_biases(i), model.stage_biases(i) + filters->biases.size(), filters->biases.begin());
         }
     }
 }
 
 /**
- * @brief Updates weights based on delta values and learning rate.
- * @param data_point Training data point.
+ * @brief Quantizes a snapshot of the current weights, calibrated on the validation set.
+ * @param feature_mins Per-feature minimums used for normalization.
+ * @param feature_maxs Per-feature maximums used for normalization.
+ * @param granularity Per-layer or per-channel weight scales.
+ * @return Shared immutable int8 model.
  */
-void NeuralNetwork::update_weights(DataPoint *data_point) {
-    // Inputs to the first layer: normalized feature vector
-    std::vector<double> inputs = *data_point->get_normalized_feature_vector();
+std::shared_ptr<const QuantizedModel> NeuralNetwork::quantize(const std::vector<double> &feature_mins,
+                                                              const std::vector<double> &feature_maxs,
+                                                              QuantizationGranularity granularity) const {
+    if (features) {
+        std::cerr << "Quantization does not support feature layers." << std::endl;
+        return nullptr;
+    }
+    return std::make_shared<const QuantizedModel>(*compile(), feature_mins, feature_maxs, *validation_set, granularity);
+}
+
+/**
+ * @brief Prunes in rounds: sparsity_r = target * (1 - (1 - r / rounds)^3) removes most weights
+ * early, while the network still has capacity to recover, and little near the target.
+ * Weights and masks of the last accepted round are kept for rollback. Optimizer state is
+ * cleared after every round, as it was accumulated for weights that are now zero.
+ * @param config Pruning schedule.
+ * @return Pruned fraction of the pruned layers.
+ */
+double NeuralNetwork::prune(const PruningConfig &config) {
+    std::vector<Layer *> pruned_layers;
+    for (size_t l = 0; l < layers.size(); ++l) {
+        bool output = l + 1 == layers.size();
+        if ((!output || config.prune_output_layer)
+            && static_cast<long>(layers[l]->layer_size) * layers[l]->input_size >= config.min_layer_weights) {
+            pruned_layers.push_back(layers[l]);
+        }
+    }
+    size_t block_rows = config.blocked ? linalg::BSR_BLOCK_ROWS : 1;
+    size_t block_cols = config.blocked ? linalg::BSR_BLOCK_COLS : 1;
+    int rounds = std::max(1, config.rounds);
 
-    for (size_t i = 0; i < layers.size(); ++i) {
-        Layer* layer = layers.at(i);
+    double base_learning_rate = learning_rate;
+    double baseline = evaluate(*validation_set);
+    if (verbose) {
+        std::printf("Pruning: baseline validation = %.4f\n", baseline);
+    }
+    std::shared_ptr<const CompiledModel> accepted = compile();
+    std::vector<AlignedVector<real_t>> accepted_masks(pruned_layers.size());
+    for (size_t l = 0; l < pruned_layers.size(); ++l) {
+        accepted_masks[l] = pruned_layers[l]->mask;
+    }
 
-        // Update each neuron's weights
-        for (Neuron* neuron : layer->neurons) {
-            for (size_t j = 0; j < inputs.size(); ++j) {
-                neuron->weights[j] += learning_rate * neuron->delta * inputs[j];
-            }
-            // Update bias weight (last weight)
-            neuron->weights.back() += learning_rate * neuron->delta;
+    for (int round = 1; round <= rounds; ++round) {
+        double remaining = 1.0 - static_cast<double>(round) / rounds;
+        double sparsity = config.target_sparsity * (1.0 - remaining * remaining * remaining);
+        for (size_t l = 0; l < pruned_layers.size(); ++l) {
+            pruned_layers[l]->prune(sparsity, block_rows, block_cols);
+        }
+        optimizer.reset();
+        if (config.fine_tune_epochs > 0) {
+            learning_rate = base_learning_rate * config.fine_tune_rate;
+            train(config.fine_tune_epochs);
+            learning_rate = base_learning_rate;
         }
 
-        // Prepare inputs for the next layer: current layer's outputs
-        inputs.clear();
-        for (Neuron* neuron : layer->neurons) {
-            inputs.push_back(neuron->output);
+        double accuracy = evaluate(*validation_set);
+        if (verbose) {
+            std::printf("Pruning round %d: sparsity = %.3f \t Validation = %.4f\n", round, sparsity, accuracy);
+        }
+        if (config.max_accuracy_loss > 0.0 && accuracy < baseline - config.max_accuracy_loss) {
+            restore(*accepted);
+            for (size_t l = 0; l < pruned_layers.size(); ++l) {
+                pruned_layers[l]->mask = accepted_masks[l];
+            }
+            if (verbose) {
+                std::printf("Accuracy loss above %.4f; keeping round %d\n", config.max_accuracy_loss, round - 1);
+            }
+            optimizer.reset();  // the state belongs to the rolled-back weights
+            break;
+        }
+        accepted = compile();
+        for (size_t l = 0; l < pruned_layers.size(); ++l) {
+            accepted_masks[l] = pruned_layers[l]->mask;
         }
     }
+
+    size_t pruned = 0, total = 0;
+    for (size_t l = 0; l < pruned_layers.size(); ++l) {
+        size_t weights = static_cast<size_t>(pruned_layers[l]->layer_size) * pruned_layers[l]->input_size;
+        pruned += static_cast<size_t>(std::llround(pruned_layers[l]->sparsity() * weights));
+        total += weights;
+    }
+    return total == 0 ? 0.0 : static_cast<double>(pruned) / total;
 }
 
 /**
- * @brief Predicts label for input data by selecting neuron with max output.
- * @param data Input data point.
- * @return Index of predicted class.
+ * @brief Converts a snapshot of the current weights to BSR.
+ * @return Shared immutable sparse model.
  */
-int NeuralNetwork::predict(DataPoint *data_point) {
-    std::vector<double> outputs = fprop(data_point);
-    return static_cast<int>(std::distance(outputs.begin(), std::max_element(outputs.begin(), outputs.end())));
+std::shared_ptr<const SparseModel> NeuralNetwork::compile_sparse() const {
+    if (features) {
+        std::cerr << "Block-sparse inference does not support feature layers." << std::endl;
+        return nullptr;
+    }
+    return std::make_shared<const SparseModel>(*compile());
 }
 
 /**
- * @brief Trains the network for a specified number of epochs.
- * @param num_epochs Number of training iterations over the entire training set.
+ * @brief Trains the network for up to a specified number of epochs.
+ *
+ * With a batch size of one on one thread every sample is its own optimizer step. Otherwise a
+ * ParallelTrainer walks the training set in consecutive mini-batches (the last one may be
+ * smaller) on the configured threads.
+ *
+ * Per-sample SGD with sparse inputs enabled runs each epoch on the CSR copy of the training
+ * set (converted once, and again only if the training set changes) and the input-major
+ * first-layer weights, which are written back to the layer after every epoch.
+ *
+ * Networks with feature layers always train per sample: their convolutions have no batched
+ * or multithreaded path, so a configured ParallelTrainer is not used.
+ *
+ * When early stopping, a target accuracy or a checkpoint is configured, every epoch ends with
+ * a validation pass. The best weights are snapshotted with compile() (and saved to the
+ * checkpoint), and restored when training ends.
+ *
+ * @param num_epochs Maximum number of training iterations over the entire training set.
+ * @return Number of epochs run.
  */
-void NeuralNetwork::train(int num_epochs) {
-    for (int epoch = 0; epoch < num_epochs; ++epoch) {
+int NeuralNetwork::train(int num_epochs) {
+    online = false;  // the optimizer and learning rate change below
+    optimizer.configure(parameter_layers());
+    std::unique_ptr<ParallelTrainer> trainer;
+    if ((batch_size > 1 || num_threads != 1) && features) {
+        std::cerr << "Feature layers train per sample; ignoring the batch size and thread count." << std::endl;
+    } else if (batch_size > 1 || num_threads != 1) {
+        trainer.reset(new ParallelTrainer(*this, optimizer, batch_size, num_threads, parallel_mode));
+    }
+    bool sparse = sparse_inputs && !trainer && !features && !optimizer.is_stateful() && !optimizer.is_masked();
+    if (sparse_inputs && !sparse) {
+        std::cerr << "Sparse inputs need per-sample SGD on an unpruned network without feature layers; "
+                  << "training the first layer densely." << std::endl;
+    }
+    if (sparse && (sparse_source != training_set || sparse_training_set.rows() != training_set->size())) {
+        sparse_training_set = SparseMatrix(*training_set);
+        sparse_source = training_set;
+    }
+
+    bool monitor = patience > 0 || target_accuracy > 0.0 || !checkpoint_path.empty();
+    std::shared_ptr<const CompiledModel> best_model;
+    double best_accuracy = -1.0;
+    double best_loss = std::numeric_limits<double>::infinity();
+    int stale_epochs = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    int epoch = 0;
+    while (epoch < num_epochs) {
+        RTML_TIMER("ann.epoch");
         double sum_error = 0.0;
+        optimizer.start_epoch(learning_rate, epochs_trained);
 
-        for (DataPoint* data_point : *training_set) {
-            std::vector<double> outputs = fprop(data_point);
-            std::vector<int> expected = data_point->get_class_vector();
+        if (trainer) {
+            sum_error = trainer->train_epoch(*training_set, batch_size);
+        } else if (sparse) {
+            transpose_input_weights(true);
+            for (size_t row = 0; row < training_set->size(); ++row) {
+                fprop_sparse(row);
+                sum_error += bprop((*training_set)[row]);
+                update_weights_sparse(row);
+            }
+            transpose_input_weights(false);
+        } else {
+            for (DataPoint* data_point : *training_set) {
+                fprop(data_point);
+                sum_error += bprop(data_point);
+                update_weights(data_point);
+            }
+        }
+        ++epoch;
+        ++epochs_trained;
 
-            // Compute sum squared error for current data point
-            double error_sum = 0.0;
-            for (size_t j = 0; j < outputs.size(); ++j) {
-                double diff = static_cast<double>(expected[j]) - outputs[j];
-                error_sum += diff * diff;
+        if (!monitor) {
+            if (verbose) {
+                std::printf("Epoch: %d \t Error = %.4f\n", epoch - 1, sum_error);
             }
-            sum_error += error_sum;
+            continue;
+        }
 
-            bprop(data_point);
-            update_weights(data_point);
+        double loss;
+        double accuracy = evaluate(*validation_set, &loss);
+        if (verbose) {
+            std::printf("Epoch: %d \t Error = %.4f \t Validation = %.4f (loss %.4f)\n", epoch - 1, sum_error,
+                        accuracy, loss);
+        }
+        // Accuracy moves in steps of 1 / |validation set|, so equal accuracy is broken by the loss
+        if (accuracy > best_accuracy + min_delta || (accuracy == best_accuracy && loss < best_loss)) {
+            best_accuracy = accuracy;
+            best_loss = loss;
+            best_model = compile();
+            stale_epochs = 0;
+            if (!checkpoint_path.empty()) {
+                best_model->save(checkpoint_path);
+            }
+        } else {
+            ++stale_epochs;
         }
 
-        std::printf("Epoch: %d \t Error = %.4f\n", epoch, sum_error);
+        if (target_accuracy > 0.0 && accuracy >= target_accuracy) {
+            if (verbose) {
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::printf("Reached validation accuracy %.4f after %d epochs (%.3f s)\n", accuracy, epoch, seconds);
+            }
+            break;
+        }
+        if (patience > 0 && stale_epochs >= patience) {
+            if (verbose) {
+                std::printf("Stopping early: no improvement for %d epochs\n", stale_epochs);
+            }
+            break;
+        }
+    }
+
+    if (best_model) {
+        restore(*best_model);
     }
+    return epoch;
 }
 
 /**
- * @brief Tests the network on the test dataset.
- * @return Accuracy (fraction of correctly predicted samples).
+ * @brief Everything learn() needs is allocated here: optimizer state, the micro-batch
+ * trainer and the first snapshot.
+ * @param config Online learning settings.
  */
-double NeuralNetwork::test() {
-    double num_correct = 0.0;
-    double count = 0.0;
+void NeuralNetwork::start_online(const OnlineConfig &config) {
+    online_config = config;
+    online_config.max_batch = std::max<size_t>(1, config.max_batch);
+    online_config.publish_interval = std::max(1, config.publish_interval);
+    optimizer.configure(parameter_layers());
+    optimizer.start_epoch(learning_rate, epochs_trained);
+    online_trainer.reset();
+    if (!features) {
+        online_trainer.reset(new ParallelTrainer(*this, optimizer, online_config.max_batch, 1, ParallelMode::HOGWILD));
+    }
+    online = true;
+    unpublished_updates = 0;
+    publish();
+}
 
-    for (DataPoint* data_point : *test_set) {
-        ++count;
-        int prediction = predict(data_point);
-        if (data_point->get_class_vector().at(prediction) == 1) {
-            ++num_correct;
+double NeuralNetwork::learn(DataPoint *sample) {
+    if (!online) {
+        start_online(online_config);
+    }
+    fprop(sample);
+    double loss = bprop(sample);
+    update_weights(sample);
+    finish_update();
+    return loss;
+}
+
+/**
+ * @brief With one thread the trainer runs on the calling thread, taking consecutive
+ * max_batch slices of the samples without copying them.
+ * @param samples Micro-batch.
+ * @return Sum of the losses.
+ */
+double NeuralNetwork::learn(const std::vector<DataPoint *> &samples) {
+    if (!online) {
+        start_online(online_config);
+    }
+    double loss = 0.0;
+    if (online_trainer) {
+        loss = online_trainer->train_epoch(samples, online_config.max_batch);
+    } else {
+        for (DataPoint *data_point : samples) {
+            fprop(data_point);
+            loss += bprop(data_point);
+            update_weights(data_point);
         }
     }
+    finish_update();
+    return loss;
+}
 
-    test_performance = num_correct / count;
-    return test_performance;
+void NeuralNetwork::finish_update() {
+    if (++unpublished_updates >= online_config.publish_interval) {
+        publish();
+    }
+}
+
+void NeuralNetwork::publish() {
+    publisher.publish(layers, features);
+    unpublished_updates = 0;
+}
+
+const ModelPublisher &NeuralNetwork::get_publisher() const {
+    return publisher;
 }
 
 /**
- * @brief Validates the network on the validation dataset and prints performance.
+ * @brief Classifies every sample with the current weights.
+ * @param samples Data points to classify.
+ * @param loss If not null, receives the mean loss over the samples (0 for an empty set).
+ * @return Fraction of correct predictions (0 for an empty set).
  */
-void NeuralNetwork::validate() {
+double NeuralNetwork::evaluate(const std::vector<DataPoint *> &samples, double *loss) {
+    if (loss) {
+        *loss = 0.0;
+    }
+    if (samples.empty()) {
+        return 0.0;
+    }
+    size_t last = layers.size() - 1;
     double num_correct = 0.0;
-    double count = 0.0;
-
-    for (DataPoint* data_point : *validation_set) {
-        ++count;
-        int prediction = predict(data_point);
-        // std::printf("Predicted: %d, Expected: %d\n", prediction, data_point->get_label());  // Debug
-        if (data_point->get_class_vector().at(prediction) == 1) {
+    double loss_sum = 0.0;
+    for (DataPoint* data_point : samples) {
+        if (predict(data_point) == data_point->get_label()) {
             ++num_correct;
         }
+        if (loss) {
+            // The output deltas are scratch here; only the loss is kept
+            loss_sum += activation::output_deltas(layers[last]->activation, workspace.activation(last),
+                                                  data_point->get_label(), workspace.delta(last),
+                                                  static_cast<size_t>(layers[last]->layer_size));
+        }
     }
+    if (loss) {
+        *loss = loss_sum / static_cast<double>(samples.size());
+    }
+    return num_correct / static_cast<double>(samples.size());
+}
 
-    std::printf("Validation Performance: %.4f\n", num_correct / count);
-}
\ No newline at end of file
+/**
+ * @brief Tests the network on the test dataset.
+ * @return Accuracy (fraction of correctly predicted samples).
+ */
+double NeuralNetwork::test() {
+    test_performance = evaluate(*test_set);
+    return test_performance;
+}
+
+/**
+ * @brief Validates the network on the validation dataset and prints performance.
+ * @return Accuracy (fraction of correctly predicted samples).
+ */
+double NeuralNetwork::validate() {
+    double accuracy = evaluate(*validation_set);
+    std::printf("Validation Performance: %.4f\n", accuracy);
+    return accuracy;
+}
@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "optimizer.hpp"
+#include "simd.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using simd::vec;
+using simd::VEC_LANES;
+using simd::load_partial;
+
+namespace {
+
+typedef decltype(vec{} < vec{}) mask_vec;
+
+/**
+ * Decayed state below this magnitude is flushed to zero. Moments of parameters that keep
+ * getting zero gradients (e.g. weights of always-black pixels) otherwise decay into denormals,
+ * which are an order of magnitude slower to compute with on x86.
+ */
+constexpr real_t STATE_FLOOR = std::numeric_limits<real_t>::min() * 16;
+
+/**
+ * @brief Lane-wise square root (generic vectors have no sqrt operator).
+ */
+inline void sqrt_vec(const vec &x, vec &result) {
+#if defined(__AVX__)
+    if (sizeof(real_t) == 4) {
+        result = (vec)_mm256_sqrt_ps((__m256)x);
+    } else {
+        result = (vec)_mm256_sqrt_pd((__m256d)x);
+    }
+#elif defined(__SSE2__)
+    if (sizeof(real_t) == 4) {
+        result = (vec)_mm_sqrt_ps((__m128)x);
+    } else {
+        result = (vec)_mm_sqrt_pd((__m128d)x);
+    }
+#else
+    for (size_t lane = 0; lane < VEC_LANES; ++lane) {
+        result[lane] = std::sqrt(x[lane]);
+    }
+#endif
+}
+
+/**
+ * @brief Zeroes the lanes of x whose magnitude is below STATE_FLOOR.
+ */
+inline void flush_tiny(vec &x) {
+    mask_vec keep = (x > STATE_FLOOR) | (x < -STATE_FLOOR);
+    x = (vec)((mask_vec)x & keep);
+}
+
+/**
+ * @brief One vector of the update: d is the scaled direction, w the parameters, m and s the
+ * optimizer state (unused lanes for rules that do not need them).
+ */
+template <OptimizerType T>
+inline void update_vec(const vec &d, vec &w, vec &m, vec &s, const Optimizer::Step &step);
+
+template <>
+inline void update_vec<OptimizerType::SGD>(const vec &d, vec &w, vec &, vec &, const Optimizer::Step &step) {
+    w += step.learning_rate * d;
+}
+
+template <>
+inline void update_vec<OptimizerType::MOMENTUM>(const vec &d, vec &w, vec &m, vec &, const Optimizer::Step &step) {
+    m = step.momentum * m + d;
+    w += step.learning_rate * m;
+}
+
+template <>
+inline void update_vec<OptimizerType::NESTEROV>(const vec &d, vec &w, vec &m, vec &, const Optimizer::Step &step) {
+    m = step.momentum * m + d;
+    w += step.learning_rate * (d + step.momentum * m);
+}
+
+template <>
+inline void update_vec<OptimizerType::ADAM>(const vec &d, vec &w, vec &m, vec &s, const Optimizer::Step &step) {
+    m = step.beta1 * m + (real_t(1) - step.beta1) * d;
+    s = step.beta2 * s + (real_t(1) - step.beta2) * d * d;
+    vec root;
+    sqrt_vec(s, root);
+    w += step.learning_rate * m / (root + step.epsilon);
+}
+
+/**
+ * @brief Streams the direction, parameters and state once; the tail goes through
+ * zero-padded vectors so every element takes the same path. With a mask, pruned parameters
+ * get no direction and are reset to zero after the rule, whatever their state.
+ */
+template <OptimizerType T, bool Masked>
+void update(size_t n, real_t scale, const real_t *direction, real_t *params, real_t *first, real_t *second,
+            const real_t *mask, const Optimizer::Step &step) {
+    constexpr bool has_first = T != OptimizerType::SGD;
+    constexpr bool has_second = T == OptimizerType::ADAM;
+    vec d, w, m = {}, s = {}, keep;
+    size_t i = 0;
+    for (; i + VEC_LANES <= n; i += VEC_LANES) {
+        LOAD_VEC(d, direction + i);
+        LOAD_VEC(w, params + i);
+        if (has_first) {
+            LOAD_VEC(m, first + i);
+        }
+        if (has_second) {
+            LOAD_VEC(s, second + i);
+        }
+        d *= scale;
+        if (Masked) {
+            LOAD_VEC(keep, mask + i);
+            d *= keep;
+        }
+        update_vec<T>(d, w, m, s, step);
+        if (Masked) {
+            w *= keep;
+        }
+        std::memcpy(params + i, &w, sizeof(vec));
+        if (has_first) {
+            flush_tiny(m);
+            std::memcpy(first + i, &m, sizeof(vec));
+        }
+        if (has_second) {
+            flush_tiny(s);
+            std::memcpy(second + i, &s, sizeof(vec));
+        }
+    }
+    if (i < n) {
+        size_t rest = n - i;
+        load_partial(direction + i, rest, d);
+        load_partial(params + i, rest, w);
+        if (has_first) {
+            load_partial(first + i, rest, m);
+        }
+        if (has_second) {
+            load_partial(second + i, rest, s);
+        }
+        d *= scale;
+        if (Masked) {
+            load_partial(mask + i, rest, keep);
+            d *= keep;
+        }
+        update_vec<T>(d, w, m, s, step);
+        if (Masked) {
+            w *= keep;
+        }
+        std::memcpy(params + i, &w, rest * sizeof(real_t));
+        if (has_first) {
+            flush_tiny(m);
+            std::memcpy(first + i, &m, rest * sizeof(real_t));
+        }
+        if (has_second) {
+            flush_tiny(s);
+            std::memcpy(second + i, &s, rest * sizeof(real_t));
+        }
+    }
+}
+
+/**
+ * @brief Runs one update kernel, specialized on whether the array is masked.
+ */
+template <OptimizerType T>
+void dispatch(size_t n, real_t scale, const real_t *direction, real_t *params, real_t *first, real_t *second,
+              const real_t *mask, const Optimizer::Step &step) {
+    if (mask) {
+        update<T, true>(n, scale, direction, params, first, second, mask, step);
+    } else {
+        update<T, false>(n, scale, direction, params, first, second, mask, step);
+    }
+}
+
+} // namespace
+
+Optimizer::Optimizer()
+    : steps(0), epoch_learning_rate(0.0) {}
+
+void Optimizer::set_config(const OptimizerConfig &config) {
+    this->config = config;
+    reset();
+}
+
+const OptimizerConfig &Optimizer::get_config() const {
+    return config;
+}
+
+/**
+ * @brief SGD keeps no state. MOMENTUM and NESTEROV keep a velocity per parameter, ADAM
+ * two moments, all starting at zero.
+ */
+void Optimizer::configure(const std::vector<Layer *> &layers) {
+    masks.assign(2 * layers.size(), nullptr);
+    for (size_t l = 0; l < layers.size(); ++l) {
+        if (!layers[l]->mask.empty()) {
+            masks[slot(l, false)] = layers[l]->mask.data();
+        }
+    }
+
+    if (!is_stateful()) {
+        return;
+    }
+    bool fits = first_moments.size() == 2 * layers.size();
+    for (size_t l = 0; fits && l < layers.size(); ++l) {
+        fits = first_moments[slot(l, false)].size() == layers[l]->weights.size()
+               && first_moments[slot(l, true)].size() == layers[l]->biases.size();
+    }
+    if (fits) {
+        return;
+    }
+
+    first_moments.assign(2 * layers.size(), AlignedVector<real_t>());
+    second_moments.assign(2 * layers.size(), AlignedVector<real_t>());
+    for (size_t l = 0; l < layers.size(); ++l) {
+        first_moments[slot(l, false)].assign(layers[l]->weights.size(), 0.0);
+        first_moments[slot(l, true)].assign(layers[l]->biases.size(), 0.0);
+        if (config.type == OptimizerType::ADAM) {
+            second_moments[slot(l, false)].assign(layers[l]->weights.size(), 0.0);
+            second_moments[slot(l, true)].assign(layers[l]->biases.size(), 0.0);
+        }
+    }
+    steps = 0;
+}
+
+void Optimizer::reset() {
+    first_moments.clear();
+    second_moments.clear();
+    steps = 0;
+}
+
+bool Optimizer::is_stateful() const {
+    return config.type != OptimizerType::SGD;
+}
+
+bool Optimizer::is_masked() const {
+    return std::any_of(masks.begin(), masks.end(), [](const real_t *mask) { return mask != nullptr; });
+}
+
+double Optimizer::start_epoch(double base_learning_rate, int epoch) {
+    int period = std::max(1, config.schedule_epochs);
+    switch (config.schedule) {
+    case LearningRateSchedule::CONSTANT:
+        epoch_learning_rate = base_learning_rate;
+        break;
+    case LearningRateSchedule::STEP:
+        epoch_learning_rate = base_learning_rate * std::pow(config.decay, epoch / period);
+        break;
+    case LearningRateSchedule::EXPONENTIAL:
+        epoch_learning_rate = base_learning_rate * std::pow(config.decay, epoch);
+        break;
+    case LearningRateSchedule::COSINE: {
+        double progress = static_cast<double>(std::min(epoch, period)) / period;
+        epoch_learning_rate = config.min_learning_rate
+                              + 0.5 * (base_learning_rate - config.min_learning_rate) * (1.0 + std::cos(M_PI * progress));
+        break;
+    }
+    }
+    return epoch_learning_rate;
+}
+
+/**
+ * @brief ADAM folds its bias correction sqrt(1 - beta2^t) / (1 - beta1^t) into the rate.
+ */
+Optimizer::Step Optimizer::begin_step() {
+    long t = ++steps;
+    double learning_rate = epoch_learning_rate;
+    if (config.type == OptimizerType::ADAM) {
+        learning_rate *= std::sqrt(1.0 - std::pow(config.beta2, static_cast<double>(t)))
+                         / (1.0 - std::pow(config.beta1, static_cast<double>(t)));
+    }
+    Step step;
+    step.learning_rate = static_cast<real_t>(learning_rate);
+    step.momentum = static_cast<real_t>(config.momentum);
+    step.beta1 = static_cast<real_t>(config.beta1);
+    step.beta2 = static_cast<real_t>(config.beta2);
+    step.epsilon = static_cast<real_t>(config.epsilon);
+    return step;
+}
+
+size_t Optimizer::slot(size_t layer, bool biases) {
+    return 2 * layer + (biases ? 1 : 0);
+}
+
+void Optimizer::apply(size_t slot, size_t offset, size_t n, real_t scale, const real_t *direction, real_t *params,
+                      const Step &step) {
+    real_t *first = first_moments.empty() ? nullptr : first_moments[slot].data() + offset;
+    real_t *second = second_moments.empty() || second_moments[slot].empty() ? nullptr : second_moments[slot].data() + offset;
+    const real_t *mask = slot < masks.size() && masks[slot] ? masks[slot] + offset : nullptr;
+    switch (config.type) {
+    case OptimizerType::SGD:
+        dispatch<OptimizerType::SGD>(n, scale, direction, params, first, second, mask, step);
+        break;
+    case OptimizerType::MOMENTUM:
+        dispatch<OptimizerType::MOMENTUM>(n, scale, direction, params, first, second, mask, step);
+        break;
+    case OptimizerType::NESTEROV:
+        dispatch<OptimizerType::NESTEROV>(n, scale, direction, params, first, second, mask, step);
+        break;
+    case OptimizerType::ADAM:
+        dispatch<OptimizerType::ADAM>(n, scale, direction, params, first, second, mask, step);
+        break;
+    }
+}
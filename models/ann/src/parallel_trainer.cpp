@@ -0,0 +1,261 @@
+#include <algorithm>
+#include "activation.hpp"
+#include "layer.hpp"
+#include "linalg.hpp"
+#include "neural_network.hpp"
+#include "parallel_trainer.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+/**
+ * @brief Start and end of part `index` when `total` items are split into `parts` near-equal parts.
+ */
+void partition(size_t total, unsigned parts, unsigned index, size_t &begin, size_t &end) {
+    begin = total * index / parts;
+    end = total * (index + 1) / parts;
+}
+
+} // namespace
+
+/**
+ * @brief Sizes every worker's scratch from the network spec and the batch size.
+ */
+ParallelTrainer::ParallelTrainer(NeuralNetwork &network, Optimizer &optimizer, size_t batch_size, unsigned num_threads,
+                                 ParallelMode mode)
+    : network(network), optimizer(optimizer), num_threads(num_threads), mode(mode)
+{
+    if (this->num_threads == 0) {
+        this->num_threads = ThreadPool::shared().size();
+    }
+
+    const std::vector<Layer *> &layers = network.layers;
+    bool needs_gradients = (mode == ParallelMode::DATA_PARALLEL && this->num_threads > 1) || optimizer.is_stateful()
+                           || optimizer.is_masked();
+    workers.resize(this->num_threads);
+    for (WorkerState &state : workers) {
+        state.workspace.configure(layers, batch_size);
+        if (!needs_gradients) {
+            continue;  // updates go straight into the weights
+        }
+        for (Layer *layer : layers) {
+            state.weight_gradients.emplace_back(layer->weights.size());
+            state.bias_gradients.emplace_back(layer->biases.size());
+        }
+    }
+}
+
+unsigned ParallelTrainer::get_num_threads() const {
+    return num_threads;
+}
+
+/**
+ * @brief Activations and deltas are count x layer_size matrices: the forward pass is
+ * X * W^T and the hidden deltas are D_next * W_next, one blocked GEMM each.
+ */
+double ParallelTrainer::forward_backward(WorkerState &state, const std::vector<DataPoint *> &samples,
+                                         size_t first, size_t count) {
+    const std::vector<Layer *> &layers = network.layers;
+    size_t input_size = static_cast<size_t>(layers.front()->input_size);
+    for (size_t b = 0; b < count; ++b) {
+        const std::vector<real_t> *features = samples[first + b]->get_normalized_feature_vector();
+        std::copy(features->begin(), features->end(), state.workspace.input(b));
+    }
+
+    // Forward: outputs = f(inputs * W^T + b), the bias add fused into the activation pass
+    const real_t *inputs = state.workspace.input();
+    size_t input_stride = input_size;
+    for (size_t l = 0; l < layers.size(); ++l) {
+        const Layer *layer = layers[l];
+        size_t width = static_cast<size_t>(layer->layer_size);
+        real_t *outputs = state.workspace.activation(l);
+        linalg::gemm(linalg::Transpose::NO, linalg::Transpose::YES, count, width, layer->input_size,
+                     1.0, inputs, input_stride, layer->weights.data(), layer->stride, 0.0, outputs, width);
+        activation::forward(layer->activation, outputs, count, width, layer->biases.data());
+        inputs = outputs;
+        input_stride = width;
+    }
+
+    // Output deltas and loss against the one-hot target (1 at the raw label)
+    double error_sum = 0.0;
+    size_t last = layers.size() - 1;
+    size_t num_outputs = static_cast<size_t>(layers[last]->layer_size);
+    for (size_t b = 0; b < count; ++b) {
+        error_sum += activation::output_deltas(layers[last]->activation, state.workspace.activation(last, b),
+                                               samples[first + b]->get_label(), state.workspace.delta(last, b),
+                                               num_outputs);
+    }
+
+    // Hidden deltas: D = (D_next * W_next) .* f'(outputs)
+    for (size_t l = last; l-- > 0;) {
+        const Layer *next_layer = layers[l + 1];
+        size_t width = static_cast<size_t>(layers[l]->layer_size);
+        linalg::gemm(linalg::Transpose::NO, linalg::Transpose::NO, count, width, next_layer->layer_size,
+                     1.0, state.workspace.delta(l + 1), next_layer->layer_size,
+                     next_layer->weights.data(), next_layer->stride, 0.0, state.workspace.delta(l), width);
+        activation::backward(layers[l]->activation, state.workspace.activation(l), state.workspace.delta(l),
+                             count * width);
+    }
+
+    return error_sum;
+}
+
+/**
+ * @brief Gradient sums: G = D^T * inputs and g = sum of D rows, per layer.
+ */
+void ParallelTrainer::store_gradients(WorkerState &state, size_t count) {
+    const std::vector<Layer *> &layers = network.layers;
+    const real_t *inputs = state.workspace.input();
+    size_t input_stride = static_cast<size_t>(layers.front()->input_size);
+    for (size_t l = 0; l < layers.size(); ++l) {
+        const Layer *layer = layers[l];
+        size_t width = static_cast<size_t>(layer->layer_size);
+        linalg::gemm(linalg::Transpose::YES, linalg::Transpose::NO, width, layer->input_size, count,
+                     1.0, state.workspace.delta(l), width, inputs, input_stride,
+                     0.0, state.weight_gradients[l].data(), layer->stride);
+        std::fill(state.bias_gradients[l].begin(), state.bias_gradients[l].end(), real_t(0));
+        for (size_t b = 0; b < count; ++b) {
+            linalg::axpy(width, 1.0, state.workspace.delta(l) + b * width, state.bias_gradients[l].data());
+        }
+        inputs = state.workspace.activation(l);
+        input_stride = width;
+    }
+}
+
+/**
+ * @brief Fused update W += step * D^T * inputs straight into the network weights.
+ */
+void ParallelTrainer::apply_direct(WorkerState &state, size_t count, real_t step) {
+    const std::vector<Layer *> &layers = network.layers;
+    const real_t *inputs = state.workspace.input();
+    size_t input_stride = static_cast<size_t>(layers.front()->input_size);
+    for (size_t l = 0; l < layers.size(); ++l) {
+        Layer *layer = layers[l];
+        size_t width = static_cast<size_t>(layer->layer_size);
+        linalg::gemm(linalg::Transpose::YES, linalg::Transpose::NO, width, layer->input_size, count,
+                     step, state.workspace.delta(l), width, inputs, input_stride,
+                     1.0, layer->weights.data(), layer->stride);
+        for (size_t b = 0; b < count; ++b) {
+            linalg::axpy(width, step, state.workspace.delta(l) + b * width, layer->biases.data());
+        }
+        inputs = state.workspace.activation(l);
+        input_stride = width;
+    }
+}
+
+/**
+ * @brief One fused optimizer pass per parameter array over the summed gradient.
+ */
+void ParallelTrainer::apply_stored(WorkerState &state, real_t scale, const Optimizer::Step &step) {
+    const std::vector<Layer *> &layers = network.layers;
+    for (size_t l = 0; l < layers.size(); ++l) {
+        Layer *layer = layers[l];
+        optimizer.apply(Optimizer::slot(l, false), 0, layer->weights.size(), scale, state.weight_gradients[l].data(),
+                        layer->weights.data(), step);
+        optimizer.apply(Optimizer::slot(l, true), 0, layer->biases.size(), scale, state.bias_gradients[l].data(),
+                        layer->biases.data(), step);
+    }
+}
+
+/**
+ * @brief Pairwise reduction over workers in a fixed order, restricted to this slice's rows of
+ * every layer, so slices can be reduced and updated concurrently without sharing any memory.
+ */
+void ParallelTrainer::reduce_and_apply(unsigned slice, real_t scale, const Optimizer::Step &step) {
+    const std::vector<Layer *> &layers = network.layers;
+    for (size_t l = 0; l < layers.size(); ++l) {
+        Layer *layer = layers[l];
+        size_t row_begin, row_end;
+        partition(static_cast<size_t>(layer->layer_size), num_threads, slice, row_begin, row_end);
+        if (row_begin == row_end) {
+            continue;
+        }
+        size_t offset = row_begin * layer->stride;
+        size_t length = (row_end - row_begin) * layer->stride;
+
+        for (unsigned span = 1; span < num_threads; span *= 2) {
+            for (unsigned t = 0; t + span < num_threads; t += 2 * span) {
+                linalg::axpy(length, 1.0, workers[t + span].weight_gradients[l].data() + offset,
+                             workers[t].weight_gradients[l].data() + offset);
+                linalg::axpy(row_end - row_begin, 1.0, workers[t + span].bias_gradients[l].data() + row_begin,
+                             workers[t].bias_gradients[l].data() + row_begin);
+            }
+        }
+
+        optimizer.apply(Optimizer::slot(l, false), offset, length, scale,
+                        workers[0].weight_gradients[l].data() + offset, layer->weights.data() + offset, step);
+        optimizer.apply(Optimizer::slot(l, true), row_begin, row_end - row_begin, scale,
+                        workers[0].bias_gradients[l].data() + row_begin, layer->biases.data() + row_begin, step);
+    }
+}
+
+/**
+ * @brief Per batch: shards in parallel, then slices reduced and applied in parallel; the end
+ * of each parallel_for is the barrier between the two.
+ */
+double ParallelTrainer::data_parallel_epoch(const std::vector<DataPoint *> &samples, size_t batch_size) {
+    ThreadPool &pool = ThreadPool::shared();
+    double sum_error = 0.0;
+    for (size_t first = 0; first < samples.size(); first += batch_size) {
+        size_t count = std::min(batch_size, samples.size() - first);
+        pool.parallel_for(0, num_threads, 1, [&](size_t first_shard, size_t last_shard) {
+            for (size_t t = first_shard; t < last_shard; ++t) {
+                WorkerState &state = workers[t];
+                size_t shard_begin, shard_end;
+                partition(count, num_threads, static_cast<unsigned>(t), shard_begin, shard_end);
+                state.error_sum = forward_backward(state, samples, first + shard_begin, shard_end - shard_begin);
+                store_gradients(state, shard_end - shard_begin);
+            }
+        });
+
+        Optimizer::Step step = optimizer.begin_step();
+        real_t scale = static_cast<real_t>(1.0 / static_cast<double>(count));
+        pool.parallel_for(0, num_threads, 1, [&](size_t first_slice, size_t last_slice) {
+            for (size_t t = first_slice; t < last_slice; ++t) {
+                reduce_and_apply(static_cast<unsigned>(t), scale, step);
+            }
+        });
+        for (const WorkerState &worker : workers) {
+            sum_error += worker.error_sum;
+        }
+    }
+    return sum_error;
+}
+
+/**
+ * @brief Each worker state takes mini-batches round-robin and applies them as soon as they
+ * are computed. Stateful optimizers share their state the same lock-free way as the weights.
+ * Plain SGD updates the weights with one GEMM, unless pruning masks require the optimizer's pass.
+ */
+double ParallelTrainer::hogwild_epoch(const std::vector<DataPoint *> &samples, size_t batch_size) {
+    ThreadPool::shared().parallel_for(0, num_threads, 1, [&](size_t first_worker, size_t last_worker) {
+        for (size_t t = first_worker; t < last_worker; ++t) {
+            WorkerState &state = workers[t];
+            state.error_sum = 0.0;
+            for (size_t first = t * batch_size; first < samples.size(); first += num_threads * batch_size) {
+                size_t count = std::min(batch_size, samples.size() - first);
+                state.error_sum += forward_backward(state, samples, first, count);
+                Optimizer::Step step = optimizer.begin_step();
+                if (optimizer.is_stateful() || optimizer.is_masked()) {
+                    store_gradients(state, count);
+                    apply_stored(state, static_cast<real_t>(1.0 / static_cast<double>(count)), step);
+                } else {
+                    apply_direct(state, count, static_cast<real_t>(step.learning_rate / static_cast<double>(count)));
+                }
+            }
+        }
+    });
+
+    double sum_error = 0.0;
+    for (const WorkerState &state : workers) {
+        sum_error += state.error_sum;
+    }
+    return sum_error;
+}
+
+double ParallelTrainer::train_epoch(const std::vector<DataPoint *> &samples, size_t batch_size) {
+    if (mode == ParallelMode::DATA_PARALLEL && num_threads > 1) {
+        return data_parallel_epoch(samples, batch_size);
+    }
+    return hogwild_epoch(samples, batch_size);
+}
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include "activation.hpp"
+#include "linalg.hpp"
+#include "neural_network.hpp"
+#include "quantized_model.hpp"
+
+/**
+ * @brief Largest int8 weight magnitude; two u8 x 63 products always fit in an int16 lane.
+ */
+static const int WEIGHT_LIMIT = 63;
+
+/**
+ * @brief Weight rows are padded to a multiple of one cache line.
+ */
+static const int ROW_ALIGNMENT = 64;
+
+void QuantizationReport::print() const {
+    std::printf("Float accuracy: %.4f \t Int8 accuracy: %.4f \t Delta: %+.4f\n",
+                float_accuracy, quantized_accuracy, accuracy_delta);
+    std::printf("Parameters: %zu bytes -> %zu bytes \t Kernel: %s\n", float_bytes, quantized_bytes, kernel);
+}
+
+/**
+ * @brief Folds input normalization into layer 0, calibrates activation scales with a
+ * floating-point pass over the calibration set, then quantizes every weight row.
+ */
+QuantizedModel::QuantizedModel(const CompiledModel &model,
+                               const std::vector<double> &feature_mins,
+                               const std::vector<double> &feature_maxs,
+                               const std::vector<DataPoint *> &calibration_set,
+                               QuantizationGranularity granularity)
+    : granularity(granularity)
+{
+    size_t num_layers = model.num_layers();
+
+    // Floating-point weights, with the first layer rewritten to take raw features
+    std::vector<std::vector<double>> weights(num_layers);
+    std::vector<std::vector<double>> biases(num_layers);
+    for (size_t l = 0; l < num_layers; ++l) {
+        const CompiledModel::LayerView &view = model.layer(l);
+        size_t rows = static_cast<size_t>(view.layer_size);
+        size_t cols = static_cast<size_t>(view.input_size);
+        weights[l].resize(rows * cols);
+        biases[l].assign(model.biases(l), model.biases(l) + rows);
+        for (size_t i = 0; i < rows; ++i) {
+            const real_t *row = model.weights(l) + i * view.stride;
+            for (size_t j = 0; j < cols; ++j) {
+                double weight = row[j];
+                if (l == 0) {
+                    double range = feature_maxs[j] - feature_mins[j];
+                    weight = range == 0.0 ? 0.0 : weight / range;
+                    biases[l][i] -= weight * feature_mins[j];
+                }
+                weights[l][i * cols + j] = weight;
+            }
+        }
+    }
+
+    // Calibration: largest activation of every hidden layer
+    std::vector<double> max_activation(num_layers, 0.0);
+    std::vector<real_t> current, next;
+    for (DataPoint *data_point : calibration_set) {
+        current = *data_point->get_normalized_feature_vector();
+        for (size_t l = 0; l + 1 < num_layers; ++l) {
+            const CompiledModel::LayerView &view = model.layer(l);
+            next.resize(view.layer_size);
+            linalg::gemv(view.layer_size, view.input_size, 1.0, model.weights(l), view.stride,
+                         current.data(), 0.0, next.data());
+            activation::forward(view.activation, next.data(), 1, view.layer_size, model.biases(l));
+            for (real_t value : next) {
+                max_activation[l] = std::max<double>(max_activation[l], value);
+            }
+            current.swap(next);
+        }
+    }
+
+    double input_scale = 1.0;  // raw uint8 features are exact integers
+    for (size_t l = 0; l < num_layers; ++l) {
+        const CompiledModel::LayerView &view = model.layer(l);
+        QuantizedLayer layer;
+        layer.input_size = view.input_size;
+        layer.layer_size = view.layer_size;
+        layer.stride = (view.input_size + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+        layer.weights.assign(static_cast<size_t>(layer.layer_size) * layer.stride, 0);
+        layer.biases = biases[l];
+        layer.output_scale = max_activation[l] > 0.0 ? max_activation[l] / 255.0 : 1.0 / 255.0;
+        layer.activation = view.activation;
+        if (l + 1 < num_layers && (view.activation == Activation::TANH || view.activation == Activation::LEAKY_RELU)) {
+            std::cerr << "Warning: layer " << l << " uses " << activation::name(view.activation)
+                      << "; its negative outputs are clipped to zero in int8 inference." << std::endl;
+        }
+
+        size_t cols = static_cast<size_t>(view.input_size);
+        double layer_max = 0.0;
+        for (double weight : weights[l]) {
+            layer_max = std::max(layer_max, std::fabs(weight));
+        }
+        for (int i = 0; i < layer.layer_size; ++i) {
+            const double *row = weights[l].data() + i * cols;
+            double row_max = layer_max;
+            if (granularity == QuantizationGranularity::PER_CHANNEL) {
+                row_max = 0.0;
+                for (size_t j = 0; j < cols; ++j) {
+                    row_max = std::max(row_max, std::fabs(row[j]));
+                }
+            }
+            double weight_scale = row_max > 0.0 ? row_max / WEIGHT_LIMIT : 1.0;
+            int8_t *quantized = layer.weights.data() + static_cast<size_t>(i) * layer.stride;
+            for (size_t j = 0; j < cols; ++j) {
+                long q = std::lround(row[j] / weight_scale);
+                quantized[j] = static_cast<int8_t>(std::max<long>(-WEIGHT_LIMIT, std::min<long>(WEIGHT_LIMIT, q)));
+            }
+            layer.scales.push_back(weight_scale * input_scale);
+        }
+
+        input_scale = layer.output_scale;
+        layers.push_back(std::move(layer));
+    }
+}
+
+/**
+ * @brief Integer GEMV per layer, dequantized to apply bias and the activation, then
+ * requantized to uint8 for the next layer. The last layer only needs the argmax of its
+ * pre-activations, which every output activation preserves.
+ */
+int QuantizedModel::predict(const uint8_t *pixels) const {
+    thread_local std::vector<int32_t> accumulators;
+    thread_local std::vector<real_t> values;
+    thread_local AlignedVector<uint8_t> activations[2];
+
+    const uint8_t *inputs = pixels;
+    for (size_t l = 0; l < layers.size(); ++l) {
+        const QuantizedLayer &layer = layers[l];
+        accumulators.resize(layer.layer_size);
+        linalg::gemv_u8s8(layer.layer_size, layer.input_size, layer.weights.data(), layer.stride,
+                          inputs, accumulators.data());
+
+        if (l + 1 == layers.size()) {
+            int best = 0;
+            double best_value = 0.0;
+            for (int i = 0; i < layer.layer_size; ++i) {
+                double value = layer.biases[i] + layer.scales[i] * accumulators[i];
+                if (i == 0 || value > best_value) {
+                    best = i;
+                    best_value = value;
+                }
+            }
+            return best;
+        }
+
+        values.resize(layer.layer_size);
+        for (int i = 0; i < layer.layer_size; ++i) {
+            values[i] = static_cast<real_t>(layer.biases[i] + layer.scales[i] * accumulators[i]);
+        }
+        activation::forward(layer.activation, values.data(), 1, layer.layer_size, nullptr);
+
+        AlignedVector<uint8_t> &outputs = activations[l % 2];
+        outputs.resize(layer.layer_size);
+        for (int i = 0; i < layer.layer_size; ++i) {
+            long q = std::lround(values[i] / layer.output_scale);
+            outputs[i] = static_cast<uint8_t>(std::max<long>(0, std::min<long>(255, q)));
+        }
+        inputs = outputs.data();
+    }
+    return 0;
+}
+
+int QuantizedModel::predict(DataPoint *data_point) const {
+    return predict(data_point->get_feature_vector()->data());
+}
+
+double QuantizedModel::evaluate(const std::vector<DataPoint *> &samples) const {
+    double num_correct = 0.0;
+    for (DataPoint *data_point : samples) {
+        if (predict(data_point) == data_point->get_label()) {
+            ++num_correct;
+        }
+    }
+    return samples.empty() ? 0.0 : num_correct / static_cast<double>(samples.size());
+}
+
+QuantizationReport QuantizedModel::compare(std::shared_ptr<const CompiledModel> reference,
+                                           const std::vector<DataPoint *> &samples) const {
+    InferenceContext context(reference);
+    double num_correct = 0.0;
+    for (DataPoint *data_point : samples) {
+        if (context.predict(data_point) == data_point->get_label()) {
+            ++num_correct;
+        }
+    }
+
+    QuantizationReport report;
+    report.float_accuracy = samples.empty() ? 0.0 : num_correct / static_cast<double>(samples.size());
+    report.quantized_accuracy = evaluate(samples);
+    report.accuracy_delta = report.quantized_accuracy - report.float_accuracy;
+    report.float_bytes = 0;
+    for (size_t l = 0; l < reference->num_layers(); ++l) {
+        const CompiledModel::LayerView &view = reference->layer(l);
+        report.float_bytes += static_cast<size_t>(view.layer_size) * (view.input_size + 1) * sizeof(real_t);
+    }
+    report.quantized_bytes = parameter_bytes();
+    report.kernel = linalg::int8_kernel_name();
+    return report;
+}
+
+size_t QuantizedModel::parameter_bytes() const {
+    size_t bytes = 0;
+    for (const QuantizedLayer &layer : layers) {
+        bytes += static_cast<size_t>(layer.layer_size) * layer.input_size * sizeof(int8_t);
+        bytes += (layer.scales.size() + layer.biases.size()) * sizeof(double);
+    }
+    return bytes;
+}
+
+QuantizationGranularity QuantizedModel::get_granularity() const {
+    return granularity;
+}
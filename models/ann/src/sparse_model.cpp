@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include "activation.hpp"
+#include "linalg.hpp"
+#include "sparse_model.hpp"
+
+using linalg::BSR_BLOCK_COLS;
+using linalg::BSR_BLOCK_ROWS;
+
+/**
+ * @brief Rounds n up to a multiple of block.
+ */
+static size_t round_up(size_t n, size_t block) {
+    return (n + block - 1) / block * block;
+}
+
+void SparsityReport::print() const {
+    std::printf("Dense accuracy: %.4f \t Sparse accuracy: %.4f \t Delta: %+.4f\n",
+                dense_accuracy, sparse_accuracy, accuracy_delta);
+    std::printf("Zero weights: %.1f%% \t Stored blocks: %.1f%% \t Parameters: %zu bytes -> %zu bytes\n",
+                100.0 * sparsity, 100.0 * block_density, dense_bytes, sparse_bytes);
+    std::printf("Prediction: %.0f ns dense -> %.0f ns sparse (%.2fx)\n", dense_ns, sparse_ns,
+                sparse_ns > 0.0 ? dense_ns / sparse_ns : 0.0);
+}
+
+/**
+ * @brief Walks every layer tile by tile, copying tiles with a non-zero weight into the block
+ * array (zero-padded where a tile hangs over the matrix edge).
+ */
+SparseModel::SparseModel(const CompiledModel &model)
+    : scratch_size(0), num_weights(0), num_zeros(0), num_blocks(0), num_stored_blocks(0)
+{
+    const size_t block_size = BSR_BLOCK_ROWS * BSR_BLOCK_COLS;
+    for (size_t l = 0; l < model.num_layers(); ++l) {
+        const CompiledModel::LayerView &view = model.layer(l);
+        size_t rows = static_cast<size_t>(view.layer_size);
+        size_t cols = static_cast<size_t>(view.input_size);
+        const real_t *weights = model.weights(l);
+
+        SparseLayer layer;
+        layer.input_size = view.input_size;
+        layer.layer_size = view.layer_size;
+        layer.block_rows = round_up(rows, BSR_BLOCK_ROWS) / BSR_BLOCK_ROWS;
+        layer.biases.assign(model.biases(l), model.biases(l) + rows);
+        layer.activation = view.activation;
+        layer.row_offsets.push_back(0);
+        for (size_t r = 0; r < layer.block_rows; ++r) {
+            size_t row_begin = r * BSR_BLOCK_ROWS, row_end = std::min(rows, row_begin + BSR_BLOCK_ROWS);
+            for (size_t col_begin = 0; col_begin < cols; col_begin += BSR_BLOCK_COLS) {
+                size_t col_end = std::min(cols, col_begin + BSR_BLOCK_COLS);
+                size_t zeros = 0;
+                for (size_t j = row_begin; j < row_end; ++j) {
+                    zeros += static_cast<size_t>(std::count(weights + j * view.stride + col_begin,
+                                                            weights + j * view.stride + col_end, real_t(0)));
+                }
+                size_t cells = (row_end - row_begin) * (col_end - col_begin);
+                num_weights += cells;
+                num_zeros += zeros;
+                ++num_blocks;
+                if (zeros == cells) {
+                    continue;
+                }
+
+                layer.blocks.resize(layer.blocks.size() + block_size, 0.0);
+                real_t *block = layer.blocks.data() + layer.blocks.size() - block_size;
+                for (size_t j = row_begin; j < row_end; ++j) {
+                    std::copy(weights + j * view.stride + col_begin, weights + j * view.stride + col_end,
+                              block + (j - row_begin) * BSR_BLOCK_COLS);
+                }
+                layer.block_cols.push_back(static_cast<uint32_t>(col_begin));
+                ++num_stored_blocks;
+            }
+            layer.row_offsets.push_back(static_cast<uint32_t>(layer.block_cols.size()));
+        }
+
+        scratch_size = std::max({scratch_size, round_up(cols, BSR_BLOCK_COLS), layer.block_rows * BSR_BLOCK_ROWS});
+        layers.push_back(std::move(layer));
+    }
+}
+
+/**
+ * @brief One bsr_gemv per layer between two thread-local buffers padded to whole blocks.
+ * The features are staged only when the last tile column would read past them; the padding
+ * after every layer's outputs is cleared so the next layer's edge tiles read zeros.
+ */
+void SparseModel::forward(const real_t *features, real_t *outputs) const {
+    thread_local AlignedVector<real_t> buffers[2];
+    for (AlignedVector<real_t> &buffer : buffers) {
+        if (buffer.size() < scratch_size) {
+            buffer.assign(scratch_size, 0.0);
+        }
+    }
+
+    const real_t *inputs = features;
+    size_t input_size = static_cast<size_t>(layers.front().input_size);
+    if (input_size % BSR_BLOCK_COLS != 0) {
+        std::copy(features, features + input_size, buffers[1].data());
+        std::fill(buffers[1].begin() + input_size, buffers[1].begin() + round_up(input_size, BSR_BLOCK_COLS), real_t(0));
+        inputs = buffers[1].data();
+    }
+    for (size_t l = 0; l < layers.size(); ++l) {
+        const SparseLayer &layer = layers[l];
+        size_t width = static_cast<size_t>(layer.layer_size);
+        real_t *values = l + 1 == layers.size() ? outputs : buffers[l % 2].data();
+        if (l + 1 == layers.size() && width % BSR_BLOCK_ROWS != 0) {
+            values = buffers[l % 2].data();  // the caller's array has no room for the padding rows
+        }
+        linalg::bsr_gemv(layer.block_rows, layer.row_offsets.data(), layer.block_cols.data(), layer.blocks.data(),
+                         inputs, values);
+        activation::forward(layer.activation, values, 1, width, layer.biases.data());
+        if (l + 1 == layers.size()) {
+            if (values != outputs) {
+                std::copy(values, values + width, outputs);
+            }
+            break;
+        }
+        std::fill(values + width, values + round_up(width, BSR_BLOCK_COLS), real_t(0));
+        inputs = values;
+    }
+}
+
+int SparseModel::predict(const real_t *features) const {
+    thread_local std::vector<real_t> outputs;
+    outputs.resize(static_cast<size_t>(layers.back().layer_size));
+    forward(features, outputs.data());
+    return static_cast<int>(std::max_element(outputs.begin(), outputs.end()) - outputs.begin());
+}
+
+int SparseModel::predict(DataPoint *data_point) const {
+    return predict(data_point->get_normalized_feature_vector()->data());
+}
+
+double SparseModel::evaluate(const std::vector<DataPoint *> &samples) const {
+    double num_correct = 0.0;
+    for (DataPoint *data_point : samples) {
+        if (predict(data_point) == data_point->get_label()) {
+            ++num_correct;
+        }
+    }
+    return samples.empty() ? 0.0 : num_correct / static_cast<double>(samples.size());
+}
+
+/**
+ * @brief Times one pass over the samples with each model, the dense one through an InferenceContext.
+ */
+SparsityReport SparseModel::compare(std::shared_ptr<const CompiledModel> reference,
+                                    const std::vector<DataPoint *> &samples) const {
+    InferenceContext context(reference);
+    double num_correct = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (DataPoint *data_point : samples) {
+        if (context.predict(data_point) == data_point->get_label()) {
+            ++num_correct;
+        }
+    }
+    double dense_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    double sparse_accuracy = evaluate(samples);
+    double sparse_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double count = samples.empty() ? 1.0 : static_cast<double>(samples.size());
+    SparsityReport report;
+    report.dense_accuracy = samples.empty() ? 0.0 : num_correct / count;
+    report.sparse_accuracy = sparse_accuracy;
+    report.accuracy_delta = report.sparse_accuracy - report.dense_accuracy;
+    report.sparsity = sparsity();
+    report.block_density = num_blocks == 0 ? 0.0 : static_cast<double>(num_stored_blocks) / num_blocks;
+    report.dense_bytes = 0;
+    for (size_t l = 0; l < reference->num_layers(); ++l) {
+        const CompiledModel::LayerView &view = reference->layer(l);
+        report.dense_bytes += static_cast<size_t>(view.layer_size) * (view.input_size + 1) * sizeof(real_t);
+    }
+    report.sparse_bytes = parameter_bytes();
+    report.dense_ns = 1e9 * dense_seconds / count;
+    report.sparse_ns = 1e9 * sparse_seconds / count;
+    return report;
+}
+
+size_t SparseModel::parameter_bytes() const {
+    size_t bytes = 0;
+    for (const SparseLayer &layer : layers) {
+        bytes += layer.blocks.size() * sizeof(real_t) + layer.biases.size() * sizeof(real_t);
+        bytes += (layer.row_offsets.size() + layer.block_cols.size()) * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+double SparseModel::sparsity() const {
+    return num_weights == 0 ? 0.0 : static_cast<double>(num_zeros) / num_weights;
+}
@@ -0,0 +1,45 @@
+#include "workspace.hpp"
+
+Workspace::Workspace(const std::vector<Layer *> &layers, size_t capacity) {
+    configure(layers, capacity);
+}
+
+void Workspace::configure(const std::vector<Layer *> &layers, size_t capacity) {
+    this->capacity = capacity;
+    input_size = layers.empty() ? 0 : static_cast<size_t>(layers.front()->input_size);
+    inputs.assign(capacity * input_size, 0.0);
+
+    widths.clear();
+    activations.clear();
+    deltas.clear();
+    for (const Layer *layer : layers) {
+        size_t width = static_cast<size_t>(layer->layer_size);
+        widths.push_back(width);
+        activations.emplace_back(capacity * width, 0.0);
+        deltas.emplace_back(capacity * width, 0.0);
+    }
+}
+
+size_t Workspace::get_capacity() const {
+    return capacity;
+}
+
+real_t *Workspace::input(size_t row) {
+    return inputs.data() + row * input_size;
+}
+
+real_t *Workspace::activation(size_t layer, size_t row) {
+    return activations[layer].data() + row * widths[layer];
+}
+
+const real_t *Workspace::activation(size_t layer, size_t row) const {
+    return activations[layer].data() + row * widths[layer];
+}
+
+real_t *Workspace::delta(size_t layer, size_t row) {
+    return deltas[layer].data() + row * widths[layer];
+}
+
+const real_t *Workspace::output(size_t row) const {
+    return activation(activations.size() - 1, row);
+}
@@ -1,6 +1,10 @@
+#include <chrono>
 #include <iostream>
 #include <vector>
 #include "data_handler.hpp"
+#include "fixed_network.hpp"
+#include "inference_pipeline.hpp"
+#include "instrumentation.hpp"
 #include "neural_network.hpp"
 
 int main() {
@@ -41,15 +45,32 @@ int main() {
     std::vector<int> hidden_layers = {10, 10};
     auto input_size = static_cast<int>(vec_ptr->size());
     auto output_size = dh->get_class_count();
-    double learning_rate = 0.1;
+    double learning_rate = 0.01;
+    Activation hidden_activation = Activation::RELU;
+    Activation output_activation = Activation::SOFTMAX;  // trained with cross-entropy
+    int batch_size = 1;  // > 1 trains on GEMM-based mini-batches (gradients are averaged, so scale learning_rate up)
+    unsigned num_threads = 1;  // 0 = all cores; each mini-batch is sharded across the threads
 
     // Instantiate neural network
-    NeuralNetwork* nn = new NeuralNetwork(hidden_layers, input_size, output_size, learning_rate);
+    NeuralNetwork* nn = new NeuralNetwork(hidden_layers, input_size, output_size, learning_rate,
+                                          hidden_activation, output_activation);
 
     // Set datasets
     nn->set_training_data(training_set);
     nn->set_validation_data(dh->get_validation_set());
     nn->set_test_data(dh->get_test_set());
+    nn->set_batch_size(batch_size);
+    nn->set_num_threads(num_threads);
+
+    // Nesterov momentum
+    OptimizerConfig optimizer;
+    optimizer.type = OptimizerType::NESTEROV;
+    nn->set_optimizer(optimizer);
+#if defined(MNIST)
+    // Stop once validation accuracy and loss stall and keep the best epoch's weights; Iris has
+    // too few validation samples to stop on
+    nn->set_early_stopping(5);
+#endif
 
     // Train the model
     nn->train(15);
@@ -60,6 +81,113 @@ int main() {
     // Test the model
     std::cout << "Test Performance: " << nn->test() << std::endl;
 
+    // Persist the trained weights and serve from the mapped file: one InferenceContext per thread,
+    // weights shared. Loading maps the model file and uses its weights in place.
+#if defined(MNIST)
+    const char *model_path = "bin/mnist_model.rtml";
+#else
+    const char *model_path = "bin/iris_model.rtml";
+#endif
+    std::shared_ptr<const CompiledModel> model;
+    if (nn->save(model_path)) {
+        model = CompiledModel::load(model_path);
+    }
+    if (!model) {
+        model = nn->compile();
+    }
+    InferenceContext context(model);
+    double num_correct = 0.0;
+    for (DataPoint *data_point : *dh->get_test_set()) {
+        if (context.predict(data_point) == data_point->get_label()) {
+            ++num_correct;
+        }
+    }
+    std::cout << "Loaded Model Test Performance: " << num_correct / dh->get_test_set()->size() << std::endl;
+
+    // Stream the test set through the layers split across two pinned worker threads
+    InferencePipeline pipeline(model, 2);
+    std::vector<DataPoint *> &test_set = *dh->get_test_set();
+    std::vector<real_t> test_features;
+    test_features.reserve(test_set.size() * input_size);
+    for (DataPoint *data_point : test_set) {
+        test_features.insert(test_features.end(), data_point->get_normalized_feature_vector()->begin(),
+                             data_point->get_normalized_feature_vector()->end());
+    }
+    std::vector<int> labels(test_set.size());
+    pipeline.predict_stream(test_features.data(), test_set.size(), static_cast<size_t>(input_size), labels.data());
+    num_correct = 0.0;
+    for (size_t i = 0; i < test_set.size(); ++i) {
+        if (labels[i] == test_set[i]->get_label()) {
+            ++num_correct;
+        }
+    }
+    std::cout << "Pipelined Model Test Performance: " << num_correct / test_set.size() << std::endl;
+
+    // Same weights in a network whose topology is fixed at compile time (input, hidden_layers, classes)
+#if defined(MNIST)
+    typedef FixedNetwork<784, 10, 10, 10> EdgeNetwork;
+#else
+    typedef FixedNetwork<4, 10, 10, 3> EdgeNetwork;
+#endif
+    std::unique_ptr<EdgeNetwork> fixed(new EdgeNetwork());
+    if (fixed->load(*model)) {
+        num_correct = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (DataPoint *data_point : *dh->get_test_set()) {
+            if (fixed->predict(data_point) == data_point->get_label()) {
+                ++num_correct;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Fixed Network Test Performance: " << num_correct / dh->get_test_set()->size() << " ("
+                  << 1e9 * seconds / dh->get_test_set()->size() << " ns/prediction)" << std::endl;
+    }
+
+#if defined(MNIST) // Int8 inference straight from raw pixels
+    for (QuantizationGranularity granularity : {QuantizationGranularity::PER_LAYER, QuantizationGranularity::PER_CHANNEL}) {
+        std::shared_ptr<const QuantizedModel> quantized =
+            nn->quantize(dh->get_feature_mins(), dh->get_feature_maxs(), granularity);
+        std::cout << (granularity == QuantizationGranularity::PER_LAYER ? "Per-layer" : "Per-channel")
+                  << " int8 quantization:" << std::endl;
+        quantized->compare(model, *dh->get_test_set()).print();
+    }
+
+    // Prune 90% of the first layer in BSR tiles with fine-tuning, then serve it block-sparse
+    PruningConfig pruning;
+    pruning.target_sparsity = 0.9;
+    pruning.max_accuracy_loss = 0.02;
+    nn->prune(pruning);
+    nn->compile_sparse()->compare(nn->compile(), *dh->get_test_set()).print();
+
+    // Convolutional network: 8 5x5 filters and 2x2 max pooling in front of the output layer
+    NeuralNetwork* cnn = new NeuralNetwork({1, 28, 28}, {FeatureLayerSpec::convolution(8, 5), FeatureLayerSpec::max_pool(2)},
+                                           {}, output_size, learning_rate, hidden_activation, output_activation);
+    cnn->set_training_data(training_set);
+    cnn->set_validation_data(dh->get_validation_set());
+    cnn->set_test_data(dh->get_test_set());
+    cnn->train(2);
+    std::cout << "Convolutional Network Test Performance: " << cnn->test() << std::endl;
+    delete cnn;
+#endif
+
+    // Keep learning online from labeled feedback (here the training set in micro-batches) while a
+    // serving context follows the published weights
+    nn->start_online();
+    InferenceContext live(nn->get_publisher());
+    nn->learn(*training_set);
+    num_correct = 0.0;
+    for (DataPoint *data_point : *dh->get_test_set()) {
+        if (live.predict(data_point) == data_point->get_label()) {
+            ++num_correct;
+        }
+    }
+    std::cout << "Online Learning Test Performance: " << num_correct / dh->get_test_set()->size() << std::endl;
+
+    // Per-phase timings and counters of an instrumented build (make INSTRUMENT=1)
+    if (instrumentation::enabled) {
+        instrumentation::save("bin/instrumentation.json");
+    }
+
     // Cleanup
     delete nn;
     delete dh;
@@ -0,0 +1,76 @@
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include "benchmark.hpp"
+#include "data_handler.hpp"
+#include "kmeans.hpp"
+#include "mini_batch_kmeans.hpp"
+#include "nearest_centroid.hpp"
+
+// Benchmarks of seeding, the three assignment strategies and serving, on generated MNIST-sized data
+int main(int argc, char **argv) {
+    const std::string output = argc > 1 ? argv[1] : "bin/bench.json";
+    const std::string images = "bin/bench-images.idx", labels = "bin/bench-labels.idx";
+    if (!synthetic::write_idx(images, labels, 6000, 28, 28, 10)) {
+        return 1;
+    }
+    srand(1);
+    DataHandler *dh = new DataHandler();
+    dh->read_input_data(images);
+    dh->read_label_data(labels);
+    dh->count_classes();
+    dh->normalize();
+    dh->split_data();
+    std::vector<DataPoint *> &training_set = *dh->get_training_set();
+    std::vector<DataPoint *> &test_set = *dh->get_test_set();
+    const int k = 64;
+    Benchmark bench("kmeans");
+
+    bench.run("init_plus_plus", [&]() {
+        KMeans model(k);
+        model.set_training_data(&training_set);
+        model.init_clusters_plus_plus();
+    }, training_set.size());
+
+    // One full assignment pass (plus the centroid update) per call
+    srand(2);
+    KMeans pass_model(k);
+    pass_model.set_training_data(&training_set);
+    pass_model.init_clusters_plus_plus();
+    bench.run("assign_pass", [&]() { pass_model.fit(1, KMeansAlgorithm::LLOYD); }, training_set.size());
+
+    // Whole fits from the same seeds, where the bounds of Hamerly and Elkan skip most distances
+    const struct {
+        const char *name;
+        KMeansAlgorithm algorithm;
+    } strategies[] = {{"fit_lloyd", KMeansAlgorithm::LLOYD},
+                      {"fit_hamerly", KMeansAlgorithm::HAMERLY},
+                      {"fit_elkan", KMeansAlgorithm::ELKAN}};
+    std::unique_ptr<KMeans> fit_model;
+    for (const auto &strategy : strategies) {
+        bench.run_with_setup(strategy.name, [&]() {
+            srand(2);
+            fit_model.reset(new KMeans(k));
+            fit_model->set_training_data(&training_set);
+            fit_model->init_clusters_plus_plus();
+        }, [&]() { fit_model->fit(100, strategy.algorithm); }, training_set.size());
+    }
+
+    KMeans model(k);
+    model.set_training_data(&training_set);
+    model.init_clusters_plus_plus();
+    model.fit(20);
+    NearestCentroidClassifier classifier = model.classifier();
+    std::vector<int> clusters;
+    size_t query = 0;
+    bench.run("classifier_predict", [&]() {
+        do_not_optimize(classifier.predict(test_set[query++ % test_set.size()]->get_normalized_feature_vector()->data()));
+    });
+    bench.run("classifier_predict_batch", [&]() { classifier.predict_batch(test_set, clusters); }, test_set.size());
+
+    MiniBatchKMeans stream(k);
+    bench.run("mini_batch_push", [&]() { stream.push(training_set[query++ % training_set.size()]); });
+
+    delete dh;
+    return bench.save(output) ? 0 : 1;
+}
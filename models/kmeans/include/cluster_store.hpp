@@ -0,0 +1,143 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "data_point.hpp"
+
+/**
+ * @brief Flat storage for every cluster of a K-Means model.
+ *
+ * Centroids, running sums and label histograms live in contiguous row-major k x dim and
+ * k x classes matrices, so adding a point costs O(dim) with no per-point allocations.
+ * Cluster membership is optional and kept as one cluster index per training point.
+ */
+class ClusterStore {
+private:
+    size_t dim = 0;
+    size_t num_classes = 0;
+
+    /**
+     * @brief Row-major k x dim centroid matrix.
+     */
+    std::vector<real_t> centroids;
+
+    /**
+     * @brief Row-major k x dim running feature sums of the members (double, so long
+     * streams of float features do not lose precision).
+     */
+    std::vector<double> sums;
+
+    /**
+     * @brief Number of members per cluster.
+     */
+    std::vector<uint32_t> counts;
+
+    /**
+     * @brief Row-major k x num_classes label histogram.
+     */
+    std::vector<uint32_t> histogram;
+
+    /**
+     * @brief Most frequent label per cluster (-1 while the cluster has no members).
+     */
+    std::vector<int> labels;
+
+    /**
+     * @brief Cluster index per training point (-1 if unassigned); empty unless enabled.
+     */
+    std::vector<int> assignment;
+
+public:
+    /**
+     * @brief Drops all clusters and sets the feature dimension and number of label values.
+     * @param dim Feature dimension.
+     * @param num_classes Labels must lie in [0, num_classes).
+     */
+    void configure(size_t dim, size_t num_classes);
+
+    /**
+     * @brief Starts recording the cluster of every added point.
+     * @param num_points Number of points that can be indexed.
+     */
+    void enable_membership(size_t num_points);
+
+    /**
+     * @brief Adds a new cluster whose only member (and centroid) is the given point.
+     * @param initial_point Pointer to the initial data point.
+     * @param index Index of the point for membership tracking (-1 to skip).
+     * @return Index of the new cluster.
+     */
+    size_t add_cluster(DataPoint *initial_point, int index = -1);
+
+    /**
+     * @brief Adds a new empty cluster with the given centroid.
+     * @param values Pointer to `dim` centroid values.
+     * @return Index of the new cluster.
+     */
+    size_t add_centroid(const real_t *values);
+
+    /**
+     * @brief Adds a point to a cluster and moves its centroid to the new mean in O(dim).
+     * @param cluster Cluster index.
+     * @param point Pointer to the data point.
+     * @param index Index of the point for membership tracking (-1 to skip).
+     */
+    void add_point(size_t cluster, DataPoint *point, int index = -1);
+
+    /**
+     * @brief Overwrites a centroid without touching the members.
+     * @param cluster Cluster index.
+     * @param values Pointer to `dim` centroid values.
+     */
+    void set_centroid(size_t cluster, const real_t *values);
+
+    /**
+     * @brief Removes every member but keeps the centroids.
+     */
+    void clear_members();
+
+    /**
+     * @brief Returns the number of clusters.
+     * @return Number of clusters.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Returns the feature dimension.
+     * @return Feature dimension (0 until configured).
+     */
+    size_t dimension() const;
+
+    /**
+     * @brief Returns a pointer to a centroid row.
+     * @param cluster Cluster index.
+     * @return Pointer to `dim` centroid values.
+     */
+    const real_t *centroid(size_t cluster) const;
+
+    /**
+     * @brief Returns the row-major k x dim centroid matrix.
+     * @return Centroid matrix.
+     */
+    const std::vector<real_t> &centroid_matrix() const;
+
+    /**
+     * @brief Returns the number of members of a cluster.
+     * @param cluster Cluster index.
+     * @return Member count.
+     */
+    uint32_t count(size_t cluster) const;
+
+    /**
+     * @brief Returns the most frequent label of a cluster.
+     * @param cluster Cluster index.
+     * @return Label, or -1 if the cluster has no members.
+     */
+    int most_frequent_class(size_t cluster) const;
+
+    /**
+     * @brief Returns the cluster index of every tracked point.
+     * @return Assignment array (empty unless membership is enabled).
+     */
+    const std::vector<int> &get_assignment() const;
+};
@@ -1,9 +1,25 @@
 #pragma once
 
+#include <cstdint>
+#include <random>
 #include <vector>
 #include <unordered_set>
 #include "data_set.hpp"
-#include "cluster.hpp"
+#include "cluster_store.hpp"
+#include "nearest_centroid.hpp"
+
+/**
+ * @brief Assignment strategy used by KMeans::fit.
+ *
+ * All strategies produce the same assignments as plain Lloyd's iterations; the accelerated
+ * ones keep per-point distance bounds and skip distance computations the triangle
+ * inequality proves unnecessary.
+ */
+enum class KMeansAlgorithm {
+    LLOYD,    ///< Every point-to-centroid distance on every iteration.
+    HAMERLY,  ///< One upper and one lower bound per point; O(n) extra memory, suited for large k.
+    ELKAN     ///< One lower bound per point and centroid; O(n * k) extra memory, suited for small k.
+};
 
 /**
  * @brief Implements the K-Means clustering algorithm for unsupervised learning.
@@ -16,22 +32,46 @@ private:
     int num_clusters;
 
     /**
-     * @brief Pointer to the clusters (cluster_t structs).
+     * @brief Flat storage of centroids, running sums and label histograms.
+     */
+    ClusterStore clusters;
+
+    /**
+     * @brief Whether the cluster store records the cluster of every training point.
      */
-    std::vector<cluster_t *> *clusters;
+    bool track_membership = false;
 
     /**
      * @brief Set of indexes used to avoid duplicate initial clusters.
      */
     std::unordered_set<int> *used_indexes;
 
+    /**
+     * @brief Random source of the seeding methods. Each model owns one, so models can be
+     * seeded on different threads at once.
+     */
+    std::mt19937 random_engine;
+
+    /**
+     * @brief Draws an index uniformly from [0, n).
+     * @param n Number of choices (positive).
+     * @return Index.
+     */
+    size_t random_index(size_t n);
+
+    /**
+     * @brief Draws a number uniformly from [0, 1).
+     * @return Random number.
+     */
+    double uniform_random();
+
     /**
      * @brief Calculates Euclidean distance between a centroid and a data point.
-     * @param centroid Vector of centroid values.
+     * @param centroid Pointer to the centroid values.
      * @param point Pointer to the data point.
      * @return The Euclidean distance.
      */
-    double euclidean_distance(const std::vector<double> &centroid, DataPoint *point) const;
+    double euclidean_distance(const real_t *centroid, DataPoint *point) const;
 
     /**
      * @brief Predicts the cluster index for a given data point.
@@ -40,34 +80,122 @@ private:
      */
     int predict(DataPoint *point) const;
 
+    /**
+     * @brief Picks `count` new centroids from `pool` by D^2 (k-means++) sampling.
+     *
+     * Each candidate is chosen with probability proportional to weight * D(x)^2, where
+     * D(x) is the distance to the closest centroid chosen so far. Distance updates run
+     * in parallel over chunks of the pool.
+     *
+     * @param pool Training set indexes to sample from.
+     * @param weights Optional per-pool-entry weights (nullptr for uniform weights).
+     * @param count Number of centroids to add.
+     * @param trials Draws per centroid; with more than one, the draw that lowers the total
+     *               weighted D^2 the most is kept (greedy k-means++).
+     */
+    void seed_by_distance(const std::vector<int> &pool, const std::vector<double> *weights, int count, int trials = 1);
+
+    /**
+     * @brief Sizes the cluster store from the training data (dimension and label range).
+     */
+    void configure_store();
+
+    /**
+     * @brief Adds the training point at the given index as a new cluster centroid.
+     * @param index Index into the training set.
+     */
+    void add_seed(int index);
+
 public:
     /**
      * @brief Constructs a KMeans object with the specified number of clusters.
+     * The seeding methods draw from an engine seeded with rand(), so srand() still fixes them.
      * @param k Number of clusters.
      */
     explicit KMeans(int k);
 
+    /**
+     * @brief Constructs a KMeans object whose seeding methods use their own seed; does not
+     * touch rand(), so it is safe on any thread.
+     * @param k Number of clusters.
+     * @param seed Seed of the model's random engine.
+     */
+    KMeans(int k, uint32_t seed);
+
     /**
      * @brief Initializes centroids by randomly selecting points from the dataset.
      */
     void init_clusters();
 
+    /**
+     * @brief Initializes centroids with k-means++ seeding (D^2 sampling).
+     */
+    void init_clusters_plus_plus();
+
+    /**
+     * @brief Initializes centroids with scalable k-means|| seeding.
+     *
+     * Runs a few oversampling rounds that each add about `oversampling * k` candidates,
+     * weights every candidate by the number of points closest to it, and then reduces
+     * the candidates to k centroids with weighted k-means++.
+     *
+     * @param oversampling Oversampling factor l / k (expected candidates per round).
+     * @param rounds Number of oversampling rounds.
+     */
+    void init_clusters_parallel(double oversampling = 2.0, int rounds = 5);
+
+    /**
+     * @brief Initializes centroids from a previous (usually smaller) solution.
+     *
+     * Copies up to k centroids of `previous` and greedily D^2-samples the remaining ones
+     * against them, so a following fit() only has to settle the new clusters.
+     *
+     * @param previous Trained model to start from.
+     */
+    void warm_start(const KMeans &previous);
+
     /**
      * @brief Initializes clusters so that each unique class in training data gets one cluster.
      */
     void init_clusters_for_each_class();
 
     /**
-     * @brief Returns the pointer to clusters.
-     * @return Pointer to vector of cluster_t pointers.
+     * @brief Records the cluster index of every training point in the cluster store.
+     * @param enabled Whether membership is tracked (takes effect at the next initialization).
+     */
+    void set_track_membership(bool enabled);
+
+    /**
+     * @brief Returns the cluster store.
+     * @return Centroids, counts and labels of every cluster.
      */
-    std::vector<cluster_t *> *get_clusters() const;
+    const ClusterStore &get_clusters() const;
 
     /**
      * @brief Executes the K-Means clustering algorithm.
      */
     void train();
 
+    /**
+     * @brief Runs batch (Lloyd's) iterations from the current centroids until no assignment changes.
+     *
+     * Seeds with k-means++ if no clusters have been initialized. On return every training
+     * point is a member of the cluster with the closest centroid. If max_iterations is reached
+     * before convergence, the centroids are the ones of the last assignment pass and are not
+     * moved to the means of their new members.
+     *
+     * @param max_iterations Upper bound on the number of assignment passes (at least 1).
+     * @param algorithm Assignment strategy (results are identical, only the cost differs).
+     * @return Number of assignment passes performed.
+     */
+    int fit(int max_iterations = 100, KMeansAlgorithm algorithm = KMeansAlgorithm::HAMERLY);
+
+    /**
+     * @brief Builds a batched nearest-centroid classifier from the current clusters.
+     * @return Immutable classifier that is safe to share between threads.
+     */
+    NearestCentroidClassifier classifier() const;
+
     /**
      * @brief Validates the model on the validation set.
      * @return Accuracy score in the range [0.0, 1.0].
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include "data_set.hpp"
+
+/**
+ * @brief Point-in-time copy of a MiniBatchKMeans model.
+ */
+struct CentroidSnapshot {
+    size_t num_clusters = 0;           ///< Number of centroids.
+    size_t dim = 0;                    ///< Feature dimension.
+    std::vector<real_t> centroids;     ///< Row-major num_clusters x dim centroid matrix.
+    std::vector<int> labels;           ///< Most frequent class per centroid (-1 if none seen).
+
+    /**
+     * @brief Returns the index of the closest centroid.
+     * @param features Pointer to `dim` feature values.
+     * @return Centroid index.
+     */
+    int nearest(const real_t *features) const;
+};
+
+/**
+ * @brief Mini-batch K-Means (Sculley, 2010) for clustering a live data stream.
+ *
+ * Points are buffered into fixed-size batches. Each batch is assigned to the current
+ * centroids and then every point pulls its centroid towards itself with a per-centroid
+ * learning rate of 1 / (points seen by that centroid), so the cost of an update is
+ * proportional to the batch size and memory stays bounded by k x dim plus one batch.
+ *
+ * Updates must come from a single thread; snapshot(), predict() and validation may run
+ * concurrently from any number of threads while updates continue.
+ */
+class MiniBatchKMeans : public DataSet {
+private:
+    int num_clusters;
+    size_t batch_size;
+    size_t dim = 0;
+    bool initialized = false;
+
+    /**
+     * @brief Lower bound on the per-centroid learning rate (0 = exact running mean).
+     */
+    double min_learning_rate = 0.0;
+
+    /**
+     * @brief Row-major num_clusters x dim centroid matrix.
+     */
+    std::vector<real_t> centroids;
+
+    /**
+     * @brief Number of points each centroid has absorbed.
+     */
+    std::vector<double> counts;
+
+    /**
+     * @brief Row-major num_clusters x 256 histogram of uint8_t labels.
+     */
+    std::vector<uint32_t> label_counts;
+
+    /**
+     * @brief Points buffered until the next batch is full.
+     */
+    std::vector<DataPoint *> pending;
+
+    /**
+     * @brief Scratch assignment buffer reused across batches.
+     */
+    std::vector<int> batch_assignment;
+
+    /**
+     * @brief Guards centroid writes against concurrent snapshots.
+     */
+    mutable std::mutex centroid_mutex;
+
+    /**
+     * @brief Seeds centroids from the buffered points with k-means++.
+     */
+    void seed_from_pending();
+
+    /**
+     * @brief Assigns and applies the buffered batch, then clears the buffer.
+     */
+    void process_pending();
+
+    /**
+     * @brief Returns the most frequent label of a centroid (caller holds the lock).
+     * @param cluster Centroid index.
+     * @return Label, or -1 if the centroid has no points yet.
+     */
+    int most_frequent_class(size_t cluster) const;
+
+    /**
+     * @brief Computes accuracy of the current model on a data set.
+     * @param data_set Points to classify.
+     * @return Accuracy in the range [0, 100].
+     */
+    double evaluate(const std::vector<DataPoint *> &data_set) const;
+
+public:
+    /**
+     * @brief Constructs a mini-batch K-Means model.
+     * @param k Number of clusters.
+     * @param batch_size Number of points per update.
+     */
+    explicit MiniBatchKMeans(int k, size_t batch_size = 256);
+
+    /**
+     * @brief Sets a floor on the per-centroid learning rate so centroids keep tracking drift.
+     * @param rate Minimum learning rate in [0, 1].
+     */
+    void set_min_learning_rate(double rate);
+
+    /**
+     * @brief Adds a single point to the stream; a batch update runs whenever the buffer fills.
+     * @param point Pointer to the data point (must outlive the next update).
+     */
+    void push(DataPoint *point);
+
+    /**
+     * @brief Adds every point of a range to the stream.
+     * @tparam Iterator Any input iterator whose value type converts to DataPoint*.
+     * @param first Beginning of the range.
+     * @param last End of the range.
+     */
+    template <typename Iterator>
+    void partial_fit(Iterator first, Iterator last) {
+        for (; first != last; ++first) {
+            push(*first);
+        }
+    }
+
+    /**
+     * @brief Applies a partially filled batch immediately.
+     */
+    void flush();
+
+    /**
+     * @brief Streams the training set through the model in shuffled mini-batches.
+     * @param num_epochs Number of passes over the training set.
+     */
+    void train(int num_epochs = 1);
+
+    /**
+     * @brief Copies the current centroids and labels; safe while updates continue.
+     * @return Snapshot of the model.
+     */
+    CentroidSnapshot snapshot() const;
+
+    /**
+     * @brief Predicts the class of a data point with the current centroids.
+     * @param point Pointer to the data point.
+     * @return Most frequent class of the closest centroid.
+     */
+    int predict(DataPoint *point) const;
+
+    /**
+     * @brief Validates the model on the validation set.
+     * @return Accuracy score in the range [0, 100].
+     */
+    double validate() const;
+
+    /**
+     * @brief Tests the model on the test set.
+     * @return Accuracy score in the range [0, 100].
+     */
+    double test() const;
+};
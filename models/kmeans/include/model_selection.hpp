@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include "data_set.hpp"
+
+class KMeans;
+class NearestCentroidClassifier;
+
+/**
+ * @brief Validation accuracy of a K-Means model with k clusters.
+ */
+struct KScore {
+    int k;            ///< Number of clusters.
+    double accuracy;  ///< Validation accuracy in the range [0, 100].
+};
+
+/**
+ * @brief Chooses the number of clusters for KMeans while reusing work across k.
+ *
+ * Every sweep returns a validation-accuracy-per-k curve. The bisecting sweep produces
+ * every k from one split tree, the warm-start sweep grows each solution from the previous
+ * one, and the parallel sweep fits independent candidates on all cores. Every sweep can
+ * hand back the winner, so the model that was scored is the one that gets deployed.
+ */
+class KMeansModelSelection : public DataSet {
+private:
+    /**
+     * @brief Upper bound on Lloyd's iterations per fit or split.
+     */
+    int max_iterations;
+
+public:
+    /**
+     * @brief Constructs a model selector.
+     * @param max_iterations Upper bound on Lloyd's iterations per fit or split.
+     */
+    explicit KMeansModelSelection(int max_iterations = 20);
+
+    /**
+     * @brief Bisecting K-Means: repeatedly splits the cluster with the largest SSE in two.
+     *
+     * Each split yields the (k + 1)-clustering, so one pass scores every k in
+     * [k_min, k_max]. Validation assignments are updated incrementally per split.
+     *
+     * @param k_min Smallest k to report.
+     * @param k_max Largest k to report.
+     * @param best_model If not null, receives the leaves of the entry best() picks as a
+     *                   classifier; the caller deletes it.
+     * @return Validation accuracy per k, in increasing k.
+     */
+    std::vector<KScore> bisecting_sweep(int k_min, int k_max, NearestCentroidClassifier **best_model = nullptr);
+
+    /**
+     * @brief Fits k_min from k-means++ seeds, then warm-starts each k + step from the previous solution.
+     * @param k_min Smallest k.
+     * @param k_max Largest k.
+     * @param step Increment between consecutive k.
+     * @param best_model If not null, receives the model of the entry best() picks; the caller deletes it.
+     * @return Validation accuracy per k, in increasing k.
+     */
+    std::vector<KScore> warm_start_sweep(int k_min, int k_max, int step = 1, KMeans **best_model = nullptr);
+
+    /**
+     * @brief Fits each candidate k independently, spreading the candidates across the shared ThreadPool.
+     *
+     * Every candidate is seeded from its own engine, whose seed is drawn with rand() in
+     * candidate order before the fits start, so results do not depend on the schedule.
+     * With best_model, every fitted model is kept until the sweep returns.
+     *
+     * @param candidates Values of k to evaluate.
+     * @param num_threads Most candidates fitted at once on the shared ThreadPool (0 = its size).
+     * @param best_model If not null, receives the model of the entry best() picks; the caller deletes it.
+     * @return Validation accuracy per candidate, in the order given.
+     */
+    std::vector<KScore> parallel_sweep(const std::vector<int> &candidates, unsigned num_threads = 0,
+                                       KMeans **best_model = nullptr);
+
+    /**
+     * @brief Returns the entry with the highest accuracy (the earliest one on ties).
+     * @param curve Accuracy-per-k curve.
+     * @return Best entry, or {0, 0.0} for an empty curve.
+     */
+    static KScore best(const std::vector<KScore> &curve);
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "data_point.hpp"
+#include "cluster_store.hpp"
+#include "model_file.hpp"
+
+/**
+ * @brief Immutable nearest-centroid classifier for batched inference.
+ *
+ * Scores queries against all centroids as ||c||^2 - 2 q.c, where the q.c terms of a tile
+ * of queries come from one blocked GEMM call and the argmin is vectorized. Every method is
+ * const and keeps its scratch on the calling thread, so one instance can serve any number
+ * of threads. A classifier loaded from a file reads its centroids in place in the mapping.
+ */
+class NearestCentroidClassifier {
+private:
+    size_t num_centroids = 0;
+    size_t dim = 0;
+
+    /**
+     * @brief Row-major num_centroids x dim centroid matrix (when built in memory).
+     */
+    std::vector<real_t> centroids;
+
+    /**
+     * @brief Squared norm of every centroid (when built in memory).
+     */
+    std::vector<real_t> norms;
+
+    /**
+     * @brief Class assigned to every centroid, -1 if unknown (when built in memory).
+     */
+    std::vector<int> labels;
+
+    /**
+     * @brief Mapping that holds the arrays when the classifier was loaded from a file.
+     */
+    std::shared_ptr<const MappedModelFile> file;
+
+    /**
+     * @brief Centroid matrix, norms and labels, in the vectors above or in the mapped file.
+     */
+    const real_t *centroid_data;
+    const real_t *norm_data;
+    const int *label_data;
+
+    /**
+     * @brief Worker threads used by batch calls (1 = calling thread only).
+     */
+    unsigned num_threads;
+
+    /**
+     * @brief Finds the closest centroid for a tile of contiguous queries.
+     * @param queries Row-major count x dim queries with leading dimension stride.
+     * @param count Number of queries in the tile.
+     * @param stride Leading dimension of the queries.
+     * @param clusters Receives the closest centroid per query.
+     * @param scores Scratch buffer owned by the calling thread.
+     */
+    void predict_tile(const real_t *queries, size_t count, size_t stride, int *clusters, std::vector<real_t> &scores) const;
+
+    /**
+     * @brief Wraps validated arrays that live in a mapped file.
+     */
+    NearestCentroidClassifier(std::shared_ptr<const MappedModelFile> file, size_t num_centroids, size_t dim,
+                              const real_t *centroids, const real_t *norms, const int *labels, unsigned num_threads);
+
+public:
+    /**
+     * @brief Builds a classifier from the clusters of a trained KMeans model.
+     * @param store Cluster store with centroids and most frequent classes.
+     * @param num_threads Most shared ThreadPool threads used by batch calls (0 = all of them).
+     */
+    explicit NearestCentroidClassifier(const ClusterStore &store, unsigned num_threads = 0);
+
+    /**
+     * @brief Builds a classifier from a raw centroid matrix.
+     * @param centroids Row-major k x dim centroid matrix.
+     * @param labels Class per centroid.
+     * @param dim Feature dimension.
+     * @param num_threads Most shared ThreadPool threads used by batch calls (0 = all of them).
+     */
+    NearestCentroidClassifier(std::vector<real_t> centroids, std::vector<int> labels, size_t dim, unsigned num_threads = 0);
+
+    NearestCentroidClassifier(NearestCentroidClassifier &&) = default;
+    NearestCentroidClassifier(const NearestCentroidClassifier &) = delete;
+    NearestCentroidClassifier &operator=(const NearestCentroidClassifier &) = delete;
+
+    /**
+     * @brief Writes the centroids, their norms and labels to a model file.
+     * @param path Destination file.
+     * @return True on success.
+     */
+    bool save(const std::string &path) const;
+
+    /**
+     * @brief Maps a model file written by save() and serves its centroids in place.
+     * @param path Model file.
+     * @param num_threads Most shared ThreadPool threads used by batch calls (0 = all of them).
+     * @return Shared classifier, or nullptr if the file is missing or invalid.
+     */
+    static std::shared_ptr<const NearestCentroidClassifier> load(const std::string &path, unsigned num_threads = 0);
+
+    /**
+     * @brief Finds the closest centroid for every row of a query matrix.
+     * @param queries Row-major num_queries x dim matrix with leading dimension stride.
+     * @param num_queries Number of queries.
+     * @param stride Leading dimension of the queries (>= dim).
+     * @param clusters Receives num_queries centroid indexes.
+     */
+    void predict_batch(const real_t *queries, size_t num_queries, size_t stride, int *clusters) const;
+
+    /**
+     * @brief Finds the closest centroid for every data point.
+     * @param points Data points with normalized features.
+     * @param clusters Resized to points.size() and filled with centroid indexes.
+     */
+    void predict_batch(const std::vector<DataPoint *> &points, std::vector<int> &clusters) const;
+
+    /**
+     * @brief Finds the closest centroid for a single query.
+     * @param query Pointer to dim feature values.
+     * @return Centroid index.
+     */
+    int predict(const real_t *query) const;
+
+    /**
+     * @brief Returns the class of a centroid.
+     * @param cluster Centroid index.
+     * @return Class label (-1 if unknown).
+     */
+    int label(size_t cluster) const;
+
+    /**
+     * @brief Computes classification accuracy on a set of labeled points.
+     * @param points Data points to classify.
+     * @return Accuracy in the range [0, 100].
+     */
+    double evaluate(const std::vector<DataPoint *> &points) const;
+
+    /**
+     * @brief Returns the number of centroids.
+     * @return Number of centroids.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Returns the feature dimension.
+     * @return Feature dimension.
+     */
+    size_t dimension() const;
+};
@@ -0,0 +1,101 @@
+#include <cmath>      // for isnan
+#include <algorithm>  // for copy, fill
+#include "cluster_store.hpp"
+
+void ClusterStore::configure(size_t dim, size_t num_classes) {
+    this->dim = dim;
+    this->num_classes = num_classes;
+    centroids.clear();
+    sums.clear();
+    counts.clear();
+    histogram.clear();
+    labels.clear();
+    assignment.clear();
+}
+
+void ClusterStore::enable_membership(size_t num_points) {
+    assignment.assign(num_points, -1);
+}
+
+size_t ClusterStore::add_cluster(DataPoint *initial_point, int index) {
+    size_t cluster = add_centroid(initial_point->get_normalized_feature_vector()->data());
+    add_point(cluster, initial_point, index);
+    return cluster;
+}
+
+size_t ClusterStore::add_centroid(const real_t *values) {
+    size_t cluster = counts.size();
+    centroids.insert(centroids.end(), values, values + dim);
+    sums.resize(sums.size() + dim, 0.0);
+    counts.push_back(0);
+    histogram.resize(histogram.size() + num_classes, 0);
+    labels.push_back(-1);
+    return cluster;
+}
+
+void ClusterStore::add_point(size_t cluster, DataPoint *point, int index) {
+    const real_t *features = point->get_normalized_feature_vector()->data();
+    double *sum = &sums[cluster * dim];
+    real_t *centroid = &centroids[cluster * dim];
+    uint32_t count = ++counts[cluster];
+
+    for (size_t d = 0; d < dim; ++d) {
+        if (!std::isnan(features[d])) {
+            sum[d] += features[d];
+        }
+        centroid[d] = static_cast<real_t>(sum[d] / count);
+    }
+
+    // Keep the running argmax; ties go to the smallest label
+    int label = point->get_label();
+    uint32_t *row = &histogram[cluster * num_classes];
+    uint32_t freq = ++row[label];
+    int best = labels[cluster];
+    if (best < 0 || freq > row[best] || (freq == row[best] && label < best)) {
+        labels[cluster] = label;
+    }
+
+    if (index >= 0 && static_cast<size_t>(index) < assignment.size()) {
+        assignment[index] = static_cast<int>(cluster);
+    }
+}
+
+void ClusterStore::set_centroid(size_t cluster, const real_t *values) {
+    std::copy(values, values + dim, &centroids[cluster * dim]);
+}
+
+void ClusterStore::clear_members() {
+    std::fill(sums.begin(), sums.end(), 0.0);
+    std::fill(counts.begin(), counts.end(), 0);
+    std::fill(histogram.begin(), histogram.end(), 0);
+    std::fill(labels.begin(), labels.end(), -1);
+    std::fill(assignment.begin(), assignment.end(), -1);
+}
+
+size_t ClusterStore::size() const {
+    return counts.size();
+}
+
+size_t ClusterStore::dimension() const {
+    return dim;
+}
+
+const real_t *ClusterStore::centroid(size_t cluster) const {
+    return &centroids[cluster * dim];
+}
+
+const std::vector<real_t> &ClusterStore::centroid_matrix() const {
+    return centroids;
+}
+
+uint32_t ClusterStore::count(size_t cluster) const {
+    return counts[cluster];
+}
+
+int ClusterStore::most_frequent_class(size_t cluster) const {
+    return labels[cluster];
+}
+
+const std::vector<int> &ClusterStore::get_assignment() const {
+    return assignment;
+}
@@ -1,28 +1,553 @@
+#include "instrumentation.hpp"
 #include "kmeans.hpp"
-#include <cstdlib>      // for rand()
+#include "linalg.hpp"
+#include "thread_pool.hpp"
+#include <cstdlib>      // for rand(), exit()
 #include <cmath>        // for sqrt, pow
+#include <iostream>
 #include <limits>       // for numeric_limits
+#include <numeric>      // for iota, accumulate
+#include <algorithm>    // for min, max
 #include <unordered_set>
 
-KMeans::KMeans(int k)
+namespace {
+
+/**
+ * Points per chunk: enough work to amortize a pool task, small enough to balance the threads.
+ */
+constexpr size_t CHUNK_POINTS = 1024;
+
+/**
+ * Number of chunks a range of n points is split into. It depends on n alone, never on the
+ * thread count, so per-chunk sums are added in the same order with any RTML_THREADS.
+ */
+size_t chunk_count(size_t n) {
+    return std::max<size_t>(1, (n + CHUNK_POINTS - 1) / CHUNK_POINTS);
+}
+
+/**
+ * Run fn(chunk, begin, end) over `chunks` contiguous slices of [0, n) on the shared pool.
+ * The slicing depends only on n and `chunks`, so per-chunk partial results are reproducible.
+ */
+template <typename Fn>
+void parallel_chunks(size_t n, size_t chunks, Fn fn) {
+    size_t step = (n + chunks - 1) / chunks;
+    ThreadPool::shared().parallel_for(0, chunks, 1, [&](size_t first, size_t last) {
+        for (size_t c = first; c < last; ++c) {
+            fn(c, std::min(c * step, n), std::min((c + 1) * step, n));
+        }
+    });
+}
+
+
+/**
+ * Working state of a batch K-Means fit: flat centroids, assignments and triangle-inequality bounds.
+ */
+struct FitState {
+    size_t n = 0;
+    size_t k = 0;
+    size_t dim = 0;
+    std::vector<const real_t *> points;     // n feature rows
+    std::vector<real_t> centroids;          // k x dim
+    std::vector<int> assignment;            // n, -1 before the first pass
+    std::vector<double> upper;              // n, distance to the assigned centroid (upper bound)
+    std::vector<double> lower;              // n (Hamerly) or n x k (Elkan) lower bounds
+    std::vector<double> centroid_distances; // k x k (Elkan only)
+    std::vector<double> half_separation;    // k, half the distance to the closest other centroid
+    std::vector<double> movement;           // k, how far each centroid moved in the last update
+
+    double distance(size_t i, size_t j) const {
+        return std::sqrt(linalg::squared_distance(points[i], &centroids[j * dim], dim));
+    }
+};
+
+/**
+ * Full scan over every centroid. Ties go to the lowest index, like plain Lloyd's.
+ */
+void nearest_two(const FitState &state, size_t i, int &best, double &best_dist, double &second_dist) {
+    best = 0;
+    best_dist = std::numeric_limits<double>::max();
+    second_dist = std::numeric_limits<double>::max();
+    for (size_t j = 0; j < state.k; ++j) {
+        double dist = state.distance(i, j);
+        if (dist < best_dist) {
+            second_dist = best_dist;
+            best_dist = dist;
+            best = static_cast<int>(j);
+        } else if (dist < second_dist) {
+            second_dist = dist;
+        }
+    }
+}
+
+/**
+ * Inter-centroid distances: half the distance from each centroid to its closest neighbour,
+ * plus (for Elkan) the full k x k matrix.
+ */
+void update_centroid_separation(FitState &state, bool full_matrix) {
+    size_t k = state.k;
+    if (full_matrix) {
+        state.centroid_distances.assign(k * k, 0.0);
+    }
+    state.half_separation.assign(k, std::numeric_limits<double>::max());
+
+    parallel_chunks(k, chunk_count(k * 64), [&](size_t, size_t begin, size_t end) {
+        for (size_t a = begin; a < end; ++a) {
+            const real_t *ca = &state.centroids[a * state.dim];
+            double closest = std::numeric_limits<double>::max();
+            for (size_t b = 0; b < k; ++b) {
+                if (b == a) {
+                    continue;
+                }
+                double dist = std::sqrt(linalg::squared_distance(ca, &state.centroids[b * state.dim], state.dim));
+                if (full_matrix) {
+                    state.centroid_distances[a * k + b] = dist;
+                }
+                closest = std::min(closest, dist);
+            }
+            state.half_separation[a] = 0.5 * closest;
+        }
+    });
+}
+
+size_t assign_lloyd(FitState &state, size_t begin, size_t end) {
+    size_t changes = 0;
+    for (size_t i = begin; i < end; ++i) {
+        int best;
+        double best_dist, second_dist;
+        nearest_two(state, i, best, best_dist, second_dist);
+        if (best != state.assignment[i]) {
+            state.assignment[i] = best;
+            ++changes;
+        }
+    }
+    return changes;
+}
+
+size_t assign_hamerly(FitState &state, size_t begin, size_t end) {
+    size_t changes = 0;
+    for (size_t i = begin; i < end; ++i) {
+        int a = state.assignment[i];
+        if (a >= 0) {
+            double bound = std::max(state.half_separation[a], state.lower[i]);
+            if (state.upper[i] < bound) {
+                continue;
+            }
+            // Tighten the upper bound before paying for a full scan
+            state.upper[i] = state.distance(i, a);
+            if (state.upper[i] < bound) {
+                continue;
+            }
+        }
+
+        int best;
+        nearest_two(state, i, best, state.upper[i], state.lower[i]);
+        if (best != a) {
+            state.assignment[i] = best;
+            ++changes;
+        }
+    }
+    return changes;
+}
+
+size_t assign_elkan(FitState &state, size_t begin, size_t end) {
+    size_t k = state.k;
+    size_t changes = 0;
+    for (size_t i = begin; i < end; ++i) {
+        double *lower = &state.lower[i * k];
+        int a = state.assignment[i];
+
+        if (a < 0) {
+            // First pass: every distance is exact and becomes the lower bound
+            int best = 0;
+            double best_dist = std::numeric_limits<double>::max();
+            for (size_t j = 0; j < k; ++j) {
+                lower[j] = state.distance(i, j);
+                if (lower[j] < best_dist) {
+                    best_dist = lower[j];
+                    best = static_cast<int>(j);
+                }
+            }
+            state.assignment[i] = best;
+            state.upper[i] = best_dist;
+            ++changes;
+            continue;
+        }
+
+        if (state.upper[i] < state.half_separation[a]) {
+            continue;
+        }
+
+        int best = a;
+        bool stale = true;
+        for (size_t j = 0; j < k; ++j) {
+            if (static_cast<int>(j) == best
+                || state.upper[i] < lower[j]
+                || state.upper[i] < 0.5 * state.centroid_distances[best * k + j]) {
+                continue;
+            }
+            if (stale) {
+                state.upper[i] = state.distance(i, best);
+                lower[best] = state.upper[i];
+                stale = false;
+                if (state.upper[i] < lower[j] || state.upper[i] < 0.5 * state.centroid_distances[best * k + j]) {
+                    continue;
+                }
+            }
+            double dist = state.distance(i, j);
+            lower[j] = dist;
+            if (dist < state.upper[i] || (dist == state.upper[i] && static_cast<int>(j) < best)) {
+                best = static_cast<int>(j);
+                state.upper[i] = dist;
+            }
+        }
+
+        if (best != a) {
+            state.assignment[i] = best;
+            ++changes;
+        }
+    }
+    return changes;
+}
+
+/**
+ * Move every centroid to the mean of its members and record how far it moved.
+ * Empty clusters keep their previous centroid.
+ */
+void move_centroids(FitState &state) {
+    std::vector<double> sums(state.k * state.dim, 0.0);
+    std::vector<size_t> counts(state.k, 0);
+    for (size_t i = 0; i < state.n; ++i) {
+        double *sum = &sums[state.assignment[i] * state.dim];
+        for (size_t d = 0; d < state.dim; ++d) {
+            sum[d] += state.points[i][d];
+        }
+        counts[state.assignment[i]]++;
+    }
+
+    state.movement.assign(state.k, 0.0);
+    for (size_t j = 0; j < state.k; ++j) {
+        if (counts[j] == 0) {
+            continue;
+        }
+        real_t *centroid = &state.centroids[j * state.dim];
+        const double *sum = &sums[j * state.dim];
+        double moved = 0.0;
+        for (size_t d = 0; d < state.dim; ++d) {
+            real_t mean = static_cast<real_t>(sum[d] / static_cast<double>(counts[j]));
+            double diff = static_cast<double>(mean) - centroid[d];
+            moved += diff * diff;
+            centroid[d] = mean;
+        }
+        state.movement[j] = std::sqrt(moved);
+    }
+}
+
+/**
+ * Loosen the bounds by the centroid movement so they stay valid for the new centroids.
+ */
+void shift_bounds(FitState &state, KMeansAlgorithm algorithm) {
+    if (algorithm == KMeansAlgorithm::HAMERLY) {
+        size_t farthest = 0;
+        double max_move = 0.0;
+        double second_move = 0.0;
+        for (size_t j = 0; j < state.k; ++j) {
+            if (state.movement[j] > max_move) {
+                second_move = max_move;
+                max_move = state.movement[j];
+                farthest = j;
+            } else if (state.movement[j] > second_move) {
+                second_move = state.movement[j];
+            }
+        }
+        for (size_t i = 0; i < state.n; ++i) {
+            size_t a = state.assignment[i];
+            state.upper[i] += state.movement[a];
+            state.lower[i] -= (a == farthest) ? second_move : max_move;
+        }
+    } else if (algorithm == KMeansAlgorithm::ELKAN) {
+        for (size_t i = 0; i < state.n; ++i) {
+            state.upper[i] += state.movement[state.assignment[i]];
+            double *lower = &state.lower[i * state.k];
+            for (size_t j = 0; j < state.k; ++j) {
+                lower[j] = std::max(0.0, lower[j] - state.movement[j]);
+            }
+        }
+    }
+}
+
+} // namespace
+
+KMeans::KMeans(int k) : KMeans(k, static_cast<uint32_t>(rand())) {}
+
+KMeans::KMeans(int k, uint32_t seed)
     : num_clusters(k),
-      clusters(new std::vector<cluster_t *>()),
-      used_indexes(new std::unordered_set<int>()) {}
+      used_indexes(new std::unordered_set<int>()),
+      random_engine(seed) {}
+
+size_t KMeans::random_index(size_t n) {
+    return std::uniform_int_distribution<size_t>(0, n - 1)(random_engine);
+}
+
+double KMeans::uniform_random() {
+    return std::uniform_real_distribution<double>(0.0, 1.0)(random_engine);
+}
 
 /**
  * Initialize clusters by randomly selecting unique points from the training data.
  */
 void KMeans::init_clusters() {
-    while (clusters->size() < static_cast<size_t>(num_clusters)) {
-        int index = rand() % training_set->size();
+    while (clusters.size() < static_cast<size_t>(num_clusters)) {
+        int index = static_cast<int>(random_index(training_set->size()));
         while (used_indexes->find(index) != used_indexes->end()) {
-            index = rand() % training_set->size();
+            index = static_cast<int>(random_index(training_set->size()));
         }
-        clusters->push_back(new cluster_t(training_set->at(index)));
-        used_indexes->insert(index);
+        add_seed(index);
+    }
+}
+
+/**
+ * Size the cluster store from the training data: feature dimension and label range.
+ */
+void KMeans::configure_store() {
+    int max_label = 0;
+    for (DataPoint *point : *training_set) {
+        max_label = std::max(max_label, static_cast<int>(point->get_label()));
+    }
+    clusters.configure(training_set->at(0)->get_normalized_feature_vector()->size(), max_label + 1);
+    if (track_membership) {
+        clusters.enable_membership(training_set->size());
+    }
+}
+
+/**
+ * Add the training point at the given index as a new centroid and mark it as used.
+ */
+void KMeans::add_seed(int index) {
+    if (clusters.size() == 0) {
+        configure_store();
+    }
+    clusters.add_cluster(training_set->at(index), index);
+    used_indexes->insert(index);
+}
+
+/**
+ * D^2 sampling over a pool of training indexes, optionally weighted per pool entry.
+ * Existing centroids are taken into account, so this can also extend a previous solution.
+ */
+void KMeans::seed_by_distance(const std::vector<int> &pool, const std::vector<double> *weights, int count, int trials) {
+    size_t n = pool.size();
+    if (n == 0 || count <= 0) {
+        return;
+    }
+
+    size_t dim = training_set->at(0)->get_normalized_feature_vector()->size();
+    size_t chunks = chunk_count(n);
+    size_t step = (n + chunks - 1) / chunks;
+    std::vector<double> min_dist(n, std::numeric_limits<double>::max());
+    std::vector<double> chunk_sums(chunks, 0.0);
+
+    // Lower every point's D^2 with a new centroid and refresh the per-chunk sampling mass
+    auto fold = [&](const real_t *centroid) {
+        parallel_chunks(n, chunks, [&](size_t c, size_t begin, size_t end) {
+            double sum = 0.0;
+            for (size_t i = begin; i < end; ++i) {
+                const real_t *features = training_set->at(pool[i])->get_normalized_feature_vector()->data();
+                double dist = linalg::squared_distance(centroid, features, dim);
+                if (dist < min_dist[i]) {
+                    min_dist[i] = dist;
+                }
+                sum += weights ? (*weights)[i] * min_dist[i] : min_dist[i];
+            }
+            chunk_sums[c] = sum;
+        });
+    };
+
+    size_t target = clusters.size() + static_cast<size_t>(count);
+    if (clusters.size() == 0) {
+        // The first centroid is drawn proportionally to the weights alone
+        size_t first = random_index(n);
+        if (weights) {
+            double r = uniform_random() * std::accumulate(weights->begin(), weights->end(), 0.0);
+            for (first = 0; first + 1 < n && r >= (*weights)[first]; ++first) {
+                r -= (*weights)[first];
+            }
+        }
+        add_seed(pool[first]);
+    }
+    for (size_t j = 0; j < clusters.size(); ++j) {
+        fold(clusters.centroid(j));
+    }
+
+    // Draw one pool entry with probability proportional to weight * D^2 (n if nothing is left)
+    auto sample = [&]() {
+        double total = std::accumulate(chunk_sums.begin(), chunk_sums.end(), 0.0);
+        if (total <= 0.0) {
+            return n;  // every pool point already coincides with a centroid
+        }
+
+        // Locate the chunk holding the sample, then the point inside it
+        double r = uniform_random() * total;
+        size_t c = 0;
+        while (c + 1 < chunks && r >= chunk_sums[c]) {
+            r -= chunk_sums[c];
+            ++c;
+        }
+
+        size_t begin = std::min(c * step, n);
+        size_t end = std::min((c + 1) * step, n);
+        size_t pick = n;
+        for (size_t i = begin; i < end; ++i) {
+            double mass = weights ? (*weights)[i] * min_dist[i] : min_dist[i];
+            if (mass > 0.0) {
+                pick = i;  // rounding at the tail falls back to the last positive entry
+                r -= mass;
+                if (r < 0.0) {
+                    break;
+                }
+            }
+        }
+        return pick;
+    };
+
+    // Total weighted D^2 if the given pool entry became a centroid
+    std::vector<double> trial_sums(chunks, 0.0);
+    auto potential_with = [&](size_t candidate) {
+        const real_t *centroid = training_set->at(pool[candidate])->get_normalized_feature_vector()->data();
+        parallel_chunks(n, chunks, [&](size_t c, size_t begin, size_t end) {
+            double sum = 0.0;
+            for (size_t i = begin; i < end; ++i) {
+                const real_t *features = training_set->at(pool[i])->get_normalized_feature_vector()->data();
+                double dist = std::min<double>(min_dist[i], linalg::squared_distance(centroid, features, dim));
+                sum += weights ? (*weights)[i] * dist : dist;
+            }
+            trial_sums[c] = sum;
+        });
+        return std::accumulate(trial_sums.begin(), trial_sums.end(), 0.0);
+    };
+
+    while (clusters.size() < target) {
+        size_t pick = sample();
+        if (pick == n) {
+            break;
+        }
+
+        // Greedy variant: keep the draw that lowers the potential the most
+        if (trials > 1) {
+            double best_potential = potential_with(pick);
+            for (int t = 1; t < trials; ++t) {
+                size_t candidate = sample();
+                double potential = potential_with(candidate);
+                if (potential < best_potential) {
+                    best_potential = potential;
+                    pick = candidate;
+                }
+            }
+        }
+
+        add_seed(pool[pick]);
+        fold(clusters.centroid(clusters.size() - 1));
     }
 }
 
+/**
+ * Initialize clusters with k-means++: the first centroid is uniform, each next one is drawn
+ * with probability proportional to the squared distance to the closest chosen centroid.
+ */
+void KMeans::init_clusters_plus_plus() {
+    RTML_TIMER("kmeans.init");
+    std::vector<int> pool(training_set->size());
+    std::iota(pool.begin(), pool.end(), 0);
+    seed_by_distance(pool, nullptr, num_clusters - static_cast<int>(clusters.size()));
+
+    // Top up with random points if the data ran out of distinct locations
+    init_clusters();
+}
+
+/**
+ * Initialize clusters with k-means|| (Bahmani et al.): oversample candidates in a few
+ * rounds, weight them by the points they attract, and reduce them with weighted k-means++.
+ */
+void KMeans::init_clusters_parallel(double oversampling, int rounds) {
+    size_t n = training_set->size();
+    size_t dim = training_set->at(0)->get_normalized_feature_vector()->size();
+    size_t chunks = chunk_count(n);
+    double expected_per_round = oversampling * num_clusters;
+
+    std::vector<int> candidates;
+    std::vector<double> min_dist(n, std::numeric_limits<double>::max());
+    std::vector<int> nearest(n, 0);
+    std::vector<double> chunk_sums(chunks, 0.0);
+
+    // Fold candidates [from, end) into every point's closest-candidate distance
+    auto fold = [&](size_t from) {
+        parallel_chunks(n, chunks, [&](size_t c, size_t begin, size_t end) {
+            double sum = 0.0;
+            for (size_t i = begin; i < end; ++i) {
+                const real_t *features = training_set->at(i)->get_normalized_feature_vector()->data();
+                for (size_t j = from; j < candidates.size(); ++j) {
+                    const real_t *candidate = training_set->at(candidates[j])->get_normalized_feature_vector()->data();
+                    double dist = linalg::squared_distance(candidate, features, dim);
+                    if (dist < min_dist[i]) {
+                        min_dist[i] = dist;
+                        nearest[i] = static_cast<int>(j);
+                    }
+                }
+                sum += min_dist[i];
+            }
+            chunk_sums[c] = sum;
+        });
+    };
+
+    candidates.push_back(static_cast<int>(random_index(n)));
+    fold(0);
+
+    for (int round = 0; round < rounds; ++round) {
+        double cost = std::accumulate(chunk_sums.begin(), chunk_sums.end(), 0.0);
+        if (cost <= 0.0) {
+            break;
+        }
+
+        // Independent Bernoulli draws; cheap next to the distance folds
+        size_t from = candidates.size();
+        for (size_t i = 0; i < n; ++i) {
+            if (min_dist[i] > 0.0 && uniform_random() < expected_per_round * min_dist[i] / cost) {
+                candidates.push_back(static_cast<int>(i));
+            }
+        }
+        if (candidates.size() > from) {
+            fold(from);
+        }
+    }
+
+    // Weight each candidate by the number of points closest to it
+    std::vector<double> weights(candidates.size(), 0.0);
+    for (size_t i = 0; i < n; ++i) {
+        weights[nearest[i]] += 1.0;
+    }
+
+    seed_by_distance(candidates, &weights, num_clusters - static_cast<int>(clusters.size()));
+    init_clusters();
+}
+
+/**
+ * Warm start: reuse the centroids of a previous solution and greedily D^2-sample the rest.
+ */
+void KMeans::warm_start(const KMeans &previous) {
+    const ClusterStore &source = previous.get_clusters();
+    configure_store();
+    for (size_t j = 0; j < source.size() && clusters.size() < static_cast<size_t>(num_clusters); ++j) {
+        clusters.add_centroid(source.centroid(j));
+    }
+
+    // Greedy D^2 sampling keeps the new centroids from landing on isolated outliers
+    std::vector<int> pool(training_set->size());
+    std::iota(pool.begin(), pool.end(), 0);
+    int trials = 2 + static_cast<int>(std::log(static_cast<double>(num_clusters)));
+    seed_by_distance(pool, nullptr, num_clusters - static_cast<int>(clusters.size()), trials);
+    init_clusters();
+}
+
 /**
  * Initialize clusters so that each unique class in training data gets one cluster.
  */
@@ -31,9 +556,8 @@ void KMeans::init_clusters_for_each_class() {
     for (size_t i = 0; i < training_set->size(); ++i) {
         int label = training_set->at(i)->get_label();
         if (classes_used.find(label) == classes_used.end()) {
-            clusters->push_back(new cluster_t(training_set->at(i)));
+            add_seed(static_cast<int>(i));
             classes_used.insert(label);
-            used_indexes->insert(i);
         }
     }
 }
@@ -43,91 +567,139 @@ void KMeans::init_clusters_for_each_class() {
  */
 void KMeans::train() {
     while (used_indexes->size() < training_set->size()) {
-        int index = rand() % training_set->size();
+        int index = static_cast<int>(random_index(training_set->size()));
         while (used_indexes->find(index) != used_indexes->end()) {
-            index = rand() % training_set->size();
+            index = static_cast<int>(random_index(training_set->size()));
         }
 
         double min_dist = std::numeric_limits<double>::max();
         int best_cluster = 0;
 
-        for (size_t j = 0; j < clusters->size(); ++j) {
-            double dist = euclidean_distance(*clusters->at(j)->centroid, training_set->at(index));
+        for (size_t j = 0; j < clusters.size(); ++j) {
+            double dist = euclidean_distance(clusters.centroid(j), training_set->at(index));
             if (dist < min_dist) {
                 min_dist = dist;
                 best_cluster = static_cast<int>(j);
             }
         }
 
-        clusters->at(best_cluster)->add_to_cluster(training_set->at(index));
+        clusters.add_point(best_cluster, training_set->at(index), index);
         used_indexes->insert(index);
     }
 }
 
 /**
- * Calculate Euclidean distance between centroid and a data point.
+ * Batch K-Means from the current centroids. Hamerly and Elkan keep triangle-inequality bounds
+ * per point so most distance computations are skipped once centroids settle.
  */
-double KMeans::euclidean_distance(const std::vector<double> &centroid, DataPoint *point) const {
-    double dist = 0.0;
-    const std::vector<double> *features = point->get_normalized_feature_vector();
-    for (size_t i = 0; i < centroid.size(); ++i) {
-        double diff = centroid[i] - features->at(i);
-        dist += diff * diff;
+int KMeans::fit(int max_iterations, KMeansAlgorithm algorithm) {
+    if (max_iterations < 1) {
+        std::cerr << "Error: max_iterations must be at least 1." << std::endl;
+        exit(1);
+    }
+    if (clusters.size() == 0) {
+        init_clusters_plus_plus();
     }
-    return std::sqrt(dist);
-}
 
-/**
- * Validate the model on the validation set, returning accuracy in [0, 100].
- */
-double KMeans::validate() {
-    double num_correct = 0.0;
-    for (DataPoint *query_point : *validation_set) {
-        double min_dist = std::numeric_limits<double>::max();
-        int best = 0;
+    FitState state;
+    state.n = training_set->size();
+    state.k = clusters.size();
+    state.dim = clusters.dimension();
+    state.points.reserve(state.n);
+    for (DataPoint *point : *training_set) {
+        state.points.push_back(point->get_normalized_feature_vector()->data());
+    }
+    state.centroids = clusters.centroid_matrix();
+    state.assignment.assign(state.n, -1);
+    state.upper.assign(state.n, 0.0);
+    state.lower.assign(algorithm == KMeansAlgorithm::ELKAN ? state.n * state.k : state.n, 0.0);
 
-        for (size_t i = 0; i < clusters->size(); ++i) {
-            double current_dist = euclidean_distance(*clusters->at(i)->centroid, query_point);
-            if (current_dist < min_dist) {
-                min_dist = current_dist;
-                best = static_cast<int>(i);
-            }
+    size_t chunks = chunk_count(state.n);
+    std::vector<size_t> chunk_changes(chunks, 0);
+
+    int iteration = 0;
+    while (iteration < max_iterations) {
+        ++iteration;
+        if (algorithm != KMeansAlgorithm::LLOYD) {
+            RTML_TIMER("kmeans.separation");
+            update_centroid_separation(state, algorithm == KMeansAlgorithm::ELKAN);
         }
 
-        if (clusters->at(best)->most_frequent_class == query_point->get_label()) {
-            num_correct++;
+        {
+            RTML_TIMER("kmeans.assign");
+            parallel_chunks(state.n, chunks, [&](size_t c, size_t begin, size_t end) {
+                switch (algorithm) {
+                    case KMeansAlgorithm::HAMERLY: chunk_changes[c] = assign_hamerly(state, begin, end); break;
+                    case KMeansAlgorithm::ELKAN:   chunk_changes[c] = assign_elkan(state, begin, end); break;
+                    default:                       chunk_changes[c] = assign_lloyd(state, begin, end); break;
+                }
+            });
+            RTML_COUNT("kmeans.bytes_scanned", state.n * state.dim * sizeof(real_t));
+        }
+        if (std::accumulate(chunk_changes.begin(), chunk_changes.end(), size_t{0}) == 0) {
+            break;
         }
+        if (iteration == max_iterations) {
+            break;  // keep the centroids the last pass assigned against
+        }
+
+        RTML_TIMER("kmeans.update");
+        move_centroids(state);
+        shift_bounds(state, algorithm);
+    }
+
+    // Rebuild sums, counts and labels from the final assignment; empty clusters keep their centroid
+    clusters.clear_members();
+    for (size_t j = 0; j < state.k; ++j) {
+        clusters.set_centroid(j, &state.centroids[j * state.dim]);
+    }
+    for (size_t i = 0; i < state.n; ++i) {
+        clusters.add_point(state.assignment[i], training_set->at(i), static_cast<int>(i));
+        used_indexes->insert(static_cast<int>(i));
     }
-    return 100.0 * (num_correct / static_cast<double>(validation_set->size()));
+
+    return iteration;
+}
+
+/**
+ * Calculate Euclidean distance between centroid and a data point.
+ */
+double KMeans::euclidean_distance(const real_t *centroid, DataPoint *point) const {
+    const std::vector<real_t> *features = point->get_normalized_feature_vector();
+    return std::sqrt(linalg::squared_distance(centroid, features->data(), clusters.dimension()));
+}
+
+/**
+ * Snapshot the clusters into a batched nearest-centroid classifier.
+ */
+NearestCentroidClassifier KMeans::classifier() const {
+    return NearestCentroidClassifier(clusters);
+}
+
+/**
+ * Validate the model on the validation set, returning accuracy in [0, 100].
+ */
+double KMeans::validate() {
+    return classifier().evaluate(*validation_set);
 }
 
 /**
  * Test the model on the test set, returning accuracy in [0, 100].
  */
 double KMeans::test() {
-    double num_correct = 0.0;
-    for (DataPoint *query_point : *test_set) {
-        double min_dist = std::numeric_limits<double>::max();
-        int best = 0;
-
-        for (size_t i = 0; i < clusters->size(); ++i) {
-            double current_dist = euclidean_distance(*clusters->at(i)->centroid, query_point);
-            if (current_dist < min_dist) {
-                min_dist = current_dist;
-                best = static_cast<int>(i);
-            }
-        }
+    return classifier().evaluate(*test_set);
+}
 
-        if (clusters->at(best)->most_frequent_class == query_point->get_label()) {
-            num_correct++;
-        }
-    }
-    return 100.0 * (num_correct / static_cast<double>(test_set->size()));
+/**
+ * Enable or disable per-point membership tracking.
+ */
+void KMeans::set_track_membership(bool enabled) {
+    track_membership = enabled;
 }
 
 /**
- * Get pointer to clusters.
+ * Get the cluster store.
  */
-std::vector<cluster_t *> *KMeans::get_clusters() const {
+const ClusterStore &KMeans::get_clusters() const {
     return clusters;
 }
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "mini_batch_kmeans.hpp"
+#include "linalg.hpp"
+#include <cstdlib>      // for rand()
+#include <limits>       // for numeric_limits
+#include <algorithm>    // for max, shuffle
+#include <numeric>      // for iota
+#include <random>
+
+namespace {
+
+// Labels are uint8_t, so one counter per possible value keeps the histogram dense
+const size_t LABEL_RANGE = 256;
+
+/**
+ * Index of the closest row of a k x dim centroid matrix.
+ */
+int nearest_centroid(const real_t *centroids, size_t k, size_t dim, const real_t *features) {
+    int best = 0;
+    double min_dist = std::numeric_limits<double>::max();
+    for (size_t j = 0; j < k; ++j) {
+        double dist = linalg::squared_distance(centroids + j * dim, features, dim);
+        if (dist < min_dist) {
+            min_dist = dist;
+            best = static_cast<int>(j);
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+int CentroidSnapshot::nearest(const real_t *features) const {
+    return nearest_centroid(centroids.data(), num_clusters, dim, features);
+}
+
+MiniBatchKMeans::MiniBatchKMeans(int k, size_t batch_size)
+    : num_clusters(k),
+      batch_size(std::max<size_t>(1, batch_size)) {}
+
+void MiniBatchKMeans::set_min_learning_rate(double rate) {
+    min_learning_rate = std::min(1.0, std::max(0.0, rate));
+}
+
+/**
+ * Buffer a point; the first update waits for at least k points so every centroid can be seeded.
+ */
+void MiniBatchKMeans::push(DataPoint *point) {
+    pending.push_back(point);
+    size_t required = initialized ? batch_size : std::max(batch_size, static_cast<size_t>(num_clusters));
+    if (pending.size() >= required) {
+        process_pending();
+    }
+}
+
+void MiniBatchKMeans::flush() {
+    if (pending.empty() || (!initialized && pending.size() < static_cast<size_t>(num_clusters))) {
+        return;
+    }
+    process_pending();
+}
+
+/**
+ * k-means++ over the first buffered batch.
+ */
+void MiniBatchKMeans::seed_from_pending() {
+    size_t features_dim = pending.at(0)->get_normalized_feature_vector()->size();
+    size_t n = pending.size();
+    size_t k = static_cast<size_t>(num_clusters);
+    std::vector<real_t> seeds(k * features_dim, real_t(0));
+
+    std::vector<double> min_dist(n, std::numeric_limits<double>::max());
+    size_t pick = rand() % n;
+    for (size_t j = 0; j < k; ++j) {
+        const real_t *seed = pending[pick]->get_normalized_feature_vector()->data();
+        std::copy(seed, seed + features_dim, &seeds[j * features_dim]);
+
+        double total = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            const real_t *features = pending[i]->get_normalized_feature_vector()->data();
+            min_dist[i] = std::min<double>(min_dist[i], linalg::squared_distance(seed, features, features_dim));
+            total += min_dist[i];
+        }
+
+        double r = rand() / (static_cast<double>(RAND_MAX) + 1.0) * total;
+        for (pick = 0; pick + 1 < n && r >= min_dist[pick]; ++pick) {
+            r -= min_dist[pick];
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(centroid_mutex);
+    dim = features_dim;
+    centroids = std::move(seeds);
+    counts.assign(k, 0.0);
+    label_counts.assign(k * LABEL_RANGE, 0);
+    initialized = true;
+}
+
+/**
+ * Assign the batch against fixed centroids, then apply per-point updates with rate 1 / count.
+ * Only the update phase takes the lock, since this is the only thread that writes centroids.
+ */
+void MiniBatchKMeans::process_pending() {
+    if (!initialized) {
+        seed_from_pending();
+    }
+
+    batch_assignment.resize(pending.size());
+    for (size_t i = 0; i < pending.size(); ++i) {
+        const real_t *features = pending[i]->get_normalized_feature_vector()->data();
+        batch_assignment[i] = nearest_centroid(centroids.data(), num_clusters, dim, features);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(centroid_mutex);
+        for (size_t i = 0; i < pending.size(); ++i) {
+            size_t c = static_cast<size_t>(batch_assignment[i]);
+            counts[c] += 1.0;
+            real_t rate = static_cast<real_t>(std::max(1.0 / counts[c], min_learning_rate));
+
+            real_t *centroid = &centroids[c * dim];
+            const real_t *features = pending[i]->get_normalized_feature_vector()->data();
+            for (size_t d = 0; d < dim; ++d) {
+                centroid[d] += rate * (features[d] - centroid[d]);
+            }
+            label_counts[c * LABEL_RANGE + pending[i]->get_label()]++;
+        }
+    }
+
+    pending.clear();
+}
+
+void MiniBatchKMeans::train(int num_epochs) {
+    std::vector<DataPoint *> order(*training_set);
+    std::mt19937 gen(rand());
+    for (int epoch = 0; epoch < num_epochs; ++epoch) {
+        std::shuffle(order.begin(), order.end(), gen);
+        partial_fit(order.begin(), order.end());
+        flush();
+    }
+}
+
+int MiniBatchKMeans::most_frequent_class(size_t cluster) const {
+    const uint32_t *histogram = &label_counts[cluster * LABEL_RANGE];
+    int best_class = -1;
+    uint32_t max_freq = 0;
+    for (size_t label = 0; label < LABEL_RANGE; ++label) {
+        if (histogram[label] > max_freq) {
+            max_freq = histogram[label];
+            best_class = static_cast<int>(label);
+        }
+    }
+    return best_class;
+}
+
+CentroidSnapshot MiniBatchKMeans::snapshot() const {
+    std::lock_guard<std::mutex> lock(centroid_mutex);
+    CentroidSnapshot snap;
+    if (!initialized) {
+        return snap;
+    }
+    snap.num_clusters = static_cast<size_t>(num_clusters);
+    snap.dim = dim;
+    snap.centroids = centroids;
+    snap.labels.resize(snap.num_clusters);
+    for (size_t j = 0; j < snap.num_clusters; ++j) {
+        snap.labels[j] = most_frequent_class(j);
+    }
+    return snap;
+}
+
+int MiniBatchKMeans::predict(DataPoint *point) const {
+    std::lock_guard<std::mutex> lock(centroid_mutex);
+    if (!initialized) {
+        return -1;
+    }
+
+    const real_t *features = point->get_normalized_feature_vector()->data();
+    int best = nearest_centroid(centroids.data(), num_clusters, dim, features);
+    return most_frequent_class(static_cast<size_t>(best));
+}
+
+/**
+ * Accuracy of one consistent snapshot, so evaluation never blocks the updater for long.
+ */
+double MiniBatchKMeans::evaluate(const std::vector<DataPoint *> &data_set) const {
+    CentroidSnapshot snap = snapshot();
+    if (snap.num_clusters == 0 || data_set.empty()) {
+        return 0.0;
+    }
+
+    double num_correct = 0.0;
+    for (DataPoint *query_point : data_set) {
+        int best = snap.nearest(query_point->get_normalized_feature_vector()->data());
+        if (snap.labels[best] == query_point->get_label()) {
+            num_correct++;
+        }
+    }
+    return 100.0 * (num_correct / static_cast<double>(data_set.size()));
+}
+
+double MiniBatchKMeans::validate() const {
+    return evaluate(*validation_set);
+}
+
+double MiniBatchKMeans::test() const {
+    return evaluate(*test_set);
+}
@@ -0,0 +1,281 @@
+#include "model_selection.hpp"
+#include "kmeans.hpp"
+#include "linalg.hpp"
+#include "nearest_centroid.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>    // for max, sort
+#include <atomic>
+#include <cstdlib>      // for rand()
+#include <limits>       // for numeric_limits
+#include <memory>
+#include <numeric>      // for iota
+
+namespace {
+
+/**
+ * One leaf of the bisecting split tree.
+ */
+struct Node {
+    std::vector<DataPoint *> members;
+    std::vector<real_t> centroid;
+    double sse = 0.0;
+    int label = -1;
+};
+
+/**
+ * Fill in the SSE and majority label of a node whose centroid is already set.
+ */
+void summarize(Node &node) {
+    size_t dim = node.centroid.size();
+    std::vector<int> histogram(256, 0);
+    node.sse = 0.0;
+    for (DataPoint *point : node.members) {
+        node.sse += linalg::squared_distance(node.centroid.data(), point->get_normalized_feature_vector()->data(), dim);
+        histogram[point->get_label()]++;
+    }
+    node.label = static_cast<int>(std::max_element(histogram.begin(), histogram.end()) - histogram.begin());
+}
+
+} // namespace
+
+KMeansModelSelection::KMeansModelSelection(int max_iterations)
+    : max_iterations(max_iterations) {}
+
+/**
+ * Bisecting K-Means. Splitting node t into (t, new) only moves validation points that are
+ * closer to one of the two children, or that belonged to t and need a full rescan.
+ */
+std::vector<KScore> KMeansModelSelection::bisecting_sweep(int k_min, int k_max,
+                                                          NearestCentroidClassifier **best_model) {
+    size_t dim = training_set->at(0)->get_normalized_feature_vector()->size();
+    std::vector<KScore> curve;
+
+    // Leaves of the best entry so far (strictly better only, so the earliest wins like best())
+    double best_accuracy = -1.0;
+    std::vector<real_t> best_centroids;
+    std::vector<int> best_labels;
+
+    // Root: every training point in one cluster
+    std::vector<Node> nodes(1);
+    nodes[0].members = *training_set;
+    std::vector<double> sums(dim, 0.0);
+    for (DataPoint *point : *training_set) {
+        const real_t *features = point->get_normalized_feature_vector()->data();
+        for (size_t d = 0; d < dim; ++d) {
+            sums[d] += features[d];
+        }
+    }
+    nodes[0].centroid.resize(dim);
+    for (size_t d = 0; d < dim; ++d) {
+        nodes[0].centroid[d] = static_cast<real_t>(sums[d] / static_cast<double>(training_set->size()));
+    }
+    summarize(nodes[0]);
+
+    // Closest node and squared distance for every validation point
+    size_t num_queries = validation_set->size();
+    std::vector<int> assignment(num_queries, 0);
+    std::vector<double> best_dist(num_queries);
+    for (size_t i = 0; i < num_queries; ++i) {
+        best_dist[i] = linalg::squared_distance(nodes[0].centroid.data(),
+                                                validation_set->at(i)->get_normalized_feature_vector()->data(), dim);
+    }
+
+    auto record = [&]() {
+        int k = static_cast<int>(nodes.size());
+        if (k < k_min || k > k_max) {
+            return;
+        }
+        double num_correct = 0.0;
+        for (size_t i = 0; i < num_queries; ++i) {
+            if (nodes[assignment[i]].label == validation_set->at(i)->get_label()) {
+                num_correct++;
+            }
+        }
+        curve.push_back({k, 100.0 * num_correct / static_cast<double>(num_queries)});
+        if (best_model && curve.back().accuracy > best_accuracy) {
+            best_accuracy = curve.back().accuracy;
+            best_centroids.clear();
+            best_labels.clear();
+            for (const Node &node : nodes) {
+                best_centroids.insert(best_centroids.end(), node.centroid.begin(), node.centroid.end());
+                best_labels.push_back(node.label);
+            }
+        }
+    };
+    record();
+
+    while (static_cast<int>(nodes.size()) < k_max) {
+        size_t target = nodes.size();
+        double max_sse = 0.0;
+        for (size_t j = 0; j < nodes.size(); ++j) {
+            if (nodes[j].members.size() >= 2 && nodes[j].sse > max_sse) {
+                max_sse = nodes[j].sse;
+                target = j;
+            }
+        }
+        if (target == nodes.size()) {
+            break;  // nothing left to split
+        }
+
+        KMeans two_means(2);
+        two_means.set_training_data(&nodes[target].members);
+        two_means.set_track_membership(true);
+        two_means.fit(max_iterations);
+
+        const ClusterStore &store = two_means.get_clusters();
+        if (store.count(0) == 0 || store.count(1) == 0) {
+            nodes[target].sse = 0.0;  // identical points cannot be split
+            continue;
+        }
+
+        Node left, right;
+        const std::vector<int> &members = store.get_assignment();
+        for (size_t i = 0; i < members.size(); ++i) {
+            (members[i] == 0 ? left : right).members.push_back(nodes[target].members[i]);
+        }
+        left.centroid.assign(store.centroid(0), store.centroid(0) + dim);
+        right.centroid.assign(store.centroid(1), store.centroid(1) + dim);
+        summarize(left);
+        summarize(right);
+
+        nodes[target] = std::move(left);
+        nodes.push_back(std::move(right));
+        int added = static_cast<int>(nodes.size()) - 1;
+
+        for (size_t i = 0; i < num_queries; ++i) {
+            const real_t *features = validation_set->at(i)->get_normalized_feature_vector()->data();
+            if (assignment[i] == static_cast<int>(target)) {
+                // The old centroid is gone: rescan everything
+                best_dist[i] = std::numeric_limits<double>::max();
+                for (size_t j = 0; j < nodes.size(); ++j) {
+                    double dist = linalg::squared_distance(nodes[j].centroid.data(), features, dim);
+                    if (dist < best_dist[i]) {
+                        best_dist[i] = dist;
+                        assignment[i] = static_cast<int>(j);
+                    }
+                }
+                continue;
+            }
+            for (int j : {static_cast<int>(target), added}) {
+                double dist = linalg::squared_distance(nodes[j].centroid.data(), features, dim);
+                if (dist < best_dist[i]) {
+                    best_dist[i] = dist;
+                    assignment[i] = j;
+                }
+            }
+        }
+        record();
+    }
+
+    if (best_model) {
+        *best_model = curve.empty() ? nullptr
+                                    : new NearestCentroidClassifier(std::move(best_centroids),
+                                                                    std::move(best_labels), dim);
+    }
+    return curve;
+}
+
+/**
+ * Each k + step starts from the k centroids plus `step` D^2 seeds, so fit() mostly settles
+ * the new clusters instead of starting over.
+ */
+std::vector<KScore> KMeansModelSelection::warm_start_sweep(int k_min, int k_max, int step, KMeans **best_model) {
+    std::vector<KScore> curve;
+    KMeans *previous = nullptr;
+    KMeans *winner = nullptr;
+
+    for (int k = k_min; k <= k_max; k += std::max(1, step)) {
+        KMeans *model = new KMeans(k);
+        model->set_training_data(training_set);
+        model->set_validation_data(validation_set);
+        if (previous) {
+            model->warm_start(*previous);
+        } else {
+            model->init_clusters_plus_plus();
+        }
+        model->fit(max_iterations);
+        curve.push_back({k, model->validate()});
+
+        // Keep only the model the next k starts from and the best one so far
+        if (previous != winner) {
+            delete previous;
+        }
+        if (best_model && best(curve).k == k) {
+            delete winner;
+            winner = model;
+        }
+        previous = model;
+    }
+
+    if (previous != winner) {
+        delete previous;
+    }
+    if (best_model) {
+        *best_model = winner;
+    }
+    return curve;
+}
+
+/**
+ * Independent fits, scheduled largest k first so the slowest candidates start early.
+ * rand() is not thread-safe, so it is only called here, before the lanes start.
+ */
+std::vector<KScore> KMeansModelSelection::parallel_sweep(const std::vector<int> &candidates, unsigned num_threads,
+                                                         KMeans **best_model) {
+    std::vector<KScore> curve(candidates.size());
+    std::vector<std::unique_ptr<KMeans>> models(candidates.size());
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        models[i].reset(new KMeans(candidates[i], static_cast<uint32_t>(rand())));
+    }
+    std::vector<size_t> order(candidates.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return candidates[a] > candidates[b]; });
+
+    // Lanes pull candidates in that order, so a cheap candidate never waits behind an expensive one
+    if (num_threads == 0) {
+        num_threads = ThreadPool::shared().size();
+    }
+    std::atomic<size_t> next{0};
+    auto lane = [&]() {
+        for (size_t slot = next++; slot < order.size(); slot = next++) {
+            size_t i = order[slot];
+            KMeans &model = *models[i];
+            model.set_training_data(training_set);
+            model.set_validation_data(validation_set);
+            model.init_clusters_plus_plus();
+            model.fit(max_iterations);
+            curve[i] = {candidates[i], model.validate()};
+            if (!best_model) {
+                models[i].reset();
+            }
+        }
+    };
+    size_t lanes = std::min<size_t>(num_threads, candidates.size());
+    ThreadPool::shared().parallel_for(0, lanes, 1, [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; ++t) {
+            lane();
+        }
+    });
+
+    if (best_model) {
+        // Same choice as best(): the first of the highest accuracies
+        size_t winner = 0;
+        for (size_t i = 1; i < curve.size(); ++i) {
+            if (curve[i].accuracy > curve[winner].accuracy) {
+                winner = i;
+            }
+        }
+        *best_model = curve.empty() ? nullptr : models[winner].release();
+    }
+    return curve;
+}
+
+KScore KMeansModelSelection::best(const std::vector<KScore> &curve) {
+    KScore best_score = {0, 0.0};
+    for (const KScore &score : curve) {
+        if (best_score.k == 0 || score.accuracy > best_score.accuracy) {
+            best_score = score;
+        }
+    }
+    return best_score;
+}
@@ -0,0 +1,229 @@
+#include "nearest_centroid.hpp"
+#include "instrumentation.hpp"
+#include "linalg.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>    // for min, copy
+#include <atomic>
+#include <iostream>
+#include <limits>       // for numeric_limits
+
+namespace {
+
+const uint32_t SHAPE_SECTION = section_tag("SHAP");
+const uint32_t CENTROID_SECTION = section_tag("CENT");
+const uint32_t NORM_SECTION = section_tag("NORM");
+const uint32_t LABEL_SECTION = section_tag("LABL");
+
+static_assert(sizeof(int) == sizeof(int32_t), "labels are stored as int32");
+
+/**
+ * On-disk shape of the classifier.
+ */
+struct Shape {
+    uint64_t num_centroids;
+    uint64_t dim;
+};
+
+// Queries per tile (gathered into one contiguous block) and centroids per score block
+const size_t QUERY_TILE = 32;
+const size_t CENTROID_BLOCK = 256;
+
+/**
+ * Per-thread buffers reused across tiles.
+ */
+struct TileScratch {
+    std::vector<real_t> scores;
+    std::vector<real_t> queries;
+};
+
+/**
+ * Run fn(tile, scratch) for every tile index, spreading tiles over up to num_threads lanes of
+ * the shared pool (num_threads == 1 keeps them on the calling thread).
+ */
+template <typename Fn>
+void for_each_tile(size_t num_tiles, unsigned num_threads, Fn fn) {
+    std::atomic<size_t> next{0};
+    auto lane = [&]() {
+        TileScratch scratch;
+        for (size_t tile = next++; tile < num_tiles; tile = next++) {
+            fn(tile, scratch);
+        }
+    };
+
+    size_t lanes = std::min<size_t>(num_threads, num_tiles);
+    ThreadPool::shared().parallel_for(0, lanes, 1, [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; ++t) {
+            lane();
+        }
+    });
+}
+
+} // namespace
+
+NearestCentroidClassifier::NearestCentroidClassifier(const ClusterStore &store, unsigned num_threads)
+    : NearestCentroidClassifier(store.centroid_matrix(), std::vector<int>(store.size()), store.dimension(), num_threads) {
+    for (size_t j = 0; j < num_centroids; ++j) {
+        labels[j] = store.most_frequent_class(j);
+    }
+}
+
+NearestCentroidClassifier::NearestCentroidClassifier(std::vector<real_t> centroids, std::vector<int> labels, size_t dim, unsigned num_threads)
+    : num_centroids(labels.size()),
+      dim(dim),
+      centroids(std::move(centroids)),
+      labels(std::move(labels)),
+      num_threads(num_threads ? num_threads : ThreadPool::shared().size()) {
+    norms.resize(num_centroids);
+    for (size_t j = 0; j < num_centroids; ++j) {
+        const real_t *centroid = &this->centroids[j * dim];
+        norms[j] = static_cast<real_t>(linalg::dot(centroid, centroid, dim));
+    }
+    centroid_data = this->centroids.data();
+    norm_data = norms.data();
+    label_data = this->labels.data();
+}
+
+NearestCentroidClassifier::NearestCentroidClassifier(std::shared_ptr<const MappedModelFile> file, size_t num_centroids, size_t dim,
+                                                     const real_t *centroids, const real_t *norms, const int *labels, unsigned num_threads)
+    : num_centroids(num_centroids),
+      dim(dim),
+      file(std::move(file)),
+      centroid_data(centroids),
+      norm_data(norms),
+      label_data(labels),
+      num_threads(num_threads ? num_threads : ThreadPool::shared().size()) {}
+
+bool NearestCentroidClassifier::save(const std::string &path) const {
+    Shape shape = {num_centroids, dim};
+    ModelWriter writer(ModelType::NEAREST_CENTROID);
+    writer.add_section(SHAPE_SECTION, &shape, sizeof(shape));
+    writer.add_section(CENTROID_SECTION, centroid_data, num_centroids * dim * sizeof(real_t));
+    writer.add_section(NORM_SECTION, norm_data, num_centroids * sizeof(real_t));
+    writer.add_section(LABEL_SECTION, label_data, num_centroids * sizeof(int));
+    return writer.save(path);
+}
+
+std::shared_ptr<const NearestCentroidClassifier> NearestCentroidClassifier::load(const std::string &path, unsigned num_threads) {
+    std::shared_ptr<const MappedModelFile> file = MappedModelFile::open(path, ModelType::NEAREST_CENTROID);
+    if (!file) {
+        return nullptr;
+    }
+    size_t shape_bytes, centroid_bytes, norm_bytes, label_bytes;
+    const Shape *shape = static_cast<const Shape *>(file->section(SHAPE_SECTION, shape_bytes));
+    const void *centroids = file->section(CENTROID_SECTION, centroid_bytes);
+    const void *norms = file->section(NORM_SECTION, norm_bytes);
+    const void *labels = file->section(LABEL_SECTION, label_bytes);
+    if (!shape || shape_bytes != sizeof(Shape) || shape->num_centroids == 0 || shape->dim == 0
+        || shape->num_centroids > std::numeric_limits<size_t>::max() / sizeof(real_t) / shape->dim
+        || centroid_bytes != shape->num_centroids * shape->dim * sizeof(real_t)
+        || norm_bytes != shape->num_centroids * sizeof(real_t)
+        || label_bytes != shape->num_centroids * sizeof(int)) {
+        std::cerr << "Model file '" << path << "' has inconsistent centroid arrays." << std::endl;
+        return nullptr;
+    }
+    return std::shared_ptr<const NearestCentroidClassifier>(new NearestCentroidClassifier(
+        std::move(file), shape->num_centroids, shape->dim, static_cast<const real_t *>(centroids),
+        static_cast<const real_t *>(norms), static_cast<const int *>(labels), num_threads));
+}
+
+/**
+ * Score blocks of centroids with GEMM and keep a running argmin per query.
+ */
+void NearestCentroidClassifier::predict_tile(const real_t *queries, size_t count, size_t stride, int *clusters, std::vector<real_t> &scores) const {
+    scores.resize(QUERY_TILE * CENTROID_BLOCK);
+    real_t best_scores[QUERY_TILE];
+    std::fill(best_scores, best_scores + count, std::numeric_limits<real_t>::max());
+    std::fill(clusters, clusters + count, 0);
+
+    for (size_t jb = 0; jb < num_centroids; jb += CENTROID_BLOCK) {
+        size_t block = std::min(CENTROID_BLOCK, num_centroids - jb);
+        RTML_COUNT("nearest_centroid.bytes_scanned", block * dim * sizeof(real_t));
+        linalg::gemm_nt(count, block, dim, queries, stride, centroid_data + jb * dim, dim, scores.data(), CENTROID_BLOCK);
+
+        for (size_t r = 0; r < count; ++r) {
+            real_t *row = &scores[r * CENTROID_BLOCK];
+            const real_t *block_norms = norm_data + jb;
+            for (size_t j = 0; j < block; ++j) {
+                row[j] = block_norms[j] - 2 * row[j];
+            }
+
+            real_t min_score;
+            size_t best = linalg::argmin(row, block, min_score);
+            if (min_score < best_scores[r]) {
+                best_scores[r] = min_score;
+                clusters[r] = static_cast<int>(jb + best);
+            }
+        }
+    }
+}
+
+void NearestCentroidClassifier::predict_batch(const real_t *queries, size_t num_queries, size_t stride, int *clusters) const {
+    RTML_TIMER("nearest_centroid.predict_batch");
+    RTML_COUNT("nearest_centroid.predictions", num_queries);
+    size_t num_tiles = (num_queries + QUERY_TILE - 1) / QUERY_TILE;
+    for_each_tile(num_tiles, num_threads, [&](size_t tile, TileScratch &scratch) {
+        size_t first = tile * QUERY_TILE;
+        size_t count = std::min(QUERY_TILE, num_queries - first);
+        predict_tile(queries + first * stride, count, stride, clusters + first, scratch.scores);
+    });
+}
+
+/**
+ * Data points own separate feature vectors, so each tile is gathered into a contiguous block first.
+ */
+void NearestCentroidClassifier::predict_batch(const std::vector<DataPoint *> &points, std::vector<int> &clusters) const {
+    RTML_TIMER("nearest_centroid.predict_batch");
+    RTML_COUNT("nearest_centroid.predictions", points.size());
+    clusters.resize(points.size());
+    size_t num_tiles = (points.size() + QUERY_TILE - 1) / QUERY_TILE;
+    for_each_tile(num_tiles, num_threads, [&](size_t tile, TileScratch &scratch) {
+        size_t first = tile * QUERY_TILE;
+        size_t count = std::min(QUERY_TILE, points.size() - first);
+
+        scratch.queries.resize(QUERY_TILE * dim);
+        for (size_t r = 0; r < count; ++r) {
+            const real_t *features = points[first + r]->get_normalized_feature_vector()->data();
+            std::copy(features, features + dim, &scratch.queries[r * dim]);
+        }
+        predict_tile(scratch.queries.data(), count, dim, &clusters[first], scratch.scores);
+    });
+}
+
+int NearestCentroidClassifier::predict(const real_t *query) const {
+    RTML_TIMER("nearest_centroid.predict");
+    RTML_COUNT("nearest_centroid.predictions", 1);
+    // Score buffer reused by every call on this thread, so a prediction never allocates
+    thread_local std::vector<real_t> scratch;
+    int cluster = 0;
+    predict_tile(query, 1, dim, &cluster, scratch);
+    return cluster;
+}
+
+int NearestCentroidClassifier::label(size_t cluster) const {
+    return label_data[cluster];
+}
+
+double NearestCentroidClassifier::evaluate(const std::vector<DataPoint *> &points) const {
+    if (points.empty()) {
+        return 0.0;
+    }
+
+    std::vector<int> clusters;
+    predict_batch(points, clusters);
+
+    double num_correct = 0.0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (label_data[clusters[i]] == points[i]->get_label()) {
+            num_correct++;
+        }
+    }
+    return 100.0 * (num_correct / static_cast<double>(points.size()));
+}
+
+size_t NearestCentroidClassifier::size() const {
+    return num_centroids;
+}
+
+size_t NearestCentroidClassifier::dimension() const {
+    return dim;
+}
@@ -1,7 +1,10 @@
 #include <iostream>
 #include <cstdio>
 #include "data_handler.hpp"
-#include "kmeans.hpp"
+#include "instrumentation.hpp"
+#include "mini_batch_kmeans.hpp"
+#include "model_selection.hpp"
+#include "nearest_centroid.hpp"
 
 int main() {
     // Instantiate DataHandler and load the dataset
@@ -12,51 +15,47 @@ int main() {
     dh->normalize();
     dh->split_data();
 
-    // Initialize k
-    double best_performance = 0.0;
-    int best_k = 1;
-
-    // Look for the best k
-    for (int k = dh->get_class_count(); k < static_cast<int>(dh->get_training_set()->size() * 0.1); ++k) {
-
-        // Instantiate KMeans with the current k
-        auto *kmeans = new KMeans(k);
-        kmeans->set_training_data(dh->get_training_set());
-        kmeans->set_test_data(dh->get_test_set());
-        kmeans->set_validation_data(dh->get_validation_set());
-
-        // Initialize clusters and train the model
-        kmeans->init_clusters();
-        kmeans->train();
-
-        // Validate the model
-        double performance = kmeans->validate();
-        std::cout << "Current Performance @ K = " << k << ": " << performance << std::endl;
+    // Score every k from the number of classes up to 10% of the training set with one split tree
+    KMeansModelSelection selector;
+    selector.set_training_data(dh->get_training_set());
+    selector.set_validation_data(dh->get_validation_set());
+    int max_k = static_cast<int>(dh->get_training_set()->size() * 0.1);
+    NearestCentroidClassifier *final_model = nullptr;
+    std::vector<KScore> curve = selector.bisecting_sweep(dh->get_class_count(), max_k, &final_model);
+    for (const KScore &score : curve) {
+        std::cout << "Current Performance @ K = " << score.k << ": " << score.accuracy << std::endl;
+    }
 
-        // Update k based on performance
-        if (performance > best_performance) {
-            best_performance = performance;
-            best_k = k;
+    // The leaves of the best k are the model that is tested and deployed
+    KScore best = KMeansModelSelection::best(curve);
+    int best_k = best.k;
+    std::cout << "Best K: " << best_k << " with performance: " << best.accuracy << std::endl;
+    std::cout << "Overall Performance: " << final_model->evaluate(*dh->get_test_set()) << std::endl;
+
+    // Persist the final centroids and serve the test set from the mapped file
+    const char *model_path = "bin/kmeans_model.rtml";
+    if (final_model->save(model_path)) {
+        auto loaded = NearestCentroidClassifier::load(model_path);
+        if (loaded) {
+            std::cout << "Loaded Model Performance: " << loaded->evaluate(*dh->get_test_set()) << std::endl;
         }
-
-        // Clean up
-        delete kmeans;
     }
 
-    // Retrain the a KMeans model with the best k
-    std::cout << "Best K: " << best_k << " with performance: " << best_performance << std::endl;
-    auto *final_kmeans = new KMeans(best_k);
-    final_kmeans->set_training_data(dh->get_training_set());
-    final_kmeans->set_test_data(dh->get_test_set());
-    final_kmeans->set_validation_data(dh->get_validation_set());
-
-    // Initialize clusters and train the final model
-    final_kmeans->init_clusters();
-    final_kmeans->train();
-    std::cout << "Overall Performance: " << final_kmeans->test() << std::endl;
+    // Stream the training set through a mini-batch model with the same k
+    MiniBatchKMeans streaming_kmeans(best_k);
+    streaming_kmeans.set_training_data(dh->get_training_set());
+    streaming_kmeans.set_test_data(dh->get_test_set());
+    streaming_kmeans.set_validation_data(dh->get_validation_set());
+    streaming_kmeans.train(3);
+    std::cout << "Mini-Batch Performance: " << streaming_kmeans.test() << std::endl;
+
+    // Per-phase timings and counters of an instrumented build (make INSTRUMENT=1)
+    if (instrumentation::enabled) {
+        instrumentation::save("bin/instrumentation.json");
+    }
 
     // Clean up
-    delete final_kmeans;
+    delete final_model;
     delete dh;
 
     return 0;
@@ -0,0 +1,50 @@
+#include <cstdlib>
+#include <iostream>
+#include "benchmark.hpp"
+#include "data_handler.hpp"
+#include "knn.hpp"
+#include "knn_index.hpp"
+
+// Benchmarks of the KNN distance, neighbor search and flat index, on generated MNIST-sized data
+int main(int argc, char **argv) {
+    const std::string output = argc > 1 ? argv[1] : "bin/bench.json";
+    const std::string images = "bin/bench-images.idx", labels = "bin/bench-labels.idx";
+    if (!synthetic::write_idx(images, labels, 6000, 28, 28, 10)) {
+        return 1;
+    }
+    srand(1);
+    DataHandler *dh = new DataHandler();
+    dh->read_input_data(images);
+    dh->read_label_data(labels);
+    dh->count_classes();
+    dh->normalize();
+    dh->split_data();
+    std::vector<DataPoint *> &training_set = *dh->get_training_set();
+    std::vector<DataPoint *> &test_set = *dh->get_test_set();
+    size_t dim = training_set[0]->get_normalized_feature_vector()->size();
+
+    KNN *knn = new KNN(5);
+    knn->set_training_data(&training_set);
+    Benchmark bench("knn");
+
+    size_t query = 0;
+    bench.run("calculate_distance", [&]() {
+        do_not_optimize(knn->calculate_distance(test_set[0], training_set[query++ % training_set.size()]));
+    }, dim);
+    bench.run("find_k_nearest", [&]() { knn->find_k_nearest(test_set[query++ % test_set.size()]); }, training_set.size());
+    bench.run("find_k_nearest_predict", [&]() {
+        knn->find_k_nearest(test_set[query++ % test_set.size()]);
+        do_not_optimize(knn->predict());
+    }, training_set.size());
+
+    bench.run("index_build", [&]() { do_not_optimize(KNNIndex(training_set).size()); }, training_set.size());
+    KNNIndex index(training_set);
+    bench.run("index_predict", [&]() {
+        do_not_optimize(index.predict(test_set[query++ % test_set.size()]->get_normalized_feature_vector()->data(), 5));
+    }, training_set.size());
+    bench.run("index_evaluate", [&]() { do_not_optimize(index.evaluate(test_set, 5)); }, test_set.size());
+
+    delete knn;
+    delete dh;
+    return bench.save(output) ? 0 : 1;
+}
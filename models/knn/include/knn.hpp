@@ -50,6 +50,9 @@ public:
 
     /**
      * @brief Calculates the Euclidean distance between two data points.
+     *
+     * Uses the normalized (real_t) features when both points have them, the raw features otherwise.
+     *
      * @param query_point The point to compare.
      * @param input A training data point.
      * @return Euclidean distance between query_point and input.
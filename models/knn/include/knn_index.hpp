@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "aligned_allocator.hpp"
+#include "data_point.hpp"
+#include "model_file.hpp"
+
+/**
+ * @class KNNIndex
+ * @brief Flat, immutable k-nearest-neighbor index over normalized training features.
+ *
+ * The training set is stored as one row-major feature matrix (rows padded to a cache line)
+ * plus a label array, so a query is a linear scan of squared_distance calls over contiguous
+ * memory instead of chasing DataPoint pointers. The index can be saved to a model file and
+ * served straight from the mapping. Every method is const and keeps its scratch on the
+ * calling thread, so one instance can be shared between threads.
+ */
+class KNNIndex {
+private:
+    size_t num_points = 0;  ///< Number of indexed training points.
+    size_t dim = 0;         ///< Number of features per point.
+    size_t stride = 0;      ///< Distance in elements between consecutive rows.
+
+    /**
+     * @brief Row-major num_points x stride feature matrix (when built in memory).
+     */
+    AlignedVector<real_t> features;
+
+    /**
+     * @brief Label of every point (when built in memory).
+     */
+    std::vector<uint8_t> labels;
+
+    /**
+     * @brief Mapping that holds the arrays when the index was loaded from a file.
+     */
+    std::shared_ptr<const MappedModelFile> file;
+
+    /**
+     * @brief Feature matrix and labels, in the vectors above or in the mapped file.
+     */
+    const real_t *feature_data;
+    const uint8_t *label_data;
+
+    /**
+     * @brief Wraps validated arrays that live in a mapped file.
+     */
+    KNNIndex(std::shared_ptr<const MappedModelFile> file, size_t num_points, size_t dim, size_t stride,
+             const real_t *features, const uint8_t *labels);
+
+public:
+    /**
+     * @brief Copies the normalized features and labels of a training set into the index.
+     * @param points Training points; all must be normalized to the same dimension.
+     */
+    explicit KNNIndex(const std::vector<DataPoint *> &points);
+
+    KNNIndex(KNNIndex &&) = default;
+    KNNIndex(const KNNIndex &) = delete;
+    KNNIndex &operator=(const KNNIndex &) = delete;
+
+    /**
+     * @brief Writes the feature matrix and labels to a model file.
+     * @param path Destination file.
+     * @return True on success.
+     */
+    bool save(const std::string &path) const;
+
+    /**
+     * @brief Maps a model file written by save() and serves its features in place.
+     * @param path Model file.
+     * @return Shared index, or nullptr if the file is missing or invalid.
+     */
+    static std::shared_ptr<const KNNIndex> load(const std::string &path);
+
+    /**
+     * @brief Predicts a label by majority vote of the k closest training points.
+     *
+     * Ties between labels go to the smallest label, as in KNN::predict.
+     *
+     * @param query Normalized query features (dimension() values).
+     * @param k Number of neighbors.
+     * @return Predicted class label.
+     */
+    int predict(const real_t *query, int k) const;
+
+    /**
+     * @brief Computes classification accuracy on a set of labeled points, queries spread over the shared ThreadPool.
+     * @param points Normalized points to classify.
+     * @param k Number of neighbors.
+     * @return Accuracy as a percentage (0.0 - 100.0).
+     */
+    double evaluate(const std::vector<DataPoint *> &points, int k) const;
+
+    /**
+     * @brief Returns the number of indexed training points.
+     * @return Point count.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Returns the number of features per point.
+     * @return Feature dimension.
+     */
+    size_t dimension() const;
+};
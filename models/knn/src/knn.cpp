@@ -3,7 +3,9 @@
 #include <limits>
 #include <map>
 #include <cstdint>
+#include "instrumentation.hpp"
 #include "knn.hpp"
+#include "linalg.hpp"
 
 // Constructor that sets the value of k
 KNN::KNN(int k) {
@@ -23,6 +25,18 @@ void KNN::set_k(int k) {
 
 // Calculate the distance between two data points using Euclidean or Manhattan distance
 double KNN::calculate_distance(DataPoint *query_point, DataPoint *input) {
+    // Normalized features are compared in the build's real_t precision with the SIMD kernel
+    const std::vector<real_t> *query_features = query_point->get_normalized_feature_vector();
+    const std::vector<real_t> *input_features = input->get_normalized_feature_vector();
+    if (query_features && input_features) {
+        if (query_features->size() != input_features->size()) {
+            std::cerr << "Error: Feature vectors have different sizes." << std::endl;
+            exit(1);
+        }
+        return std::sqrt(static_cast<double>(
+            linalg::squared_distance(query_features->data(), input_features->data(), query_features->size())));
+    }
+
     if (query_point->get_feature_vector_size() != input->get_feature_vector_size()) {
         std::cerr << "Error: Feature vectors have different sizes." << std::endl;
         exit(1);
@@ -54,14 +68,19 @@ void KNN::find_k_nearest(DataPoint *query_point) {
     double previous_min = min;
     int index = 0;
 
-    for (size_t j = 0; j < this->training_set->size(); ++j) {
-        double distance = this->calculate_distance(query_point, this->training_set->at(j));
-        this->training_set->at(j)->set_distance(distance);
+    {
+        RTML_TIMER("knn.distance");
+        for (size_t j = 0; j < this->training_set->size(); ++j) {
+            double distance = this->calculate_distance(query_point, this->training_set->at(j));
+            this->training_set->at(j)->set_distance(distance);
 
-        if (distance < min) {
-            min = distance;
-            index = j;
+            if (distance < min) {
+                min = distance;
+                index = j;
+            }
         }
+        RTML_COUNT("knn.bytes_scanned", this->training_set->size() *
+                   query_point->get_normalized_feature_vector()->size() * sizeof(real_t));
     }
 
     // Add the closest point to neighbors
@@ -70,6 +89,7 @@ void KNN::find_k_nearest(DataPoint *query_point) {
     min = std::numeric_limits<double>::max();
 
     // Step 2: find the next closest k-1 neighbors
+    RTML_TIMER("knn.selection");
     for (int i = 1; i < k; ++i) {
         for (size_t j = 0; j < this->training_set->size(); ++j) {
             double distance = this->training_set->at(j)->get_distance();
@@ -115,8 +135,12 @@ double evaluate_performance(KNN &knn, std::vector<DataPoint *> *data_set, const
     double performance = 0.0;
 
     for (DataPoint *query_point : *data_set) {
-        knn.find_k_nearest(query_point);
-        int predicted_label = knn.predict();
+        int predicted_label;
+        {
+            RTML_TIMER("knn.predict");
+            knn.find_k_nearest(query_point);
+            predicted_label = knn.predict();
+        }
 
         if (predicted_label == query_point->get_label()) {
             ++correct_count;
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include "instrumentation.hpp"
+#include "knn_index.hpp"
+#include "linalg.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+const uint32_t SHAPE_SECTION = section_tag("SHAP");
+const uint32_t FEATURE_SECTION = section_tag("FEAT");
+const uint32_t LABEL_SECTION = section_tag("LABL");
+
+const size_t ROW_ALIGNMENT = 64 / sizeof(real_t);
+
+/**
+ * On-disk shape of the index.
+ */
+struct Shape {
+    uint64_t num_points;
+    uint64_t dim;
+    uint64_t stride;
+};
+
+} // namespace
+
+KNNIndex::KNNIndex(const std::vector<DataPoint *> &points)
+    : num_points(points.size()) {
+    if (!points.empty() && points[0]->get_normalized_feature_vector()) {
+        dim = points[0]->get_normalized_feature_vector()->size();
+    }
+    stride = (dim + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+    features.assign(num_points * stride, real_t(0));
+    labels.resize(num_points);
+
+    for (size_t i = 0; i < num_points; ++i) {
+        const std::vector<real_t> *point_features = points[i]->get_normalized_feature_vector();
+        if (!point_features || point_features->size() != dim) {
+            std::cerr << "Error: KNNIndex needs normalized points of equal size." << std::endl;
+            exit(1);
+        }
+        std::copy(point_features->begin(), point_features->end(), &features[i * stride]);
+        labels[i] = points[i]->get_label();
+    }
+    feature_data = features.data();
+    label_data = labels.data();
+}
+
+KNNIndex::KNNIndex(std::shared_ptr<const MappedModelFile> file, size_t num_points, size_t dim, size_t stride,
+                   const real_t *features, const uint8_t *labels)
+    : num_points(num_points),
+      dim(dim),
+      stride(stride),
+      file(std::move(file)),
+      feature_data(features),
+      label_data(labels) {}
+
+bool KNNIndex::save(const std::string &path) const {
+    Shape shape = {num_points, dim, stride};
+    ModelWriter writer(ModelType::KNN_INDEX);
+    writer.add_section(SHAPE_SECTION, &shape, sizeof(shape));
+    writer.add_section(FEATURE_SECTION, feature_data, num_points * stride * sizeof(real_t));
+    writer.add_section(LABEL_SECTION, label_data, num_points);
+    return writer.save(path);
+}
+
+std::shared_ptr<const KNNIndex> KNNIndex::load(const std::string &path) {
+    std::shared_ptr<const MappedModelFile> file = MappedModelFile::open(path, ModelType::KNN_INDEX);
+    if (!file) {
+        return nullptr;
+    }
+    size_t shape_bytes, feature_bytes, label_bytes;
+    const Shape *shape = static_cast<const Shape *>(file->section(SHAPE_SECTION, shape_bytes));
+    const void *features = file->section(FEATURE_SECTION, feature_bytes);
+    const void *labels = file->section(LABEL_SECTION, label_bytes);
+    // The stride is checked before it bounds the product, so neither a zero nor a huge shape can trap or wrap
+    if (!shape || shape_bytes != sizeof(Shape) || shape->num_points == 0 || shape->stride == 0
+        || shape->stride < shape->dim
+        || shape->num_points > std::numeric_limits<size_t>::max() / sizeof(real_t) / shape->stride
+        || feature_bytes != shape->num_points * shape->stride * sizeof(real_t)
+        || label_bytes != shape->num_points) {
+        std::cerr << "Model file '" << path << "' has inconsistent index arrays." << std::endl;
+        return nullptr;
+    }
+    return std::shared_ptr<const KNNIndex>(new KNNIndex(std::move(file), shape->num_points, shape->dim, shape->stride,
+                                                        static_cast<const real_t *>(features),
+                                                        static_cast<const uint8_t *>(labels)));
+}
+
+/**
+ * Scan every row, keep the k smallest (distance, index) pairs with nth_element, then vote.
+ */
+int KNNIndex::predict(const real_t *query, int k) const {
+    RTML_TIMER("knn_index.predict");
+    thread_local std::vector<std::pair<accum_t, uint32_t>> distances;
+    distances.resize(num_points);
+    {
+        RTML_TIMER("knn_index.distance");
+        for (size_t i = 0; i < num_points; ++i) {
+            distances[i] = {linalg::squared_distance(query, feature_data + i * stride, dim), static_cast<uint32_t>(i)};
+        }
+        RTML_COUNT("knn_index.bytes_scanned", num_points * dim * sizeof(real_t));
+    }
+
+    size_t count = std::min(static_cast<size_t>(std::max(k, 1)), num_points);
+    RTML_TIMER("knn_index.selection");
+    std::nth_element(distances.begin(), distances.begin() + (count - 1), distances.end());
+
+    int class_freq[256] = {};
+    for (size_t i = 0; i < count; ++i) {
+        class_freq[label_data[distances[i].second]]++;
+    }
+    int best_label = 0;
+    for (int label = 1; label < 256; ++label) {
+        if (class_freq[label] > class_freq[best_label]) {
+            best_label = label;
+        }
+    }
+    return best_label;
+}
+
+double KNNIndex::evaluate(const std::vector<DataPoint *> &points, int k) const {
+    if (points.empty()) {
+        return 0.0;
+    }
+
+    std::atomic<size_t> num_correct{0};
+    ThreadPool::shared().parallel_for(0, points.size(), 0, [&](size_t first, size_t last) {
+        size_t correct = 0;
+        for (size_t i = first; i < last; ++i) {
+            if (predict(points[i]->get_normalized_feature_vector()->data(), k) == points[i]->get_label()) {
+                correct++;
+            }
+        }
+        num_correct += correct;
+    });
+    return 100.0 * (static_cast<double>(num_correct) / static_cast<double>(points.size()));
+}
+
+size_t KNNIndex::size() const {
+    return num_points;
+}
+
+size_t KNNIndex::dimension() const {
+    return dim;
+}
@@ -1,6 +1,8 @@
 #include <iostream>
 #include "data_handler.hpp"
+#include "instrumentation.hpp"
 #include "knn.hpp"
+#include "knn_index.hpp"
 
 int main() {
     // Initialize DataHandler and read input and label data
@@ -8,6 +10,7 @@ int main() {
     dh->read_input_data("../../dataset/train-images-idx3-ubyte");
     dh->read_label_data("../../dataset/train-labels-idx1-ubyte");
     dh->count_classes();
+    dh->normalize();
     dh->split_data();
 
     // Initialize KNN model
@@ -33,6 +36,20 @@ int main() {
     knn->set_k(best_k);
     knn->test_performance();
 
+    // Persist the training set as a flat index and serve the test set from the mapped file
+    const char *index_path = "bin/knn_index.rtml";
+    if (KNNIndex(*dh->get_training_set()).save(index_path)) {
+        auto index = KNNIndex::load(index_path);
+        if (index) {
+            std::cout << "Index test performance: " << index->evaluate(*dh->get_test_set(), best_k) << "%" << std::endl;
+        }
+    }
+
+    // Per-phase timings and counters of an instrumented build (make INSTRUMENT=1)
+    if (instrumentation::enabled) {
+        instrumentation::save("bin/instrumentation.json");
+    }
+
     // Clean up
     delete dh;
     delete knn;